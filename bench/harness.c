@@ -0,0 +1,405 @@
+// Benchmark harness for `make bench`.
+//
+// Runs every bench/*.lofy workload (plus a generated large script that
+// stresses the lexer and parser) several times in a fresh interpreter
+// process, and reports the median and p95 wall time, source throughput and
+// peak RSS of each. Results are written as JSON; given a baseline written
+// by an earlier run, medians that got slower by more than the tolerance
+// are reported as regressions and make the harness exit with status 1.
+//
+// POSIX only: processes are started with fork/exec and measured with wait4.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MAX_BENCHMARKS 64
+#define MAX_RUNS 100
+#define MAX_ARGS 16
+#define GENERATED_LINES 150000
+
+typedef struct
+{
+    char name[64];
+    char path[512];
+    long bytes;
+
+    double median_ms;
+    double p95_ms;
+    double min_ms;
+    long peak_rss_kb;
+    int ok; // Every run exited with status 0
+} Benchmark;
+
+typedef struct
+{
+    const char *lofy;
+    const char *args[MAX_ARGS]; // Extra interpreter flags
+    int arg_count;
+    const char *bench_dir;
+    const char *out_dir;
+    const char *output;
+    const char *baseline;
+    int runs;
+    int warmup;
+    double tolerance; // Allowed slowdown of the median, as a fraction
+} Options;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+// Runs the interpreter once on `script` with its output discarded. Returns
+// the exit status, or -1 if it couldn't be started or didn't exit normally.
+static int run_once(const Options *opt, const char *script, double *ms, long *rss_kb)
+{
+    const char *argv[MAX_ARGS + 3];
+    int argc = 0;
+    argv[argc++] = opt->lofy;
+    for (int i = 0; i < opt->arg_count; i++)
+        argv[argc++] = opt->args[i];
+    argv[argc++] = script;
+    argv[argc] = NULL;
+
+    double start = now_ms();
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0)
+        {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+        }
+        execv(opt->lofy, (char *const *)argv);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0)
+    {
+        if (errno != EINTR)
+            return -1;
+    }
+    *ms = now_ms() - start;
+    *rss_kb = usage.ru_maxrss; // Kilobytes on Linux
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void measure(const Options *opt, Benchmark *b)
+{
+    double times[MAX_RUNS];
+    b->ok = 1;
+    b->peak_rss_kb = 0;
+    for (int i = 0; i < opt->warmup + opt->runs; i++)
+    {
+        double ms = 0;
+        long rss = 0;
+        if (run_once(opt, b->path, &ms, &rss) != 0)
+            b->ok = 0;
+        if (i < opt->warmup)
+            continue;
+        times[i - opt->warmup] = ms;
+        if (rss > b->peak_rss_kb)
+            b->peak_rss_kb = rss;
+    }
+
+    int n = opt->runs;
+    qsort(times, n, sizeof(double), compare_doubles);
+    b->min_ms = times[0];
+    b->median_ms = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+    int rank = (95 * n + 99) / 100; // Nearest rank, 1-based
+    b->p95_ms = times[rank - 1];
+}
+
+static double throughput_mb_s(const Benchmark *b)
+{
+    return b->median_ms > 0 ? b->bytes / 1e6 / (b->median_ms / 1000.0) : 0.0;
+}
+
+// A long straight-line program over a bounded set of names and literals,
+// so it measures the front end rather than the VM or register allocation.
+static int generate_large_script(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+        return -1;
+    fprintf(file, "# Generated by bench/harness: lexer and parser throughput\n");
+    for (int v = 0; v < 100; v++)
+        fprintf(file, "v%d = %d\n", v, v);
+    for (int i = 0; i < GENERATED_LINES; i++)
+    {
+        switch (i % 4)
+        {
+        case 0:
+            fprintf(file, "v%d = v%d + %d * (v%d - %d)\n", i % 100, (i * 7) % 100, i % 50, (i * 13) % 100, i % 9);
+            break;
+        case 1:
+            fprintf(file, "if v%d > %d: v%d = v%d - %d\n", i % 100, i % 40, (i * 3) % 100, i % 100, i % 30);
+            break;
+        case 2:
+            fprintf(file, "s%d = \"generated string %d\"  # trailing comment\n", i % 20, i % 20);
+            break;
+        default:
+            fprintf(file, "f%d = %d.25 * %d.5 / 4.0\n", i % 30, i % 60, i % 7);
+            break;
+        }
+    }
+    fprintf(file, "print(v0)\n");
+    return fclose(file);
+}
+
+static int has_suffix(const char *s, const char *suffix)
+{
+    size_t n = strlen(s);
+    size_t m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(((const Benchmark *)a)->name, ((const Benchmark *)b)->name);
+}
+
+static int find_benchmarks(const Options *opt, Benchmark *list)
+{
+    int count = 0;
+    DIR *dir = opendir(opt->bench_dir);
+    if (dir == NULL)
+    {
+        printf("Error: Could not open directory '%s'\n", opt->bench_dir);
+        return -1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < MAX_BENCHMARKS - 1)
+    {
+        if (!has_suffix(entry->d_name, ".lofy"))
+            continue;
+        Benchmark *b = &list[count++];
+        memset(b, 0, sizeof(*b));
+        snprintf(b->name, sizeof(b->name), "%.*s", (int)(strlen(entry->d_name) - 5), entry->d_name);
+        snprintf(b->path, sizeof(b->path), "%s/%s", opt->bench_dir, entry->d_name);
+    }
+    closedir(dir);
+
+    Benchmark *b = &list[count];
+    memset(b, 0, sizeof(*b));
+    snprintf(b->name, sizeof(b->name), "large_script");
+    snprintf(b->path, sizeof(b->path), "%s/large_script.lofy", opt->out_dir);
+    if (generate_large_script(b->path) != 0)
+    {
+        printf("Error: Could not write '%s'\n", b->path);
+        return -1;
+    }
+    count++;
+
+    qsort(list, count, sizeof(Benchmark), compare_names);
+    for (int i = 0; i < count; i++)
+        list[i].bytes = file_size(list[i].path);
+    return count;
+}
+
+// One benchmark per line, so baselines can be read back without a JSON parser
+static int write_json(const Options *opt, const Benchmark *list, int count)
+{
+    FILE *file = fopen(opt->output, "w");
+    if (file == NULL)
+        return -1;
+    fprintf(file, "{\n  \"lofy\": \"%s\",\n  \"args\": \"", opt->lofy);
+    for (int i = 0; i < opt->arg_count; i++)
+        fprintf(file, "%s%s", i ? " " : "", opt->args[i]);
+    fprintf(file, "\",\n  \"runs\": %d,\n  \"benchmarks\": [\n", opt->runs);
+    for (int i = 0; i < count; i++)
+    {
+        const Benchmark *b = &list[i];
+        fprintf(file,
+                "    {\"name\": \"%s\", \"bytes\": %ld, \"median_ms\": %.3f, \"p95_ms\": %.3f, "
+                "\"min_ms\": %.3f, \"throughput_mb_s\": %.3f, \"peak_rss_kb\": %ld, \"ok\": %s}%s\n",
+                b->name, b->bytes, b->median_ms, b->p95_ms, b->min_ms, throughput_mb_s(b),
+                b->peak_rss_kb, b->ok ? "true" : "false", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file);
+}
+
+// Looks up `name` in a baseline file written by write_json(). Returns its
+// median, or -1 if it isn't there.
+static double baseline_median(const char *text, const char *name)
+{
+    char key[96];
+    snprintf(key, sizeof(key), "{\"name\": \"%.63s\",", name);
+    const char *line = strstr(text, key);
+    if (line == NULL)
+        return -1;
+    const char *field = strstr(line, "\"median_ms\": ");
+    const char *end = strchr(line, '\n');
+    if (field == NULL || (end != NULL && field > end))
+        return -1;
+    return atof(field + strlen("\"median_ms\": "));
+}
+
+static char *read_file(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *text = (char *)malloc(capacity);
+    size_t n;
+    while ((n = fread(text + length, 1, capacity - length - 1, file)) > 0)
+    {
+        length += n;
+        if (capacity - length < 2)
+        {
+            capacity *= 2;
+            text = (char *)realloc(text, capacity);
+        }
+    }
+    fclose(file);
+    text[length] = '\0';
+    return text;
+}
+
+static void usage(const char *program)
+{
+    printf("Usage: %s [-n runs] [-w warmup] [-o results.json] [-b baseline.json] [-t tolerance]\n"
+           "          [--lofy path] [--dir bench] [--out dir] [-- lofy flags...]\n",
+           program);
+}
+
+int main(int argc, char **argv)
+{
+    Options opt = {0};
+    opt.lofy = "./lofy.exe";
+    opt.bench_dir = "bench";
+    opt.out_dir = "bench/out";
+    opt.output = NULL;
+    opt.runs = 5;
+    opt.warmup = 1;
+    opt.tolerance = 0.10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (strcmp(arg, "--") == 0)
+        {
+            while (++i < argc && opt.arg_count < MAX_ARGS)
+                opt.args[opt.arg_count++] = argv[i];
+        }
+        else if (strcmp(arg, "-n") == 0 && has_value)
+            opt.runs = atoi(argv[++i]);
+        else if (strcmp(arg, "-w") == 0 && has_value)
+            opt.warmup = atoi(argv[++i]);
+        else if (strcmp(arg, "-o") == 0 && has_value)
+            opt.output = argv[++i];
+        else if (strcmp(arg, "-b") == 0 && has_value)
+            opt.baseline = argv[++i];
+        else if (strcmp(arg, "-t") == 0 && has_value)
+            opt.tolerance = atof(argv[++i]);
+        else if (strcmp(arg, "--lofy") == 0 && has_value)
+            opt.lofy = argv[++i];
+        else if (strcmp(arg, "--dir") == 0 && has_value)
+            opt.bench_dir = argv[++i];
+        else if (strcmp(arg, "--out") == 0 && has_value)
+            opt.out_dir = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opt.runs < 1 || opt.runs > MAX_RUNS || opt.warmup < 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    mkdir(opt.out_dir, 0777);
+    char default_output[512];
+    if (opt.output == NULL)
+    {
+        snprintf(default_output, sizeof(default_output), "%s/results.json", opt.out_dir);
+        opt.output = default_output;
+    }
+
+    char *baseline = NULL;
+    if (opt.baseline != NULL && (baseline = read_file(opt.baseline)) == NULL)
+    {
+        printf("Error: Could not read baseline '%s'\n", opt.baseline);
+        return 2;
+    }
+
+    static Benchmark list[MAX_BENCHMARKS];
+    int count = find_benchmarks(&opt, list);
+    if (count < 0)
+        return 2;
+
+    printf("%-16s %10s %10s %10s %10s %10s\n", "benchmark", "median ms", "p95 ms", "MB/s", "peak RSS", "baseline");
+    int regressions = 0;
+    int failures = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Benchmark *b = &list[i];
+        measure(&opt, b);
+        printf("%-16s %10.2f %10.2f %10.2f %8ldkB", b->name, b->median_ms, b->p95_ms, throughput_mb_s(b), b->peak_rss_kb);
+
+        double base = baseline != NULL ? baseline_median(baseline, b->name) : -1;
+        if (base > 0)
+        {
+            double change = (b->median_ms - base) / base;
+            printf(" %+9.1f%%", 100.0 * change);
+            if (change > opt.tolerance)
+            {
+                printf("  REGRESSION");
+                regressions++;
+            }
+        }
+        if (!b->ok)
+        {
+            printf("  FAILED");
+            failures++;
+        }
+        printf("\n");
+    }
+    free(baseline);
+
+    if (write_json(&opt, list, count) != 0)
+    {
+        printf("Error: Could not write '%s'\n", opt.output);
+        return 2;
+    }
+    printf("Results written to %s\n", opt.output);
+    if (regressions > 0)
+        printf("%d benchmark(s) regressed by more than %.0f%% against %s\n", regressions, 100.0 * opt.tolerance, opt.baseline);
+    return regressions > 0 || failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#ifndef LOFY_H
+#define LOFY_H
+
+// Embedding API for the LoFy interpreter (liblofy.a).
+//
+// A lofy_State is a complete, independent interpreter: its own global
+// variables, interned names and output sinks. Nothing is shared between
+// states, so any number of them can run at once on different threads. A
+// single state must only be used by one thread at a time.
+//
+//     lofy_State *L = lofy_new();
+//     lofy_set_int(L, "n", 10);
+//     lofy_do_string(L, "print(n * 2)", 12);
+//     lofy_close(L);
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lofy_State lofy_State;
+typedef struct lofy_Program lofy_Program;
+
+// Receives `length` bytes of output; the data is not NUL-terminated.
+typedef void (*lofy_WriteFn)(void *user, const char *data, size_t length);
+
+// Results of lofy_compile(), lofy_run() and lofy_do_string(). Runtime
+// errors such as division by zero are reported through the error sink and
+// execution continues, as in the interpreter; they don't fail the call.
+// Programs too big for the bytecode VM run on the tree-walker instead.
+enum
+{
+    LOFY_OK = 0,
+    LOFY_ERROR_SYNTAX = 1  // Syntax errors were reported; nothing was run
+};
+
+typedef enum
+{
+    LOFY_NONE,
+    LOFY_INT,
+    LOFY_FLOAT,
+    LOFY_BOOL,
+    LOFY_STRING,
+    LOFY_ARRAY,
+    LOFY_DICT
+} lofy_Type;
+
+lofy_State *lofy_new(void);
+void lofy_close(lofy_State *L);
+
+// `print` output and diagnostics go to stdout until redirected; passing a
+// NULL function restores stdout. Output is buffered and handed over in
+// chunks: when the buffer fills, before each diagnostic, and before the
+// call that produced it returns. Diagnostics are passed on at once.
+void lofy_set_output(lofy_State *L, lofy_WriteFn write, void *user);
+void lofy_set_error(lofy_State *L, lofy_WriteFn write, void *user);
+
+// Parses and compiles `source` for `L`. On success *program can be run any
+// number of times, by `L` only, and is freed with lofy_program_free().
+int lofy_compile(lofy_State *L, const char *source, size_t length, lofy_Program **program);
+int lofy_run(lofy_State *L, lofy_Program *program);
+void lofy_program_free(lofy_Program *program);
+
+// Compiles and runs `source` once.
+int lofy_do_string(lofy_State *L, const char *source, size_t length);
+
+// Global variables. Setting one defines it if needed; reading one that was
+// never set gives LOFY_NONE, 0 or NULL.
+void lofy_set_int(lofy_State *L, const char *name, long long value);
+void lofy_set_float(lofy_State *L, const char *name, double value);
+void lofy_set_bool(lofy_State *L, const char *name, int value);
+void lofy_set_string(lofy_State *L, const char *name, const char *value, size_t length);
+
+lofy_Type lofy_get_type(lofy_State *L, const char *name);
+// Ints are arbitrary-precision; one too big for a long long reads as 0
+long long lofy_get_int(lofy_State *L, const char *name); // 0 unless an int or bool
+double lofy_get_float(lofy_State *L, const char *name);  // Ints are converted
+// The string's bytes, or NULL if the variable doesn't hold a string. They
+// stay valid until the next call that sets a variable or runs code on `L`.
+// `length` may be NULL.
+const char *lofy_get_string(lofy_State *L, const char *name, size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
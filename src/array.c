@@ -0,0 +1,1119 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "array.h"
+#include "bigint.h"
+#include "token.h"
+#include "output.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// SSE2 is part of x86-64. AVX2 kernels are compiled for it function by
+// function and only run after __builtin_cpu_supports() says so.
+#define ARRAY_SIMD
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+static size_t element_size(ArrayKind kind)
+{
+    switch (kind)
+    {
+    case ARRAY_INT:
+        return sizeof(int64_t);
+    case ARRAY_FLOAT:
+        return sizeof(double);
+    default:
+        return sizeof(Value);
+    }
+}
+
+// The unboxed kind that can hold `v`, or ARRAY_BOXED
+static ArrayKind kind_of(Value v)
+{
+    if (value_is_int(v))
+        return ARRAY_INT;
+    if (value_is_float(v))
+        return ARRAY_FLOAT;
+    return ARRAY_BOXED;
+}
+
+LoArray *array_new(ArrayKind kind, uint32_t capacity)
+{
+    LoArray *a = (LoArray *)malloc(sizeof(LoArray));
+    a->refcount = 1;
+    a->kind = kind;
+    a->count = 0;
+    a->capacity = capacity;
+    a->data = capacity > 0 ? malloc(capacity * element_size(kind)) : NULL;
+    return a;
+}
+
+void array_destroy(LoArray *a)
+{
+    if (a->kind == ARRAY_BOXED)
+    {
+        for (uint32_t i = 0; i < a->count; i++)
+        {
+            value_free(a->values[i]);
+        }
+    }
+    free(a->data);
+    free(a);
+}
+
+Value array_from_values(Value *values, uint32_t count)
+{
+    ArrayKind kind = count > 0 ? kind_of(values[0]) : ARRAY_INT;
+    for (uint32_t i = 1; i < count && kind != ARRAY_BOXED; i++)
+    {
+        if (kind_of(values[i]) != kind)
+            kind = ARRAY_BOXED;
+    }
+
+    LoArray *a = array_new(kind, count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        switch (kind)
+        {
+        case ARRAY_INT:
+            a->ints[i] = value_as_int(values[i]);
+            break;
+        case ARRAY_FLOAT:
+            a->floats[i] = value_as_float(values[i]);
+            break;
+        default:
+            a->values[i] = values[i];
+            break;
+        }
+    }
+    a->count = count;
+    return value_from_array(a);
+}
+
+Value array_filled(uint32_t count, Value fill)
+{
+    ArrayKind kind = kind_of(fill);
+    LoArray *a = array_new(kind, count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        switch (kind)
+        {
+        case ARRAY_INT:
+            a->ints[i] = value_as_int(fill);
+            break;
+        case ARRAY_FLOAT:
+            a->floats[i] = value_as_float(fill);
+            break;
+        default:
+            a->values[i] = value_copy(fill);
+            break;
+        }
+    }
+    a->count = count;
+    return value_from_array(a);
+}
+
+Value array_get(const LoArray *a, uint32_t i)
+{
+    switch (a->kind)
+    {
+    case ARRAY_INT:
+        return value_from_int64(a->ints[i]);
+    case ARRAY_FLOAT:
+        return value_float(a->floats[i]);
+    default:
+        return value_copy(a->values[i]);
+    }
+}
+
+// Switches `a` to boxed storage, keeping its elements
+static void array_box(LoArray *a)
+{
+    if (a->kind == ARRAY_BOXED)
+        return;
+    uint32_t capacity = a->capacity > 0 ? a->capacity : 1;
+    Value *values = (Value *)malloc(capacity * sizeof(Value));
+    for (uint32_t i = 0; i < a->count; i++)
+    {
+        values[i] = array_get(a, i);
+    }
+    free(a->data);
+    a->values = values;
+    a->capacity = capacity;
+    a->kind = ARRAY_BOXED;
+}
+
+void array_set(LoArray *a, uint32_t i, Value v)
+{
+    if (a->kind == ARRAY_INT && value_is_int(v))
+    {
+        a->ints[i] = value_as_int(v);
+        return;
+    }
+    if (a->kind == ARRAY_FLOAT && value_is_float(v))
+    {
+        a->floats[i] = value_as_float(v);
+        return;
+    }
+    array_box(a);
+    // Copied before the old element goes, which may be `v` itself
+    Value old = a->values[i];
+    a->values[i] = value_copy(v);
+    value_free(old);
+}
+
+void array_append(LoArray *a, Value v)
+{
+    ArrayKind kind = kind_of(v);
+    if (a->count == 0 && a->kind != kind)
+    {
+        // An empty array takes the kind of its first element
+        free(a->data);
+        a->data = NULL;
+        a->capacity = 0;
+        a->kind = kind;
+    }
+    else if (a->kind != kind)
+    {
+        array_box(a);
+    }
+
+    if (a->count >= a->capacity)
+    {
+        a->capacity = a->capacity == 0 ? 8 : a->capacity * 2;
+        a->data = realloc(a->data, a->capacity * element_size(a->kind));
+    }
+    a->count++;
+    if (a->kind == ARRAY_BOXED)
+        a->values[a->count - 1] = value_copy(v);
+    else
+        array_set(a, a->count - 1, v);
+}
+
+// Finds the element `index` names in `target`. Reports why there is none
+// and returns 0 if so.
+static int element_at(Value target, Value index, uint32_t *at)
+{
+    if (!value_is_array(target))
+    {
+        err_printf("Runtime Error: Only arrays and dicts can be indexed\n");
+        return 0;
+    }
+    if (!value_is_integer(index))
+    {
+        err_printf("Runtime Error: Array index must be an int\n");
+        return 0;
+    }
+    LoArray *a = value_as_array(target);
+    if (value_is_bigint(index))
+    {
+        err_printf("Runtime Error: Array index out of range for length %u\n", a->count);
+        return 0;
+    }
+    int64_t i = value_as_int(index);
+    if (i < 0)
+        i += a->count;
+    if (i < 0 || i >= a->count)
+    {
+        err_printf("Runtime Error: Array index %lld out of range for length %u\n", (long long)value_as_int(index),
+                   a->count);
+        return 0;
+    }
+    *at = (uint32_t)i;
+    return 1;
+}
+
+Value array_index(Value target, Value index)
+{
+    uint32_t at;
+    if (!element_at(target, index, &at))
+        return value_none();
+    return array_get(value_as_array(target), at);
+}
+
+void array_store(Value target, Value index, Value v)
+{
+    uint32_t at;
+    if (element_at(target, index, &at))
+        array_set(value_as_array(target), at, v);
+}
+
+// ---------------------------------------------------------------------------
+// Element-wise kernels: out[i] = l[i * ls] OP r[i * rs], where a step of 0
+// pairs a scalar with every element. The SIMD versions return how many
+// elements they did, and plain loops finish the rest. `n` is never 0. Int
+// kernels report overflow instead of wrapping; the caller then redoes the
+// whole operation element by element, promoting to bigints.
+
+// Stores l OP r in `*out`; returns 1 if it overflowed
+static inline int int_apply(int op, int64_t l, int64_t r, int64_t *out)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return int_add_overflow(l, r, out);
+    case TOKEN_MINUS:
+        return int_sub_overflow(l, r, out);
+    default:
+        return int_mul_overflow(l, r, out);
+    }
+}
+
+static inline double float_apply(int op, double l, double r)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return l + r;
+    case TOKEN_MINUS:
+        return l - r;
+    case TOKEN_MUL:
+        return l * r;
+    default:
+        return l / r;
+    }
+}
+
+#ifdef ARRAY_SIMD
+
+// Signed overflow of z = x + y or z = x - y shows in the sign bit: the
+// result's sign differs from both addends, or from x where x and y differ.
+// Macros rather than functions, which unoptimized builds would call per
+// vector.
+#define ADD_OVERFLOW_SSE2(x, y, z) _mm_and_si128(_mm_xor_si128(x, z), _mm_xor_si128(y, z))
+#define SUB_OVERFLOW_SSE2(x, y, z) _mm_and_si128(_mm_xor_si128(x, y), _mm_xor_si128(x, z))
+#define ADD_OVERFLOW_AVX2(x, y, z) _mm256_and_si256(_mm256_xor_si256(x, z), _mm256_xor_si256(y, z))
+#define SUB_OVERFLOW_AVX2(x, y, z) _mm256_and_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(x, z))
+
+// Lanes outside the int32_t range, where vpmuldq's product would be wrong
+#define WIDE_AVX2(x, min, max) _mm256_or_si256(_mm256_cmpgt_epi64(x, max), _mm256_cmpgt_epi64(min, x))
+
+// + and - only: SSE2 has no signed 32x32->64 multiply
+static size_t int_elementwise_sse2(int op, const int64_t *l, size_t ls, const int64_t *r, size_t rs, int64_t *out,
+                                   size_t n, int *overflow)
+{
+    if (op == TOKEN_MUL)
+        return 0;
+    __m128i lb = _mm_set1_epi64x(l[0]);
+    __m128i rb = _mm_set1_epi64x(r[0]);
+    __m128i ov = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i x = ls ? _mm_loadu_si128((const __m128i *)(l + i)) : lb;
+        __m128i y = rs ? _mm_loadu_si128((const __m128i *)(r + i)) : rb;
+        __m128i z;
+        if (op == TOKEN_PLUS)
+        {
+            z = _mm_add_epi64(x, y);
+            ov = _mm_or_si128(ov, ADD_OVERFLOW_SSE2(x, y, z));
+        }
+        else
+        {
+            z = _mm_sub_epi64(x, y);
+            ov = _mm_or_si128(ov, SUB_OVERFLOW_SSE2(x, y, z));
+        }
+        _mm_storeu_si128((__m128i *)(out + i), z);
+    }
+    *overflow = _mm_movemask_pd(_mm_castsi128_pd(ov)) != 0;
+    return i;
+}
+
+// * runs while both sides fit in 32 bits, whose 64-bit product can't
+// overflow, and leaves the rest to the checked scalar loop
+AVX2 static size_t int_multiply_avx2(const int64_t *l, size_t ls, const int64_t *r, size_t rs, int64_t *out, size_t n)
+{
+    // A scalar side is checked once, up front
+    if ((!ls && (l[0] < INT32_MIN || l[0] > INT32_MAX)) || (!rs && (r[0] < INT32_MIN || r[0] > INT32_MAX)))
+        return 0;
+    __m256i lb = _mm256_set1_epi64x(l[0]);
+    __m256i rb = _mm256_set1_epi64x(r[0]);
+    __m256i min = _mm256_set1_epi64x(INT32_MIN);
+    __m256i max = _mm256_set1_epi64x(INT32_MAX);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i x = lb;
+        __m256i y = rb;
+        __m256i wide = _mm256_setzero_si256();
+        if (ls)
+        {
+            x = _mm256_loadu_si256((const __m256i *)(l + i));
+            wide = WIDE_AVX2(x, min, max);
+        }
+        if (rs)
+        {
+            y = _mm256_loadu_si256((const __m256i *)(r + i));
+            wide = _mm256_or_si256(wide, WIDE_AVX2(y, min, max));
+        }
+        if (!_mm256_testz_si256(wide, wide))
+            break;
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_mul_epi32(x, y));
+    }
+    return i;
+}
+
+// One vector of + or -, folding its overflow lanes into `ov`
+#define INT_STEP_AVX2(op, at)                                                \
+    {                                                                        \
+        __m256i x = ls ? _mm256_loadu_si256((const __m256i *)(l + (at))) : lb;\
+        __m256i y = rs ? _mm256_loadu_si256((const __m256i *)(r + (at))) : rb;\
+        __m256i z;                                                           \
+        if (op == TOKEN_PLUS)                                                \
+        {                                                                    \
+            z = _mm256_add_epi64(x, y);                                      \
+            ov = _mm256_or_si256(ov, ADD_OVERFLOW_AVX2(x, y, z));            \
+        }                                                                    \
+        else                                                                 \
+        {                                                                    \
+            z = _mm256_sub_epi64(x, y);                                      \
+            ov = _mm256_or_si256(ov, SUB_OVERFLOW_AVX2(x, y, z));            \
+        }                                                                    \
+        _mm256_storeu_si256((__m256i *)(out + (at)), z);                     \
+    }
+
+// x + c overflows exactly where x passes INT64_MAX - c (or INT64_MIN - c
+// for negative c), which takes one compare rather than the general test
+AVX2 static size_t int_offset_avx2(const int64_t *l, int64_t c, int64_t *out, size_t n, int *overflow)
+{
+    __m256i cb = _mm256_set1_epi64x(c);
+    __m256i limit = _mm256_set1_epi64x(c >= 0 ? INT64_MAX - c : INT64_MIN - c);
+    __m256i ov = _mm256_setzero_si256();
+    size_t i = 0;
+    if (c >= 0)
+    {
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(l + i));
+            ov = _mm256_or_si256(ov, _mm256_cmpgt_epi64(x, limit));
+            _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(x, cb));
+        }
+    }
+    else
+    {
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(l + i));
+            ov = _mm256_or_si256(ov, _mm256_cmpgt_epi64(limit, x));
+            _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(x, cb));
+        }
+    }
+    *overflow = !_mm256_testz_si256(ov, ov);
+    return i;
+}
+
+AVX2 static size_t int_elementwise_avx2(int op, const int64_t *l, size_t ls, const int64_t *r, size_t rs,
+                                        int64_t *out, size_t n, int *overflow)
+{
+    if (op == TOKEN_MUL)
+        return int_multiply_avx2(l, ls, r, rs, out, n);
+    if (ls && !rs && (op == TOKEN_PLUS || r[0] != INT64_MIN))
+        return int_offset_avx2(l, op == TOKEN_PLUS ? r[0] : -r[0], out, n, overflow);
+    __m256i lb = _mm256_set1_epi64x(l[0]);
+    __m256i rb = _mm256_set1_epi64x(r[0]);
+    __m256i ov = _mm256_setzero_si256();
+    size_t i = 0;
+    // Two vectors a round: unoptimized builds pay a lot per iteration
+    if (op == TOKEN_PLUS)
+    {
+        for (; i + 8 <= n; i += 8)
+        {
+            INT_STEP_AVX2(TOKEN_PLUS, i)
+            INT_STEP_AVX2(TOKEN_PLUS, i + 4)
+        }
+    }
+    else
+    {
+        for (; i + 8 <= n; i += 8)
+        {
+            INT_STEP_AVX2(TOKEN_MINUS, i)
+            INT_STEP_AVX2(TOKEN_MINUS, i + 4)
+        }
+    }
+    *overflow = _mm256_movemask_pd(_mm256_castsi256_pd(ov)) != 0;
+    return i;
+}
+
+static size_t float_elementwise_sse2(int op, const double *l, size_t ls, const double *r, size_t rs, double *out, size_t n)
+{
+    __m128d lb = _mm_set1_pd(l[0]);
+    __m128d rb = _mm_set1_pd(r[0]);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d x = ls ? _mm_loadu_pd(l + i) : lb;
+        __m128d y = rs ? _mm_loadu_pd(r + i) : rb;
+        __m128d z;
+        switch (op)
+        {
+        case TOKEN_PLUS:
+            z = _mm_add_pd(x, y);
+            break;
+        case TOKEN_MINUS:
+            z = _mm_sub_pd(x, y);
+            break;
+        case TOKEN_MUL:
+            z = _mm_mul_pd(x, y);
+            break;
+        default:
+            z = _mm_div_pd(x, y);
+            break;
+        }
+        _mm_storeu_pd(out + i, z);
+    }
+    return i;
+}
+
+AVX2 static size_t float_elementwise_avx2(int op, const double *l, size_t ls, const double *r, size_t rs, double *out, size_t n)
+{
+    __m256d lb = _mm256_set1_pd(l[0]);
+    __m256d rb = _mm256_set1_pd(r[0]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d x = ls ? _mm256_loadu_pd(l + i) : lb;
+        __m256d y = rs ? _mm256_loadu_pd(r + i) : rb;
+        __m256d z;
+        switch (op)
+        {
+        case TOKEN_PLUS:
+            z = _mm256_add_pd(x, y);
+            break;
+        case TOKEN_MINUS:
+            z = _mm256_sub_pd(x, y);
+            break;
+        case TOKEN_MUL:
+            z = _mm256_mul_pd(x, y);
+            break;
+        default:
+            z = _mm256_div_pd(x, y);
+            break;
+        }
+        _mm256_storeu_pd(out + i, z);
+    }
+    return i;
+}
+
+#endif
+
+// Returns 1 if any element overflowed, leaving `out` partly written
+static int int_elementwise(int op, const int64_t *l, size_t ls, const int64_t *r, size_t rs, int64_t *out, size_t n)
+{
+    size_t i = 0;
+    int overflow = 0;
+#ifdef ARRAY_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        i = int_elementwise_avx2(op, l, ls, r, rs, out, n, &overflow);
+    else
+        i = int_elementwise_sse2(op, l, ls, r, rs, out, n, &overflow);
+#endif
+    for (; i < n && !overflow; i++)
+    {
+        overflow = int_apply(op, l[i * ls], r[i * rs], &out[i]);
+    }
+    return overflow;
+}
+
+// Truncating like value_int_op(), with no vector form. A zero divisor
+// gives 0 and sets `*zero`; INT64_MIN / -1 sets `*overflow`.
+static void int_divide(const int64_t *l, size_t ls, const int64_t *r, size_t rs, int64_t *out, size_t n, int *zero,
+                       int *overflow)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        int64_t x = l[i * ls];
+        int64_t y = r[i * rs];
+        if (y == 0)
+        {
+            out[i] = 0;
+            *zero = 1;
+        }
+        else if (y == -1 && x == INT64_MIN)
+        {
+            *overflow = 1;
+            return;
+        }
+        else
+        {
+            out[i] = x / y;
+        }
+    }
+}
+
+// Division by zero gives 0.0 rather than an infinity or NaN; returns 1 if
+// any divisor was zero.
+static int float_elementwise(int op, const double *l, size_t ls, const double *r, size_t rs, double *out, size_t n)
+{
+    size_t i = 0;
+#ifdef ARRAY_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        i = float_elementwise_avx2(op, l, ls, r, rs, out, n);
+    else
+        i = float_elementwise_sse2(op, l, ls, r, rs, out, n);
+#endif
+    for (; i < n; i++)
+    {
+        out[i] = float_apply(op, l[i * ls], r[i * rs]);
+    }
+
+    int zero = 0;
+    if (op == TOKEN_DIV)
+    {
+        for (i = 0; i < n; i++)
+        {
+            if (r[i * rs] == 0)
+            {
+                out[i] = 0.0;
+                zero = 1;
+            }
+        }
+    }
+    return zero;
+}
+
+// ---------------------------------------------------------------------------
+// Reductions. Float ones keep four partial results, lane j taking the
+// elements i with i % 4 == j up to the last multiple of four, combine them
+// as (0 with 1) with (2 with 3), then fold in the tail in order. Every
+// implementation follows that exact order, so they agree to the bit. min
+// and max use the minpd/maxpd rule, `acc < x ? acc : x`, with NaN tracked
+// on the side.
+
+enum
+{
+    REDUCE_SUM,
+    REDUCE_MIN,
+    REDUCE_MAX,
+    REDUCE_DOT
+};
+
+static inline int64_t int_extreme(int how, int64_t acc, int64_t x)
+{
+    if (how == REDUCE_MIN)
+        return x < acc ? x : acc;
+    return x > acc ? x : acc;
+}
+
+static inline double float_step(int how, double acc, double x)
+{
+    switch (how)
+    {
+    case REDUCE_MIN:
+        return acc < x ? acc : x;
+    case REDUCE_MAX:
+        return acc > x ? acc : x;
+    default:
+        return acc + x;
+    }
+}
+
+#ifdef ARRAY_SIMD
+
+// Int sums and extremes don't depend on the order, so the lanes are
+// simply folded into `*total` at the end. Sums are checked for overflow
+// lane by lane and set `*overflow` rather than wrap.
+static size_t int_reduce_sse2(int how, const int64_t *x, size_t n, int64_t *total, int *overflow)
+{
+    if (how != REDUCE_SUM)
+        return 0; // pcmpgtq needs SSE4.2
+    __m128i acc = _mm_setzero_si128();
+    __m128i ov = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i sum = _mm_add_epi64(acc, v);
+        ov = _mm_or_si128(ov, ADD_OVERFLOW_SSE2(acc, v, sum));
+        acc = sum;
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    *overflow = _mm_movemask_pd(_mm_castsi128_pd(ov)) != 0;
+    for (int j = 0; j < 2 && !*overflow; j++)
+    {
+        *overflow = int_add_overflow(*total, lanes[j], total);
+    }
+    return i;
+}
+
+AVX2 static size_t int_reduce_avx2(int how, const int64_t *x, size_t n, int64_t *total, int *overflow)
+{
+    __m256i acc = how == REDUCE_SUM ? _mm256_setzero_si256() : _mm256_set1_epi64x(*total);
+    __m256i ov = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        switch (how)
+        {
+        case REDUCE_MIN:
+            acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+            break;
+        case REDUCE_MAX:
+            acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+            break;
+        default:
+        {
+            __m256i sum = _mm256_add_epi64(acc, v);
+            ov = _mm256_or_si256(ov, ADD_OVERFLOW_AVX2(acc, v, sum));
+            acc = sum;
+            break;
+        }
+        }
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    *overflow = _mm256_movemask_pd(_mm256_castsi256_pd(ov)) != 0;
+    for (int j = 0; j < 4 && !*overflow; j++)
+    {
+        if (how == REDUCE_SUM)
+            *overflow = int_add_overflow(*total, lanes[j], total);
+        else
+            *total = int_extreme(how, *total, lanes[j]);
+    }
+    return i;
+}
+
+static int float_lanes_sse2(int how, const double *x, const double *y, size_t from, size_t to, double *lane)
+{
+    __m128d a01 = _mm_loadu_pd(lane);
+    __m128d a23 = _mm_loadu_pd(lane + 2);
+    __m128d nan = _mm_setzero_pd();
+    for (size_t i = from; i < to; i += 4)
+    {
+        __m128d v01 = _mm_loadu_pd(x + i);
+        __m128d v23 = _mm_loadu_pd(x + i + 2);
+        switch (how)
+        {
+        case REDUCE_MIN:
+            nan = _mm_or_pd(nan, _mm_or_pd(_mm_cmpunord_pd(v01, v01), _mm_cmpunord_pd(v23, v23)));
+            a01 = _mm_min_pd(a01, v01);
+            a23 = _mm_min_pd(a23, v23);
+            break;
+        case REDUCE_MAX:
+            nan = _mm_or_pd(nan, _mm_or_pd(_mm_cmpunord_pd(v01, v01), _mm_cmpunord_pd(v23, v23)));
+            a01 = _mm_max_pd(a01, v01);
+            a23 = _mm_max_pd(a23, v23);
+            break;
+        case REDUCE_DOT:
+            v01 = _mm_mul_pd(v01, _mm_loadu_pd(y + i));
+            v23 = _mm_mul_pd(v23, _mm_loadu_pd(y + i + 2));
+            // fall through
+        default:
+            a01 = _mm_add_pd(a01, v01);
+            a23 = _mm_add_pd(a23, v23);
+            break;
+        }
+    }
+    _mm_storeu_pd(lane, a01);
+    _mm_storeu_pd(lane + 2, a23);
+    return _mm_movemask_pd(nan) != 0;
+}
+
+AVX2 static int float_lanes_avx2(int how, const double *x, const double *y, size_t from, size_t to, double *lane)
+{
+    __m256d acc = _mm256_loadu_pd(lane);
+    __m256d nan = _mm256_setzero_pd();
+    for (size_t i = from; i < to; i += 4)
+    {
+        __m256d v = _mm256_loadu_pd(x + i);
+        switch (how)
+        {
+        case REDUCE_MIN:
+            nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+            acc = _mm256_min_pd(acc, v);
+            break;
+        case REDUCE_MAX:
+            nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+            acc = _mm256_max_pd(acc, v);
+            break;
+        case REDUCE_DOT:
+            v = _mm256_mul_pd(v, _mm256_loadu_pd(y + i));
+            // fall through
+        default:
+            acc = _mm256_add_pd(acc, v);
+            break;
+        }
+    }
+    _mm256_storeu_pd(lane, acc);
+    return _mm256_movemask_pd(nan) != 0;
+}
+
+#endif
+
+// Sets `*total`; returns 0 instead if a sum or dot product overflowed.
+// min and max need n > 0. Dot products are scalar, for want of a 64-bit
+// vector multiply.
+static int int_reduce(int how, const int64_t *x, const int64_t *y, size_t n, int64_t *total)
+{
+    *total = how == REDUCE_MIN || how == REDUCE_MAX ? x[0] : 0;
+    int overflow = 0;
+    size_t i = 0;
+#ifdef ARRAY_SIMD
+    if (how != REDUCE_DOT && __builtin_cpu_supports("avx2"))
+        i = int_reduce_avx2(how, x, n, total, &overflow);
+    else if (how != REDUCE_DOT)
+        i = int_reduce_sse2(how, x, n, total, &overflow);
+#endif
+    for (; i < n && !overflow; i++)
+    {
+        int64_t product;
+        if (how == REDUCE_DOT)
+            overflow = int_mul_overflow(x[i], y[i], &product) || int_add_overflow(*total, product, total);
+        else if (how == REDUCE_SUM)
+            overflow = int_add_overflow(*total, x[i], total);
+        else
+            *total = int_extreme(how, *total, x[i]);
+    }
+    return !overflow;
+}
+
+// Sets `*nan` for a min or max over a NaN. min and max need n > 0.
+static double float_reduce(int how, const double *x, const double *y, size_t n, int *nan)
+{
+    int extreme = how == REDUCE_MIN || how == REDUCE_MAX;
+    size_t n4 = n & ~(size_t)3;
+    size_t i = 0;
+    double total;
+    *nan = 0;
+
+    if (n4 > 0)
+    {
+        double lane[4] = {0.0, 0.0, 0.0, 0.0};
+        if (extreme)
+        {
+            // The first four elements seed the lanes
+            memcpy(lane, x, sizeof(lane));
+            i = 4;
+        }
+#ifdef ARRAY_SIMD
+        if (__builtin_cpu_supports("avx2"))
+            *nan = float_lanes_avx2(how, x, y, i, n4, lane);
+        else
+            *nan = float_lanes_sse2(how, x, y, i, n4, lane);
+        i = n4;
+#endif
+        for (; i < n4; i += 4)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                double v = how == REDUCE_DOT ? x[i + j] * y[i + j] : x[i + j];
+                *nan |= extreme && v != v;
+                lane[j] = float_step(how, lane[j], v);
+            }
+        }
+        total = float_step(how, float_step(how, lane[0], lane[1]), float_step(how, lane[2], lane[3]));
+        if (extreme)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                *nan |= x[j] != x[j];
+            }
+        }
+    }
+    else if (extreme)
+    {
+        total = x[0];
+        *nan = total != total;
+        i = 1;
+    }
+    else
+    {
+        total = 0.0;
+    }
+
+    for (; i < n; i++)
+    {
+        double v = how == REDUCE_DOT ? x[i] * y[i] : x[i];
+        *nan |= extreme && v != v;
+        total = float_step(how, total, v);
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------------------
+// Array values
+
+// The ints of an int operand: an array's own elements (step 1), or the
+// scalar itself (step 0)
+static const int64_t *int_operand(Value v, int64_t *scalar, size_t *step)
+{
+    if (value_is_array(v))
+    {
+        *step = 1;
+        return value_as_array(v)->ints;
+    }
+    *scalar = value_as_int(v);
+    *step = 0;
+    return scalar;
+}
+
+// The elements of an int or float array as doubles. Int arrays are
+// converted into a buffer left in `*owned` for the caller to free.
+static const double *float_elements(const LoArray *a, double **owned)
+{
+    *owned = NULL;
+    if (a->kind == ARRAY_FLOAT)
+        return a->floats;
+    *owned = (double *)malloc((a->count > 0 ? a->count : 1) * sizeof(double));
+    for (uint32_t i = 0; i < a->count; i++)
+    {
+        (*owned)[i] = (double)a->ints[i];
+    }
+    return *owned;
+}
+
+// int_operand() for a number operand, as doubles
+static const double *float_operand(Value v, double *scalar, size_t *step, double **owned)
+{
+    if (value_is_array(v))
+    {
+        *step = 1;
+        return float_elements(value_as_array(v), owned);
+    }
+    *owned = NULL;
+    *scalar = value_is_int(v) ? (double)value_as_int(v) : value_as_float(v);
+    *step = 0;
+    return scalar;
+}
+
+// Element `i` of an operand of an element-wise op, copied
+static Value operand_element(Value v, uint32_t i)
+{
+    return value_is_array(v) ? array_get(value_as_array(v), i) : value_copy(v);
+}
+
+// array_binary_op() one element at a time, through value_binary_op()
+static Value elementwise_boxed(int op, Value left, Value right, uint32_t n)
+{
+    Value *results = (Value *)malloc((n > 0 ? n : 1) * sizeof(Value));
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Value l = operand_element(left, i);
+        Value r = operand_element(right, i);
+        results[i] = value_binary_op(op, l, r);
+        value_free(l);
+        value_free(r);
+    }
+    Value v = array_from_values(results, n);
+    free(results);
+    return v;
+}
+
+Value array_binary_op(int op, Value left, Value right)
+{
+    LoArray *la = value_is_array(left) ? value_as_array(left) : NULL;
+    LoArray *ra = value_is_array(right) ? value_as_array(right) : NULL;
+    if (la != NULL && ra != NULL && la->count != ra->count)
+    {
+        err_printf("Runtime Error: Array lengths differ (%u and %u)\n", la->count, ra->count);
+        return value_none();
+    }
+    uint32_t n = la != NULL ? la->count : ra->count;
+    ArrayKind lk = la != NULL ? (ArrayKind)la->kind : kind_of(left);
+    ArrayKind rk = ra != NULL ? (ArrayKind)ra->kind : kind_of(right);
+
+    // Anything but numbers goes element by element, so nested arrays
+    // broadcast recursively
+    if (lk == ARRAY_BOXED || rk == ARRAY_BOXED)
+        return elementwise_boxed(op, left, right, n);
+
+    int zero = 0;
+    LoArray *out;
+    if (lk == ARRAY_INT && rk == ARRAY_INT)
+    {
+        int64_t l_scalar, r_scalar;
+        size_t ls, rs;
+        const int64_t *l = int_operand(left, &l_scalar, &ls);
+        const int64_t *r = int_operand(right, &r_scalar, &rs);
+        int overflow = 0;
+        out = array_new(ARRAY_INT, n);
+        if (n > 0 && op == TOKEN_DIV)
+            int_divide(l, ls, r, rs, out->ints, n, &zero, &overflow);
+        else if (n > 0)
+            overflow = int_elementwise(op, l, ls, r, rs, out->ints, n);
+        if (overflow)
+        {
+            // Rare enough to just start over, with bigints where needed
+            array_destroy(out);
+            return elementwise_boxed(op, left, right, n);
+        }
+    }
+    else
+    {
+        double l_scalar, r_scalar;
+        size_t ls, rs;
+        double *l_owned, *r_owned;
+        const double *l = float_operand(left, &l_scalar, &ls, &l_owned);
+        const double *r = float_operand(right, &r_scalar, &rs, &r_owned);
+        out = array_new(ARRAY_FLOAT, n);
+        if (n > 0)
+            zero = float_elementwise(op, l, ls, r, rs, out->floats, n);
+        free(l_owned);
+        free(r_owned);
+    }
+    out->count = n;
+    // Once per operation, not per element
+    if (zero)
+        err_printf("Runtime Error: Division by zero\n");
+    return value_from_array(out);
+}
+
+// Whatever + means for the elements, starting from 0
+static Value sum_boxed(const LoArray *a)
+{
+    Value total = value_int(0);
+    for (uint32_t i = 0; i < a->count; i++)
+    {
+        Value x = array_get(a, i);
+        Value next = value_binary_op(TOKEN_PLUS, total, x);
+        value_free(x);
+        value_free(total);
+        total = next;
+    }
+    return total;
+}
+
+Value array_sum(const LoArray *a)
+{
+    int nan;
+    int64_t total;
+    switch (a->kind)
+    {
+    case ARRAY_INT:
+        if (int_reduce(REDUCE_SUM, a->ints, NULL, a->count, &total))
+            return value_from_int64(total);
+        return sum_boxed(a); // Overflowed: redo it exactly
+    case ARRAY_FLOAT:
+        return value_float(float_reduce(REDUCE_SUM, a->floats, NULL, a->count, &nan));
+    default:
+        return sum_boxed(a);
+    }
+}
+
+static Value extreme(const LoArray *a, int how, const char *name)
+{
+    if (a->count == 0)
+    {
+        err_printf("Runtime Error: %s() of an empty array\n", name);
+        return value_none();
+    }
+
+    int nan;
+    int64_t best_int;
+    switch (a->kind)
+    {
+    case ARRAY_INT:
+        int_reduce(how, a->ints, NULL, a->count, &best_int);
+        return value_from_int64(best_int);
+    case ARRAY_FLOAT:
+    {
+        double v = float_reduce(how, a->floats, NULL, a->count, &nan);
+        return value_float(nan ? NAN : v);
+    }
+    default:
+        break;
+    }
+
+    // Boxed ints and floats, compared as numbers; the winner keeps its type.
+    // Two ints compare exactly even when they are bigints.
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < a->count; i++)
+    {
+        Value v = a->values[i];
+        if (!value_is_integer(v) && !value_is_float(v))
+        {
+            err_printf("Runtime Error: %s() needs numbers\n", name);
+            return value_none();
+        }
+        if (value_is_float(v) && value_as_float(v) != value_as_float(v))
+            return value_float(NAN);
+        Value b = a->values[best];
+        int order;
+        if (value_is_integer(v) && value_is_integer(b))
+            order = bigint_compare(v, b);
+        else
+            order = (value_as_number(v) > value_as_number(b)) - (value_as_number(v) < value_as_number(b));
+        if (how == REDUCE_MIN ? order < 0 : order > 0)
+            best = i;
+    }
+    return value_copy(a->values[best]);
+}
+
+Value array_min(const LoArray *a)
+{
+    return extreme(a, REDUCE_MIN, "min");
+}
+
+Value array_max(const LoArray *a)
+{
+    return extreme(a, REDUCE_MAX, "max");
+}
+
+Value array_dot(const LoArray *a, const LoArray *b)
+{
+    if (a->count != b->count)
+    {
+        err_printf("Runtime Error: Array lengths differ (%u and %u)\n", a->count, b->count);
+        return value_none();
+    }
+    uint32_t n = a->count;
+
+    int64_t int_total;
+    if (a->kind == ARRAY_INT && b->kind == ARRAY_INT && int_reduce(REDUCE_DOT, a->ints, b->ints, n, &int_total))
+        return value_from_int64(int_total);
+
+    // Boxed elements, or an int product that overflowed and is redone exactly
+    if (a->kind == ARRAY_BOXED || b->kind == ARRAY_BOXED || (a->kind == ARRAY_INT && b->kind == ARRAY_INT))
+    {
+        Value total = value_int(0);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            Value l = array_get(a, i);
+            Value r = array_get(b, i);
+            Value product = value_binary_op(TOKEN_MUL, l, r);
+            Value next = value_binary_op(TOKEN_PLUS, total, product);
+            value_free(l);
+            value_free(r);
+            value_free(product);
+            value_free(total);
+            total = next;
+        }
+        return total;
+    }
+
+    double *x_owned, *y_owned;
+    const double *x = float_elements(a, &x_owned);
+    const double *y = float_elements(b, &y_owned);
+    int nan;
+    double total = float_reduce(REDUCE_DOT, x, y, n, &nan);
+    free(x_owned);
+    free(y_owned);
+    return value_float(total);
+}
+
+void array_print(const LoArray *a, int depth)
+{
+    if (depth > VALUE_PRINT_DEPTH)
+    {
+        out_write("[...]", 5);
+        return;
+    }
+    out_write("[", 1);
+    for (uint32_t i = 0; i < a->count; i++)
+    {
+        if (i > 0)
+            out_write(", ", 2);
+        if (a->kind == ARRAY_BOXED)
+        {
+            value_print_nested(a->values[i], depth + 1);
+        }
+        else
+        {
+            Value v = array_get(a, i);
+            value_print(v);
+            value_free(v);
+        }
+    }
+    out_write("]", 1);
+}
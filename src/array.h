@@ -0,0 +1,52 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include "value.h"
+
+// Arrays of values (LoArray, value.h). Arithmetic on whole arrays and the
+// reductions run as SIMD kernels on x86-64 builds with GCC or Clang: SSE2,
+// or AVX2 when the CPU has it. Other targets use plain loops. Every path
+// gives the same results, bit for bit: float reductions always add up four
+// interleaved partial sums and combine them in the same order.
+
+// An empty array of `kind` with room for `capacity` elements, refcount 1.
+LoArray *array_new(ArrayKind kind, uint32_t capacity);
+
+// An array holding `values`, unboxed if they are all ints or all floats.
+// Takes ownership of the values, not of the buffer.
+Value array_from_values(Value *values, uint32_t count);
+
+// `count` copies of `fill`, unboxed if it is an int or a float.
+Value array_filled(uint32_t count, Value fill);
+
+// Element `i` (in range), copied.
+Value array_get(const LoArray *a, uint32_t i);
+// Stores a copy of `v` at `i` (in range), boxing the array if it must.
+void array_set(LoArray *a, uint32_t i, Value v);
+void array_append(LoArray *a, Value v);
+
+// target[index] and target[index] = v, reporting run-time errors for
+// anything but an array and an int index in range. Negative indices count
+// from the end. Neither takes ownership of its operands.
+Value array_index(Value target, Value index);
+void array_store(Value target, Value index, Value v);
+
+// value_binary_op() for arithmetic with an array on either side: the
+// array of `op` applied element by element, where a non-array operand
+// pairs with every element. Arrays of different lengths give None. Int
+// elements that overflow promote to bigints, boxing the result.
+Value array_binary_op(int op, Value left, Value right);
+
+// Reductions. Sums and dot products of ints are exact, promoting to a
+// bigint like int arithmetic; min() and max() of floats are NaN if any
+// element is NaN.
+// Errors are reported and give None.
+Value array_sum(const LoArray *a);
+Value array_min(const LoArray *a);
+Value array_max(const LoArray *a);
+Value array_dot(const LoArray *a, const LoArray *b);
+
+// Prints `[1, 2, 3]`; see value_print_nested().
+void array_print(const LoArray *a, int depth);
+
+#endif
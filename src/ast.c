@@ -1,150 +1,543 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include "ast.h"
+#include "symbol.h"
+#include "token.h"
+#include "output.h"
 
-static ASTNode *ast_create_node(ASTNodeType type)
+void ast_init(AST *ast)
 {
-    ASTNode *node = (ASTNode *)malloc(sizeof(ASTNode));
+    memset(ast, 0, sizeof(AST));
+    ast_reset(ast);
+}
+
+void ast_reset(AST *ast)
+{
+    for (uint32_t i = 0; i < ast->string_count; i++)
+    {
+        value_free(ast->strings[i]);
+    }
+    ast->count = 0;
+    ast->extra_count = 0;
+    ast->float_count = 0;
+    ast->string_count = 0;
+
+    // Reserve node 0 for AST_NONE
+    if (ast->capacity == 0)
+    {
+        ast->capacity = 64;
+        ast->nodes = (ASTNode *)malloc(ast->capacity * sizeof(ASTNode));
+    }
+    memset(&ast->nodes[0], 0, sizeof(ASTNode));
+    if (ast->positions != NULL)
+        memset(&ast->positions[0], 0, sizeof(SourcePos));
+    ast->count = 1;
+}
+
+void ast_track_positions(AST *ast)
+{
+    if (ast->positions != NULL)
+        return;
+    ast->positions = (SourcePos *)calloc(ast->capacity, sizeof(SourcePos));
+}
+
+void ast_fill_positions(AST *ast, NodeId first, SourcePos pos)
+{
+    if (ast->positions == NULL)
+        return;
+    for (NodeId id = first; id < ast->count; id++)
+    {
+        if (ast->positions[id].line == 0)
+            ast->positions[id] = pos;
+    }
+}
+
+void ast_copy_position(AST *ast, NodeId to, NodeId from)
+{
+    if (ast->positions != NULL)
+        ast->positions[to] = ast->positions[from];
+}
+
+void ast_free(AST *ast)
+{
+    for (uint32_t i = 0; i < ast->string_count; i++)
+    {
+        value_free(ast->strings[i]);
+    }
+    free(ast->nodes);
+    free(ast->extra);
+    free(ast->floats);
+    free(ast->strings);
+    free(ast->positions);
+    memset(ast, 0, sizeof(AST));
+}
+
+_Static_assert(sizeof(ASTNode) == 16, "ASTNode should stay 16 bytes");
+
+static NodeId ast_create_node(AST *ast, ASTNodeType type)
+{
+    if (ast->count >= ast->capacity)
+    {
+        ast->capacity *= 2;
+        ast->nodes = (ASTNode *)realloc(ast->nodes, ast->capacity * sizeof(ASTNode));
+        if (ast->positions != NULL)
+            ast->positions = (SourcePos *)realloc(ast->positions, ast->capacity * sizeof(SourcePos));
+    }
+    NodeId id = ast->count++;
+    if (ast->positions != NULL)
+        memset(&ast->positions[id], 0, sizeof(SourcePos));
+    ASTNode *node = &ast->nodes[id];
+    memset(node, 0, sizeof(ASTNode));
     node->type = type;
-    return node;
+    return id;
+}
+
+NodeId ast_create_int(AST *ast, int64_t value)
+{
+    NodeId id = ast_create_node(ast, AST_INT);
+    ast->nodes[id].int_val.lo = (uint32_t)value;
+    ast->nodes[id].int_val.hi = (uint32_t)((uint64_t)value >> 32);
+    return id;
 }
 
-ASTNode *ast_create_int(int value)
+NodeId ast_create_float(AST *ast, double value)
 {
-    ASTNode *node = ast_create_node(AST_INT);
-    node->int_val = value;
-    return node;
+    if (ast->float_count >= ast->float_capacity)
+    {
+        ast->float_capacity = ast->float_capacity == 0 ? 16 : ast->float_capacity * 2;
+        ast->floats = (double *)realloc(ast->floats, ast->float_capacity * sizeof(double));
+    }
+    NodeId id = ast_create_node(ast, AST_FLOAT);
+    ast->floats[ast->float_count] = value;
+    ast->nodes[id].float_index = ast->float_count++;
+    return id;
 }
 
-ASTNode *ast_create_float(double value)
+// A node of `type` whose literal, owned by the AST, goes in AST.strings
+static NodeId create_literal(AST *ast, ASTNodeType type, Value value)
 {
-    ASTNode *node = ast_create_node(AST_FLOAT);
-    node->float_val = value;
-    return node;
+    if (ast->string_count >= ast->string_capacity)
+    {
+        ast->string_capacity = ast->string_capacity == 0 ? 16 : ast->string_capacity * 2;
+        ast->strings = (Value *)realloc(ast->strings, ast->string_capacity * sizeof(Value));
+    }
+    NodeId id = ast_create_node(ast, type);
+    ast->strings[ast->string_count] = value;
+    ast->nodes[id].string_index = ast->string_count++;
+    return id;
 }
 
-ASTNode *ast_create_string(char *value)
+NodeId ast_create_string(AST *ast, const char *value, int length)
 {
-    ASTNode *node = ast_create_node(AST_STRING);
-    node->string_val = strdup(value);
-    return node;
+    return create_literal(ast, AST_STRING, value_string(value, length));
 }
 
-ASTNode *ast_create_identifier(char *name)
+NodeId ast_create_bigint(AST *ast, Value value)
 {
-    ASTNode *node = ast_create_node(AST_IDENTIFIER);
-    node->string_val = strdup(name);
-    return node;
+    return create_literal(ast, AST_BIGINT, value);
 }
 
-ASTNode *ast_create_binary(int op, ASTNode *left, ASTNode *right)
+NodeId ast_create_identifier(AST *ast, int sym)
 {
-    ASTNode *node = ast_create_node(AST_BINARY_OP);
-    node->binary.op = op;
-    node->binary.left = left;
-    node->binary.right = right;
-    return node;
+    NodeId id = ast_create_node(ast, AST_IDENTIFIER);
+    ast->nodes[id].identifier.sym = sym;
+    ast->nodes[id].identifier.slot = -1;
+    return id;
 }
 
-ASTNode *ast_create_assignment(char *name, ASTNode *value)
+NodeId ast_create_binary(AST *ast, int op, NodeId left, NodeId right)
 {
-    ASTNode *node = ast_create_node(AST_ASSIGNMENT);
-    node->assignment.name = strdup(name);
-    node->assignment.value = value;
-    return node;
+    NodeId id = ast_create_node(ast, AST_BINARY_OP);
+    ast->nodes[id].op = (uint8_t)op;
+    ast->nodes[id].binary.left = left;
+    ast->nodes[id].binary.right = right;
+    return id;
 }
 
-ASTNode *ast_create_if(ASTNode *condition, ASTNode *then_branch, ASTNode *else_branch)
+NodeId ast_create_assignment(AST *ast, int sym, NodeId value)
 {
-    ASTNode *node = ast_create_node(AST_IF);
-    node->if_stmt.condition = condition;
-    node->if_stmt.then_branch = then_branch;
-    node->if_stmt.else_branch = else_branch;
-    return node;
+    NodeId id = ast_create_node(ast, AST_ASSIGNMENT);
+    ast->nodes[id].assignment.sym = sym;
+    ast->nodes[id].assignment.slot = -1;
+    ast->nodes[id].assignment.value = value;
+    return id;
 }
 
-ASTNode *ast_create_while(ASTNode *condition, ASTNode *body)
+NodeId ast_create_if(AST *ast, NodeId condition, NodeId then_branch, NodeId else_branch)
 {
-    ASTNode *node = ast_create_node(AST_WHILE);
-    node->while_loop.condition = condition;
-    node->while_loop.body = body;
-    return node;
+    NodeId id = ast_create_node(ast, AST_IF);
+    ast->nodes[id].if_stmt.condition = condition;
+    ast->nodes[id].if_stmt.then_branch = then_branch;
+    ast->nodes[id].if_stmt.else_branch = else_branch;
+    return id;
 }
 
-ASTNode *ast_create_print(ASTNode *expr)
+NodeId ast_create_while(AST *ast, NodeId condition, NodeId body)
 {
-    ASTNode *node = ast_create_node(AST_PRINT);
-    node->print_stmt.expr = expr;
-    return node;
+    NodeId id = ast_create_node(ast, AST_WHILE);
+    ast->nodes[id].while_loop.condition = condition;
+    ast->nodes[id].while_loop.body = body;
+    return id;
 }
 
-ASTNode *ast_create_block()
+NodeId ast_create_print(AST *ast, NodeId expr)
 {
-    ASTNode *node = ast_create_node(AST_BLOCK);
-    node->block.statements = NULL;
-    node->block.count = 0;
-    node->block.capacity = 0;
-    return node;
+    NodeId id = ast_create_node(ast, AST_PRINT);
+    ast->nodes[id].print_stmt.expr = expr;
+    return id;
 }
 
-void ast_block_add(ASTNode *block, ASTNode *stmt)
+// Appends `count` words to AST.extra and returns where they start
+static uint32_t extra_append(AST *ast, const uint32_t *items, int count)
 {
-    if (block->type != AST_BLOCK)
-        return;
+    if (ast->extra_count + count > ast->extra_capacity)
+    {
+        uint32_t new_capacity = ast->extra_capacity == 0 ? 64 : ast->extra_capacity;
+        while (ast->extra_count + count > new_capacity)
+        {
+            new_capacity *= 2;
+        }
+        ast->extra = (NodeId *)realloc(ast->extra, new_capacity * sizeof(NodeId));
+        ast->extra_capacity = new_capacity;
+    }
+    uint32_t start = ast->extra_count;
+    if (count > 0)
+        memcpy(ast->extra + start, items, count * sizeof(uint32_t));
+    ast->extra_count += count;
+    return start;
+}
+
+NodeId ast_create_block(AST *ast, const NodeId *statements, int count)
+{
+    uint32_t start = extra_append(ast, statements, count);
+    NodeId id = ast_create_node(ast, AST_BLOCK);
+    ast->nodes[id].block.start = start;
+    ast->nodes[id].block.count = count;
+    return id;
+}
+
+NodeId ast_create_call(AST *ast, int sym, const NodeId *args, int count)
+{
+    uint32_t start = extra_append(ast, args, count);
+    NodeId id = ast_create_node(ast, AST_CALL);
+    ast->nodes[id].call.sym = sym;
+    ast->nodes[id].call.start = start;
+    ast->nodes[id].call.count = count;
+    return id;
+}
+
+NodeId ast_create_return(AST *ast, NodeId value)
+{
+    NodeId id = ast_create_node(ast, AST_RETURN);
+    ast->nodes[id].return_stmt.value = value;
+    return id;
+}
+
+NodeId ast_create_def(AST *ast, int sym, const int *params, int count, NodeId body)
+{
+    uint32_t start = extra_append(ast, (const uint32_t *)params, count);
+    NodeId id = ast_create_node(ast, AST_DEF);
+    ast->nodes[id].aux = (uint16_t)count;
+    ast->nodes[id].def.sym = sym;
+    ast->nodes[id].def.params = start;
+    ast->nodes[id].def.body = body;
+    return id;
+}
+
+NodeId ast_create_array(AST *ast, const NodeId *items, int count)
+{
+    uint32_t start = extra_append(ast, items, count);
+    NodeId id = ast_create_node(ast, AST_ARRAY);
+    ast->nodes[id].array.start = start;
+    ast->nodes[id].array.count = count;
+    return id;
+}
+
+NodeId ast_create_dict(AST *ast, const NodeId *items, int count)
+{
+    NodeId id = ast_create_array(ast, items, count);
+    ast->nodes[id].type = AST_DICT;
+    return id;
+}
+
+NodeId ast_create_index(AST *ast, NodeId target, NodeId index)
+{
+    NodeId id = ast_create_node(ast, AST_INDEX);
+    ast->nodes[id].index.target = target;
+    ast->nodes[id].index.index = index;
+    ast->nodes[id].index.value = AST_NONE;
+    return id;
+}
+
+NodeId ast_create_index_assignment(AST *ast, NodeId target, NodeId index, NodeId value)
+{
+    NodeId id = ast_create_node(ast, AST_INDEX_ASSIGNMENT);
+    ast->nodes[id].index.target = target;
+    ast->nodes[id].index.index = index;
+    ast->nodes[id].index.value = value;
+    return id;
+}
+
+// Works on a copy of each node: creating nodes in `to` may move the node
+// array of `from` when they are the same tree.
+NodeId ast_copy_tree(AST *to, const AST *from, NodeId id)
+{
+    if (id == AST_NONE)
+        return AST_NONE;
+
+    ASTNode node = *ast_node(from, id);
+    NodeId copy;
+    switch (node.type)
+    {
+    case AST_FLOAT:
+        copy = ast_create_float(to, ast_float(from, &node));
+        node.float_index = to->nodes[copy].float_index;
+        break;
+    case AST_STRING:
+    case AST_BIGINT:
+        copy = create_literal(to, (ASTNodeType)node.type, value_copy(ast_string(from, &node)));
+        node.string_index = to->nodes[copy].string_index;
+        break;
+    case AST_BINARY_OP:
+        node.binary.left = ast_copy_tree(to, from, node.binary.left);
+        node.binary.right = ast_copy_tree(to, from, node.binary.right);
+        copy = ast_create_node(to, AST_BINARY_OP);
+        break;
+    case AST_ASSIGNMENT:
+    case AST_LOCAL_ASSIGNMENT:
+        node.assignment.value = ast_copy_tree(to, from, node.assignment.value);
+        copy = ast_create_node(to, node.type);
+        break;
+    case AST_IF:
+        node.if_stmt.condition = ast_copy_tree(to, from, node.if_stmt.condition);
+        node.if_stmt.then_branch = ast_copy_tree(to, from, node.if_stmt.then_branch);
+        node.if_stmt.else_branch = ast_copy_tree(to, from, node.if_stmt.else_branch);
+        copy = ast_create_node(to, AST_IF);
+        break;
+    case AST_WHILE:
+        node.while_loop.condition = ast_copy_tree(to, from, node.while_loop.condition);
+        node.while_loop.body = ast_copy_tree(to, from, node.while_loop.body);
+        copy = ast_create_node(to, AST_WHILE);
+        break;
+    case AST_PRINT:
+        node.print_stmt.expr = ast_copy_tree(to, from, node.print_stmt.expr);
+        copy = ast_create_node(to, AST_PRINT);
+        break;
+    case AST_RETURN:
+        node.return_stmt.value = ast_copy_tree(to, from, node.return_stmt.value);
+        copy = ast_create_node(to, AST_RETURN);
+        break;
+    case AST_PROFILE:
+        node.profile.stmt = ast_copy_tree(to, from, node.profile.stmt);
+        copy = ast_create_node(to, AST_PROFILE);
+        break;
+    case AST_INDEX:
+    case AST_INDEX_ASSIGNMENT:
+        node.index.target = ast_copy_tree(to, from, node.index.target);
+        node.index.index = ast_copy_tree(to, from, node.index.index);
+        node.index.value = ast_copy_tree(to, from, node.index.value);
+        copy = ast_create_node(to, node.type);
+        break;
+    case AST_BLOCK:
+    case AST_CALL:
+    case AST_ARRAY:
+    case AST_DICT:
+    {
+        // Block statements, call arguments and array and dict items are
+        // all lists of nodes
+        uint32_t *start = &node.block.start;
+        uint32_t *count = &node.block.count;
+        if (node.type == AST_CALL)
+        {
+            start = &node.call.start;
+            count = &node.call.count;
+        }
+        else if (node.type == AST_ARRAY || node.type == AST_DICT)
+        {
+            start = &node.array.start;
+            count = &node.array.count;
+        }
+        NodeId *items = (NodeId *)malloc((*count > 0 ? *count : 1) * sizeof(NodeId));
+        for (uint32_t i = 0; i < *count; i++)
+        {
+            items[i] = ast_copy_tree(to, from, from->extra[*start + i]);
+        }
+        *start = extra_append(to, items, (int)*count);
+        free(items);
+        copy = ast_create_node(to, node.type);
+        break;
+    }
+    case AST_DEF:
+    {
+        NodeId body = ast_copy_tree(to, from, node.def.body);
+        uint32_t params = to->extra_count;
+        extra_append(to, from->extra + node.def.params, node.aux);
+        node.def.params = params;
+        node.def.body = body;
+        copy = ast_create_node(to, AST_DEF);
+        break;
+    }
+    default:
+        // Leaves: ints, identifiers and locals
+        copy = ast_create_node(to, node.type);
+        break;
+    }
+    to->nodes[copy] = node;
+    if (from->positions != NULL)
+    {
+        ast_track_positions(to);
+        to->positions[copy] = from->positions[id];
+    }
+    return copy;
+}
 
-    if (block->block.count >= block->block.capacity)
+static const char *op_text(int op)
+{
+    switch (op)
     {
-        int new_capacity = block->block.capacity == 0 ? 4 : block->block.capacity * 2;
-        block->block.statements = (ASTNode **)realloc(block->block.statements, new_capacity * sizeof(ASTNode *));
-        block->block.capacity = new_capacity;
+    case TOKEN_PLUS: return "+";
+    case TOKEN_MINUS: return "-";
+    case TOKEN_MUL: return "*";
+    case TOKEN_DIV: return "/";
+    case TOKEN_EQ: return "==";
+    case TOKEN_NEQ: return "!=";
+    case TOKEN_LT: return "<";
+    case TOKEN_GT: return ">";
+    case TOKEN_LE: return "<=";
+    case TOKEN_GE: return ">=";
+    case TOKEN_IN: return "in";
+    default: return "?";
     }
-    block->block.statements[block->block.count++] = stmt;
 }
 
-void ast_free(ASTNode *node)
+void ast_wrap_profile(AST *ast, NodeId id)
 {
-    if (!node)
+    NodeId copy = ast_create_node(ast, AST_PROFILE);
+    ast->nodes[copy] = ast->nodes[id];
+    ast_copy_position(ast, copy, id);
+
+    ASTNode *node = &ast->nodes[id];
+    memset(node, 0, sizeof(ASTNode));
+    node->type = AST_PROFILE;
+    node->profile.stmt = copy;
+    node->profile.line = (int32_t)ast_position(ast, id).line;
+}
+
+void ast_dump(const AST *ast, SymbolTable *symbols, NodeId id, int depth)
+{
+    out_printf("%*s", depth * 2, "");
+    if (id == AST_NONE)
+    {
+        out_printf("(none)\n");
         return;
+    }
 
+    const ASTNode *node = ast_node(ast, id);
     switch (node->type)
     {
+    case AST_INT:
+        out_printf("Int %lld\n", (long long)ast_int(node));
+        break;
+    case AST_BIGINT:
+        out_printf("Int ");
+        value_print(ast_string(ast, node));
+        out_printf("\n");
+        break;
+    case AST_FLOAT:
+        out_printf("Float %g\n", ast_float(ast, node));
+        break;
     case AST_STRING:
+    {
+        Value s = ast_string(ast, node);
+        out_printf("String \"%s\"\n", value_string_chars(&s));
+        break;
+    }
     case AST_IDENTIFIER:
-        if (node->string_val)
-            free(node->string_val);
+        out_printf("Identifier %s\n", symbol_name(symbols, node->identifier.sym));
         break;
     case AST_BINARY_OP:
-        ast_free(node->binary.left);
-        ast_free(node->binary.right);
+        out_printf("Binary %s\n", op_text(node->op));
+        ast_dump(ast, symbols, node->binary.left, depth + 1);
+        ast_dump(ast, symbols, node->binary.right, depth + 1);
         break;
     case AST_ASSIGNMENT:
-        if (node->assignment.name)
-            free(node->assignment.name);
-        ast_free(node->assignment.value);
+        out_printf("Assign %s\n", symbol_name(symbols, node->assignment.sym));
+        ast_dump(ast, symbols, node->assignment.value, depth + 1);
         break;
     case AST_IF:
-        ast_free(node->if_stmt.condition);
-        ast_free(node->if_stmt.then_branch);
-        if (node->if_stmt.else_branch)
-            ast_free(node->if_stmt.else_branch);
+        out_printf("If\n");
+        ast_dump(ast, symbols, node->if_stmt.condition, depth + 1);
+        ast_dump(ast, symbols, node->if_stmt.then_branch, depth + 1);
+        if (node->if_stmt.else_branch != AST_NONE)
+            ast_dump(ast, symbols, node->if_stmt.else_branch, depth + 1);
         break;
     case AST_WHILE:
-        ast_free(node->while_loop.condition);
-        ast_free(node->while_loop.body);
+        out_printf("While\n");
+        ast_dump(ast, symbols, node->while_loop.condition, depth + 1);
+        ast_dump(ast, symbols, node->while_loop.body, depth + 1);
         break;
     case AST_PRINT:
-        ast_free(node->print_stmt.expr);
+        out_printf("Print\n");
+        ast_dump(ast, symbols, node->print_stmt.expr, depth + 1);
         break;
     case AST_BLOCK:
-        for (int i = 0; i < node->block.count; i++)
+        out_printf("Block\n");
+        for (uint32_t i = 0; i < node->block.count; i++)
         {
-            ast_free(node->block.statements[i]);
+            ast_dump(ast, symbols, ast_block_statement(ast, node, i), depth + 1);
         }
-        if (node->block.statements)
-            free(node->block.statements);
         break;
-    default:
+    case AST_CALL:
+        out_printf("Call %s%s\n", symbol_name(symbols, node->call.sym), node->aux == CALL_TAIL ? " (tail)" : "");
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            ast_dump(ast, symbols, ast_call_arg(ast, node, i), depth + 1);
+        }
+        break;
+    case AST_RETURN:
+        out_printf("Return\n");
+        if (node->return_stmt.value != AST_NONE)
+            ast_dump(ast, symbols, node->return_stmt.value, depth + 1);
+        break;
+    case AST_DEF:
+        out_printf("Def %s(", symbol_name(symbols, node->def.sym));
+        for (int i = 0; i < node->aux; i++)
+        {
+            out_printf("%s%s", i > 0 ? ", " : "", symbol_name(symbols, ast_def_param(ast, node, i)));
+        }
+        out_printf(")\n");
+        ast_dump(ast, symbols, node->def.body, depth + 1);
+        break;
+    case AST_ARRAY:
+    case AST_DICT:
+        out_printf(node->type == AST_ARRAY ? "Array\n" : "Dict\n");
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            ast_dump(ast, symbols, ast_array_item(ast, node, i), depth + 1);
+        }
+        break;
+    case AST_INDEX:
+        out_printf("Index\n");
+        ast_dump(ast, symbols, node->index.target, depth + 1);
+        ast_dump(ast, symbols, node->index.index, depth + 1);
+        break;
+    case AST_INDEX_ASSIGNMENT:
+        out_printf("Assign index\n");
+        ast_dump(ast, symbols, node->index.target, depth + 1);
+        ast_dump(ast, symbols, node->index.index, depth + 1);
+        ast_dump(ast, symbols, node->index.value, depth + 1);
+        break;
+    case AST_LOCAL:
+        out_printf("Local %s\n", symbol_name(symbols, node->identifier.sym));
+        break;
+    case AST_LOCAL_ASSIGNMENT:
+        out_printf("Assign local %s\n", symbol_name(symbols, node->assignment.sym));
+        ast_dump(ast, symbols, node->assignment.value, depth + 1);
+        break;
+    case AST_PROFILE:
+        out_printf("Profile line %d\n", node->profile.line);
+        ast_dump(ast, symbols, node->profile.stmt, depth + 1);
         break;
     }
-    free(node);
 }
@@ -1,6 +1,10 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdint.h>
+#include "value.h"
+#include "symbol.h"
+
 typedef enum
 {
     AST_INT,
@@ -12,65 +16,274 @@ typedef enum
     AST_IF,
     AST_WHILE,
     AST_PRINT,
-    AST_BLOCK
+    AST_BLOCK,
+    AST_CALL,
+    AST_RETURN,
+    AST_DEF,
+    AST_ARRAY,            // [item, ...]
+    AST_INDEX,            // target[index]
+    AST_INDEX_ASSIGNMENT, // target[index] = value
+    // Variables of a function's frame. The resolver retypes the function
+    // body's identifiers and assignments to these; slot is a frame offset.
+    AST_LOCAL,
+    AST_LOCAL_ASSIGNMENT,
+    AST_PROFILE, // Times the statement it wraps; only inserted by --profile
+    AST_BIGINT,  // An int literal beyond the small range, kept in AST.strings
+    AST_DICT     // {key: value, ...}, as an item list alternating keys and values
 } ASTNodeType;
 
-struct ASTNode;
+// Operand types of an AST_BINARY_OP. The first forms are proven by
+// infer_types() and let the engines skip the run-time type dispatch. The
+// CACHED forms are guesses eval() makes after a node first runs; they are
+// checked on every use and drop to BINARY_POLYMORPHIC when wrong.
+typedef enum
+{
+    BINARY_GENERIC,
+    BINARY_INT_INT,
+    BINARY_FLOAT_FLOAT,
+    BINARY_INT_FLOAT,
+    BINARY_FLOAT_INT,
+    BINARY_CACHED_INT_INT,
+    BINARY_CACHED_FLOAT_FLOAT,
+    BINARY_POLYMORPHIC
+} BinaryForm;
+
+// Shape of an AST_WHILE (ASTNode.aux), as recognized by optimize(). A
+// counted loop tests `i OP bound` with a loop-invariant int bound, and its
+// body changes `i` only through `i = i + <int literal>`, so once `i` and
+// the bound are ints on entry the test can run as a plain C compare.
+typedef enum
+{
+    LOOP_GENERIC,
+    LOOP_COUNTED,
+    LOOP_COUNTED_BARE // The body is nothing but the increment
+} LoopForm;
 
-typedef struct ASTNode
+// Kind of an AST_CALL (ASTNode.aux). The resolver marks `return f(...)`
+// in a function body as a tail call, which reuses the caller's frame.
+typedef enum
 {
-    ASTNodeType type;
+    CALL_NORMAL,
+    CALL_TAIL
+} CallForm;
+
+#define CALL_MAX_ARGS 255
+
+// Nodes refer to each other by index into AST.nodes. Index 0 is reserved,
+// so AST_NONE plays the role of a NULL child.
+typedef uint32_t NodeId;
+#define AST_NONE 0
+
+// Every node is 16 bytes: a 4-byte header and at most three 32-bit fields.
+// Data that doesn't fit (float literals, string values, block statement
+// lists) lives in side arrays of the owning AST.
+typedef struct
+{
+    uint8_t type; // ASTNodeType
+    uint8_t op;   // TokenType, for AST_BINARY_OP
+    uint16_t aux; // BinaryForm for AST_BINARY_OP, LoopForm for AST_WHILE,
+                  // CallForm for AST_CALL, parameter count for AST_DEF
     union
     {
-        int int_val;
-        double float_val;
-        char *string_val; // For strings and identifiers
         struct
         {
-            int op; // TokenType
-            struct ASTNode *left;
-            struct ASTNode *right;
+            uint32_t lo; // Two halves keep the union 4-byte aligned; see ast_int()
+            uint32_t hi;
+        } int_val;
+        uint32_t float_index;  // Into AST.floats
+        uint32_t string_index; // Into AST.strings, for AST_STRING and AST_BIGINT
+        struct
+        {
+            int32_t sym;  // Interned name
+            int32_t slot; // Environment slot, -1 until resolved
+        } identifier;
+        struct
+        {
+            NodeId left;
+            NodeId right;
         } binary;
         struct
         {
-            char *name;
-            struct ASTNode *value;
+            int32_t sym;  // Interned name
+            int32_t slot; // Environment slot, -1 until resolved
+            NodeId value;
         } assignment;
         struct
         {
-            struct ASTNode *condition;
-            struct ASTNode *then_branch;
-            struct ASTNode *else_branch; // Can be NULL
+            NodeId condition;
+            NodeId then_branch;
+            NodeId else_branch; // Can be AST_NONE
         } if_stmt;
         struct
         {
-            struct ASTNode *condition;
-            struct ASTNode *body;
+            NodeId condition;
+            NodeId body;
         } while_loop;
         struct
         {
-            struct ASTNode *expr;
+            NodeId expr;
         } print_stmt;
         struct
         {
-            struct ASTNode **statements;
-            int count;
-            int capacity;
+            uint32_t start; // Statements are extra[start..start+count)
+            uint32_t count;
         } block;
+        struct
+        {
+            int32_t sym;    // Function name
+            uint32_t start; // Arguments are extra[start..start+count)
+            uint32_t count;
+        } call;
+        struct
+        {
+            NodeId value; // Can be AST_NONE
+        } return_stmt;
+        struct
+        {
+            int32_t sym;     // Function name
+            uint32_t params; // Parameter names are extra[params..params+aux)
+            union
+            {
+                NodeId body;
+                int32_t function; // Once resolved: index into env->functions, which has the body
+            };
+        } def;
+        struct
+        {
+            uint32_t start; // Items are extra[start..start+count); also for AST_DICT
+            uint32_t count;
+        } array;
+        struct
+        {
+            NodeId target;
+            NodeId index;
+            NodeId value; // AST_INDEX_ASSIGNMENT only
+        } index;
+        struct
+        {
+            NodeId stmt;
+            int32_t line;
+        } profile;
     };
 } ASTNode;
 
-ASTNode *ast_create_int(int value);
-ASTNode *ast_create_float(double value);
-ASTNode *ast_create_string(char *value);
-ASTNode *ast_create_identifier(char *name);
-ASTNode *ast_create_binary(int op, ASTNode *left, ASTNode *right);
-ASTNode *ast_create_assignment(char *name, ASTNode *value);
-ASTNode *ast_create_if(ASTNode *condition, ASTNode *then_branch, ASTNode *else_branch);
-ASTNode *ast_create_while(ASTNode *condition, ASTNode *body);
-ASTNode *ast_create_print(ASTNode *expr);
-ASTNode *ast_create_block();
-void ast_block_add(ASTNode *block, ASTNode *stmt);
-void ast_free(ASTNode *node);
+// Where the statement a node belongs to starts; 1-based, line 0 if unknown.
+typedef struct
+{
+    uint32_t line;
+    uint32_t col;
+} SourcePos;
+
+// One parse worth of nodes. Everything is held in a handful of flat arrays,
+// so releasing or recycling a whole tree costs O(1) plus one reference drop
+// per string literal.
+typedef struct
+{
+    ASTNode *nodes;
+    uint32_t count;
+    uint32_t capacity;
+
+    NodeId *extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+
+    double *floats;
+    uint32_t float_count;
+    uint32_t float_capacity;
+
+    Value *strings; // String and bigint literals, shared with every value read from them
+    uint32_t string_count;
+    uint32_t string_capacity;
+
+    SourcePos *positions; // Parallel to nodes; NULL unless positions are tracked
+} AST;
+
+void ast_init(AST *ast);
+void ast_reset(AST *ast); // Drops all nodes but keeps the storage for reuse
+void ast_free(AST *ast);
+
+// Makes the parser record a SourcePos for every node from now on. Off by
+// default, keeping nodes at 16 bytes and the parser free of line counting.
+void ast_track_positions(AST *ast);
+// Gives `pos` to every node from `first` on that has no position yet.
+void ast_fill_positions(AST *ast, NodeId first, SourcePos pos);
+void ast_copy_position(AST *ast, NodeId to, NodeId from);
+
+NodeId ast_create_int(AST *ast, int64_t value); // `value` must fit a small int
+NodeId ast_create_bigint(AST *ast, Value value); // Takes ownership of `value`
+NodeId ast_create_float(AST *ast, double value);
+NodeId ast_create_string(AST *ast, const char *value, int length);
+NodeId ast_create_identifier(AST *ast, int sym);
+NodeId ast_create_binary(AST *ast, int op, NodeId left, NodeId right);
+NodeId ast_create_assignment(AST *ast, int sym, NodeId value);
+NodeId ast_create_if(AST *ast, NodeId condition, NodeId then_branch, NodeId else_branch);
+NodeId ast_create_while(AST *ast, NodeId condition, NodeId body);
+NodeId ast_create_print(AST *ast, NodeId expr);
+NodeId ast_create_block(AST *ast, const NodeId *statements, int count);
+NodeId ast_create_call(AST *ast, int sym, const NodeId *args, int count);
+NodeId ast_create_return(AST *ast, NodeId value);
+NodeId ast_create_def(AST *ast, int sym, const int *params, int count, NodeId body);
+NodeId ast_create_array(AST *ast, const NodeId *items, int count);
+NodeId ast_create_dict(AST *ast, const NodeId *items, int count); // `count` items, two per entry
+NodeId ast_create_index(AST *ast, NodeId target, NodeId index);
+NodeId ast_create_index_assignment(AST *ast, NodeId target, NodeId index, NodeId value);
+
+// Copies the tree under `id` in `from` into `to`, positions included, and
+// returns the copy's root.
+NodeId ast_copy_tree(AST *to, const AST *from, NodeId id);
+
+// Turns node `id` into an AST_PROFILE wrapped around a copy of it, in
+// place, so whatever refers to `id` now runs through the wrapper.
+void ast_wrap_profile(AST *ast, NodeId id);
+
+// Prints the tree under `id`, one node per line, indented by depth.
+void ast_dump(const AST *ast, SymbolTable *symbols, NodeId id, int depth);
+
+// Node pointers are invalidated by the next ast_create_* call.
+static inline ASTNode *ast_node(const AST *ast, NodeId id)
+{
+    return &ast->nodes[id];
+}
+
+static inline SourcePos ast_position(const AST *ast, NodeId id)
+{
+    SourcePos none = {0, 0};
+    return ast->positions != NULL ? ast->positions[id] : none;
+}
+
+static inline int64_t ast_int(const ASTNode *node)
+{
+    return (int64_t)(((uint64_t)node->int_val.hi << 32) | node->int_val.lo);
+}
+
+static inline double ast_float(const AST *ast, const ASTNode *node)
+{
+    return ast->floats[node->float_index];
+}
+
+static inline Value ast_string(const AST *ast, const ASTNode *node)
+{
+    return ast->strings[node->string_index];
+}
+
+static inline NodeId ast_block_statement(const AST *ast, const ASTNode *block, int i)
+{
+    return ast->extra[block->block.start + i];
+}
+
+static inline NodeId ast_call_arg(const AST *ast, const ASTNode *call, int i)
+{
+    return ast->extra[call->call.start + i];
+}
+
+static inline NodeId ast_array_item(const AST *ast, const ASTNode *array, int i)
+{
+    return ast->extra[array->array.start + i];
+}
+
+static inline int ast_def_param(const AST *ast, const ASTNode *def, int i)
+{
+    return (int)ast->extra[def->def.params + i];
+}
 
 #endif
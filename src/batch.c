@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "batch.h"
+#include "lofy.h"
+#include "output.h"
+#include "source.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+typedef struct
+{
+    char *path;
+    char *output; // Everything the script printed, errors included
+    size_t length;
+    size_t capacity;
+    double ms;    // Wall time from reading the file to closing its state
+    int failed;   // Unreadable, or had syntax or compile errors
+    int done;
+} Job;
+
+// A worker's share of the jobs: indices [top, bottom). The owner takes from
+// the top, in file order, so output can be written as it arrives; idle
+// workers steal from the bottom, away from the owner.
+typedef struct
+{
+    int top;
+    int bottom;
+    pthread_mutex_t lock;
+} Deque;
+
+typedef struct
+{
+    Job *jobs;
+    Deque *deques;
+    int worker_count;
+
+    pthread_mutex_t done_lock; // Guards Job.done
+    pthread_cond_t done_changed;
+} Batch;
+
+typedef struct
+{
+    Batch *batch;
+    int id;
+} Worker;
+
+static double now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1000.0 + (double)t.tv_nsec / 1e6;
+}
+
+static int core_count(void)
+{
+#ifdef _WIN32
+    const char *n = getenv("NUMBER_OF_PROCESSORS");
+    int count = n != NULL ? atoi(n) : 1;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? count : 1;
+}
+
+static void capture(void *user, const char *data, size_t length)
+{
+    Job *job = (Job *)user;
+    if (job->length + length > job->capacity)
+    {
+        job->capacity = job->capacity == 0 ? 256 : job->capacity;
+        while (job->length + length > job->capacity)
+            job->capacity *= 2;
+        job->output = (char *)realloc(job->output, job->capacity);
+    }
+    memcpy(job->output + job->length, data, length);
+    job->length += length;
+}
+
+static void run_job(Job *job)
+{
+    double start = now_ms();
+
+    // Read errors come from outside the state, so capture those too
+    Output sinks = {{capture, job}, {capture, job}, NULL, 0};
+    Output *previous = output_bind(&sinks);
+    Source source;
+    if (source_open_file(&source, job->path) == 0)
+    {
+        lofy_State *L = lofy_new();
+        lofy_set_output(L, capture, job);
+        lofy_set_error(L, capture, job);
+        job->failed = lofy_do_string(L, source.data, (size_t)source.length) != LOFY_OK;
+        lofy_close(L);
+        source_close(&source);
+    }
+    else
+    {
+        job->failed = 1;
+    }
+    output_bind(previous);
+    output_free(&sinks);
+
+    job->ms = now_ms() - start;
+}
+
+// Next job for worker `id`: its own first, then one stolen from the others
+static int take_job(Batch *batch, int id)
+{
+    Deque *own = &batch->deques[id];
+    pthread_mutex_lock(&own->lock);
+    int job = own->top < own->bottom ? own->top++ : -1;
+    pthread_mutex_unlock(&own->lock);
+    if (job >= 0)
+        return job;
+
+    for (int i = 1; i < batch->worker_count; i++)
+    {
+        Deque *victim = &batch->deques[(id + i) % batch->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        job = victim->top < victim->bottom ? --victim->bottom : -1;
+        pthread_mutex_unlock(&victim->lock);
+        if (job >= 0)
+            return job;
+    }
+    return -1;
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    Batch *batch = worker->batch;
+    int index;
+    while ((index = take_job(batch, worker->id)) >= 0)
+    {
+        run_job(&batch->jobs[index]);
+        pthread_mutex_lock(&batch->done_lock);
+        batch->jobs[index].done = 1;
+        pthread_cond_broadcast(&batch->done_changed);
+        pthread_mutex_unlock(&batch->done_lock);
+    }
+    return NULL;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Paths of the .lofy files in `dir`, sorted. Returns -1 if it can't be read.
+static int list_scripts(const char *dir, char ***paths)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        err_printf("Error: Could not open directory '%s'\n", dir);
+        return -1;
+    }
+
+    size_t dir_length = strlen(dir);
+    while (dir_length > 1 && (dir[dir_length - 1] == '/' || dir[dir_length - 1] == '\\'))
+        dir_length--;
+
+    int count = 0;
+    int capacity = 0;
+    *paths = NULL;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        size_t length = strlen(entry->d_name);
+        if (length <= 5 || strcmp(entry->d_name + length - 5, ".lofy") != 0)
+            continue;
+        if (count == capacity)
+        {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            *paths = (char **)realloc(*paths, capacity * sizeof(char *));
+        }
+        char *path = (char *)malloc(dir_length + length + 2);
+        memcpy(path, dir, dir_length);
+        path[dir_length] = '/';
+        memcpy(path + dir_length + 1, entry->d_name, length + 1);
+        struct stat info;
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            free(path);
+            continue;
+        }
+        (*paths)[count++] = path;
+    }
+    closedir(d);
+
+    qsort(*paths, count, sizeof(char *), compare_names);
+    return count;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted `values`
+static double percentile(const double *values, int count, double p)
+{
+    int rank = (int)(p / 100.0 * count + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    return values[rank > count ? count - 1 : rank - 1];
+}
+
+int batch_run(const char *dir, int threads)
+{
+    char **paths;
+    int count = list_scripts(dir, &paths);
+    if (count < 0)
+        return 1;
+
+    if (threads <= 0)
+        threads = core_count();
+    if (threads > count)
+        threads = count > 0 ? count : 1;
+
+    Batch batch;
+    batch.jobs = (Job *)calloc(count > 0 ? count : 1, sizeof(Job));
+    for (int i = 0; i < count; i++)
+        batch.jobs[i].path = paths[i];
+    batch.worker_count = threads;
+    pthread_mutex_init(&batch.done_lock, NULL);
+    pthread_cond_init(&batch.done_changed, NULL);
+
+    // Contiguous shares, so each worker starts at a different point in
+    // file order and stealing only kicks in at the end
+    batch.deques = (Deque *)malloc(threads * sizeof(Deque));
+    for (int w = 0; w < threads; w++)
+    {
+        batch.deques[w].top = (int)((long)count * w / threads);
+        batch.deques[w].bottom = (int)((long)count * (w + 1) / threads);
+        pthread_mutex_init(&batch.deques[w].lock, NULL);
+    }
+
+    double start = now_ms();
+    Worker *workers = (Worker *)malloc(threads * sizeof(Worker));
+    pthread_t *handles = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    for (int w = 0; w < threads; w++)
+    {
+        workers[w].batch = &batch;
+        workers[w].id = w;
+    }
+    // Workers that can't be started leave their shares to be stolen by the
+    // others; with none started, this thread runs every job itself
+    int started = 0;
+    while (started < threads && pthread_create(&handles[started], NULL, worker_main, &workers[started]) == 0)
+        started++;
+    if (started == 0)
+        worker_main(&workers[0]);
+
+    // Write each script's output as soon as it and everything before it
+    // has finished
+    int failures = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Job *job = &batch.jobs[i];
+        pthread_mutex_lock(&batch.done_lock);
+        while (!job->done)
+            pthread_cond_wait(&batch.done_changed, &batch.done_lock);
+        pthread_mutex_unlock(&batch.done_lock);
+
+        out_write(job->output, job->length);
+        free(job->output);
+        job->output = NULL;
+        failures += job->failed;
+    }
+    output_flush();
+
+    for (int w = 0; w < started; w++)
+        pthread_join(handles[w], NULL);
+    double elapsed = now_ms() - start;
+
+    double *latencies = (double *)malloc((count > 0 ? count : 1) * sizeof(double));
+    for (int i = 0; i < count; i++)
+        latencies[i] = batch.jobs[i].ms;
+    qsort(latencies, count, sizeof(double), compare_doubles);
+
+    out_printf("; batch: %d scripts on %d threads in %.1f ms, %.1f scripts/s", count,
+               started > 0 ? started : 1, elapsed, elapsed > 0.0 ? count * 1000.0 / elapsed : 0.0);
+    if (failures > 0)
+        out_printf(", %d failed", failures);
+    out_printf("\n");
+    if (count > 0)
+    {
+        out_printf("; latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+                   percentile(latencies, count, 50), percentile(latencies, count, 90),
+                   percentile(latencies, count, 99), latencies[count - 1]);
+    }
+
+    for (int w = 0; w < threads; w++)
+        pthread_mutex_destroy(&batch.deques[w].lock);
+    pthread_mutex_destroy(&batch.done_lock);
+    pthread_cond_destroy(&batch.done_changed);
+    for (int i = 0; i < count; i++)
+        free(paths[i]);
+    free(paths);
+    free(latencies);
+    free(handles);
+    free(workers);
+    free(batch.deques);
+    free(batch.jobs);
+    return failures > 0 ? 1 : 0;
+}
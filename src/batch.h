@@ -0,0 +1,11 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// --batch: runs every .lofy file in `dir` (not its subdirectories), each in
+// its own lofy_State, on `threads` worker threads (0 for one per core).
+// Each script's output is captured and written to stdout in file name
+// order, followed by throughput and latency figures. Returns 0 if every
+// script was read and compiled, 1 otherwise.
+int batch_run(const char *dir, int threads);
+
+#endif
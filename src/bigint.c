@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bigint.h"
+#include "output.h"
+
+// A signed magnitude to compute with, whether it came from a bigint or a
+// small int. Pass by pointer: `limbs` may point into the struct itself.
+typedef struct
+{
+    int sign; // -1, 0 or 1
+    uint32_t count;
+    const uint32_t *limbs;
+    uint32_t small[2];
+} Operand;
+
+static void operand_of_int(Operand *o, int64_t i)
+{
+    uint64_t magnitude = i < 0 ? 0 - (uint64_t)i : (uint64_t)i;
+    o->sign = (i > 0) - (i < 0);
+    o->small[0] = (uint32_t)magnitude;
+    o->small[1] = (uint32_t)(magnitude >> 32);
+    o->count = o->small[1] != 0 ? 2 : o->small[0] != 0 ? 1 : 0;
+    o->limbs = o->small;
+}
+
+static void operand_of(Operand *o, Value v)
+{
+    if (!value_is_bigint(v))
+    {
+        operand_of_int(o, value_as_int(v));
+        return;
+    }
+    const LoBigInt *b = value_as_bigint(v);
+    o->sign = b->sign;
+    o->count = b->count;
+    o->limbs = b->limbs;
+}
+
+// Zero-filled, with room for `count` limbs
+static LoBigInt *big_alloc(size_t count)
+{
+    LoBigInt *b = (LoBigInt *)calloc(1, sizeof(LoBigInt) + (count > 0 ? count : 1) * sizeof(uint32_t));
+    b->refcount = 1;
+    b->sign = 1;
+    b->count = (uint32_t)count;
+    return b;
+}
+
+// Strips leading zero limbs and hands back `b` with `sign`, or a small int
+// (freeing `b`) when the result fits one
+static Value big_finish(LoBigInt *b, int sign)
+{
+    while (b->count > 0 && b->limbs[b->count - 1] == 0)
+        b->count--;
+    if (b->count <= 2)
+    {
+        uint64_t magnitude = b->count == 0 ? 0 : b->limbs[0];
+        if (b->count == 2)
+            magnitude |= (uint64_t)b->limbs[1] << 32;
+        if ((sign >= 0 || magnitude == 0) && magnitude <= (uint64_t)VALUE_INT_MAX)
+        {
+            free(b);
+            return value_int((int64_t)magnitude);
+        }
+        if (sign < 0 && magnitude - 1 <= (uint64_t)VALUE_INT_MAX)
+        {
+            free(b);
+            return value_int(-(int64_t)(magnitude - 1) - 1);
+        }
+    }
+    b->sign = sign;
+    return value_from_bigint(b);
+}
+
+LoBigInt *bigint_from_int64(int64_t i)
+{
+    Operand o;
+    operand_of_int(&o, i);
+    LoBigInt *b = big_alloc(o.count);
+    memcpy(b->limbs, o.limbs, o.count * sizeof(uint32_t));
+    b->sign = o.sign < 0 ? -1 : 1;
+    return b;
+}
+
+void bigint_destroy(LoBigInt *b)
+{
+    free(b);
+}
+
+// ---------------------------------------------------------------------------
+// Magnitudes: little-endian limb arrays, possibly with leading zeros
+
+static int mag_compare(const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    while (an > 0 && a[an - 1] == 0)
+        an--;
+    while (bn > 0 && b[bn - 1] == 0)
+        bn--;
+    if (an != bn)
+        return an < bn ? -1 : 1;
+    for (size_t i = an; i-- > 0;)
+    {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// r[0..max(an, bn)] = a + b
+static void mag_add(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    if (an < bn)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+    uint64_t carry = 0;
+    for (size_t i = 0; i < an; i++)
+    {
+        carry += (uint64_t)a[i] + (i < bn ? b[i] : 0);
+        r[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    r[an] = (uint32_t)carry;
+}
+
+// r[0..an) = a - b, for a >= b
+static void mag_sub(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    int64_t borrow = 0;
+    for (size_t i = 0; i < an; i++)
+    {
+        int64_t t = (int64_t)a[i] - (i < bn ? b[i] : 0) - borrow;
+        borrow = t < 0;
+        r[i] = (uint32_t)t;
+    }
+}
+
+// r[0..rn) += x[0..xn), for xn <= rn and a sum that fits
+static void mag_add_in_place(uint32_t *r, size_t rn, const uint32_t *x, size_t xn)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < rn && (i < xn || carry != 0); i++)
+    {
+        carry += (uint64_t)r[i] + (i < xn ? x[i] : 0);
+        r[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+// r[0..rn) -= x[0..xn), for xn <= rn and r >= x
+static void mag_sub_in_place(uint32_t *r, size_t rn, const uint32_t *x, size_t xn)
+{
+    int64_t borrow = 0;
+    for (size_t i = 0; i < rn && (i < xn || borrow != 0); i++)
+    {
+        int64_t t = (int64_t)r[i] - (i < xn ? x[i] : 0) - borrow;
+        borrow = t < 0;
+        r[i] = (uint32_t)t;
+    }
+}
+
+static void mag_mul_schoolbook(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    memset(r, 0, (an + bn) * sizeof(uint32_t));
+    for (size_t i = 0; i < bn; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < an; j++)
+        {
+            carry += (uint64_t)a[j] * b[i] + r[i + j];
+            r[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        r[i + an] = (uint32_t)carry;
+    }
+}
+
+// r[0..an+bn) = a * b; `r` must not overlap either operand. Karatsuba
+// splits both sides at h limbs and gets by with three half-size products:
+// a1*b1, a0*b0 and (a0+a1)*(b0+b1), from which the middle term follows.
+static void mag_mul(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    if (an < bn)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+    if (bn < KARATSUBA_THRESHOLD)
+    {
+        mag_mul_schoolbook(r, a, an, b, bn);
+        return;
+    }
+
+    if (an >= 2 * bn)
+    {
+        // Lopsided: multiply b by one bn-limb slice of a at a time, so each
+        // product is balanced
+        uint32_t *t = (uint32_t *)malloc(2 * bn * sizeof(uint32_t));
+        memset(r, 0, (an + bn) * sizeof(uint32_t));
+        for (size_t i = 0; i < an; i += bn)
+        {
+            size_t n = an - i < bn ? an - i : bn;
+            mag_mul(t, a + i, n, b, bn);
+            mag_add_in_place(r + i, an + bn - i, t, n + bn);
+        }
+        free(t);
+        return;
+    }
+
+    // bn > an / 2, so b has at least h limbs
+    size_t h = (an + 1) / 2;
+    size_t a1n = an - h;
+    size_t b1n = bn - h;
+    mag_mul(r, a, h, b, h);                      // z0 in r[0..2h)
+    mag_mul(r + 2 * h, a + h, a1n, b + h, b1n); // z2 in r[2h..an+bn)
+
+    uint32_t *t = (uint32_t *)malloc((4 * h + 4) * sizeof(uint32_t));
+    uint32_t *sa = t;
+    uint32_t *sb = t + h + 1;
+    uint32_t *z1 = t + 2 * h + 2;
+    mag_add(sa, a, h, a + h, a1n);
+    mag_add(sb, b, h, b + h, b1n);
+    mag_mul(z1, sa, h + 1, sb, h + 1);
+    mag_sub_in_place(z1, 2 * h + 2, r, 2 * h);
+    mag_sub_in_place(z1, 2 * h + 2, r + 2 * h, a1n + b1n);
+    // z1 = a0*b1 + a1*b0 fits below the top of r; its high limbs are zero
+    size_t room = an + bn - h;
+    mag_add_in_place(r + h, room, z1, 2 * h + 2 < room ? 2 * h + 2 : room);
+    free(t);
+}
+
+static int leading_zeros(uint32_t x)
+{
+    int n = 0;
+    while (!(x & 0x80000000u))
+    {
+        x <<= 1;
+        n++;
+    }
+    return n;
+}
+
+// q[0..m-n] = u / v, for m >= n >= 1 and v[n-1] != 0 (Knuth's algorithm D,
+// after Hacker's Delight)
+static void mag_div(uint32_t *q, const uint32_t *u, size_t m, const uint32_t *v, size_t n)
+{
+    if (n == 1)
+    {
+        uint64_t rem = 0;
+        for (size_t j = m; j-- > 0;)
+        {
+            uint64_t cur = (rem << 32) | u[j];
+            q[j] = (uint32_t)(cur / v[0]);
+            rem = cur % v[0];
+        }
+        return;
+    }
+
+    // Normalize so the divisor's top bit is set, which keeps each
+    // estimated quotient digit at most two too large
+    int s = leading_zeros(v[n - 1]);
+    uint32_t *vn = (uint32_t *)malloc(n * sizeof(uint32_t));
+    uint32_t *un = (uint32_t *)malloc((m + 1) * sizeof(uint32_t));
+    for (size_t i = n - 1; i > 0; i--)
+        vn[i] = (v[i] << s) | (s != 0 ? v[i - 1] >> (32 - s) : 0);
+    vn[0] = v[0] << s;
+    un[m] = s != 0 ? u[m - 1] >> (32 - s) : 0;
+    for (size_t i = m - 1; i > 0; i--)
+        un[i] = (u[i] << s) | (s != 0 ? u[i - 1] >> (32 - s) : 0);
+    un[0] = u[0] << s;
+
+    const uint64_t base = (uint64_t)1 << 32;
+    for (size_t j = m - n + 1; j-- > 0;)
+    {
+        uint64_t top = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+        uint64_t qhat = top / vn[n - 1];
+        uint64_t rhat = top % vn[n - 1];
+        while (qhat >= base || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2]))
+        {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >= base)
+                break;
+        }
+
+        // un[j..j+n] -= qhat * vn
+        int64_t borrow = 0;
+        int64_t t;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t p = qhat * vn[i];
+            t = (int64_t)un[i + j] - borrow - (int64_t)(p & 0xFFFFFFFFu);
+            un[i + j] = (uint32_t)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+        t = (int64_t)un[j + n] - borrow;
+        un[j + n] = (uint32_t)t;
+
+        q[j] = (uint32_t)qhat;
+        if (t < 0)
+        {
+            // qhat was one too large: add the divisor back
+            q[j]--;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                carry += (uint64_t)un[i + j] + vn[i];
+                un[i + j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            un[j + n] += (uint32_t)carry;
+        }
+    }
+    free(vn);
+    free(un);
+}
+
+// ---------------------------------------------------------------------------
+// Signed arithmetic
+
+static int compare_operands(const Operand *x, const Operand *y)
+{
+    if (x->sign != y->sign)
+        return x->sign < y->sign ? -1 : 1;
+    int order = mag_compare(x->limbs, x->count, y->limbs, y->count);
+    return x->sign < 0 ? -order : order;
+}
+
+// x + y, with y's sign taken as `y_sign`
+static Value add_operands(const Operand *x, const Operand *y, int y_sign)
+{
+    size_t n = (x->count > y->count ? x->count : y->count) + 1;
+    LoBigInt *r = big_alloc(n);
+    if (x->sign == 0 || y_sign == 0 || x->sign == y_sign)
+    {
+        mag_add(r->limbs, x->limbs, x->count, y->limbs, y->count);
+        return big_finish(r, x->sign != 0 ? x->sign : y_sign);
+    }
+    if (mag_compare(x->limbs, x->count, y->limbs, y->count) >= 0)
+    {
+        mag_sub(r->limbs, x->limbs, x->count, y->limbs, y->count);
+        return big_finish(r, x->sign);
+    }
+    mag_sub(r->limbs, y->limbs, y->count, x->limbs, x->count);
+    return big_finish(r, y_sign);
+}
+
+static Value mul_operands(const Operand *x, const Operand *y)
+{
+    if (x->sign == 0 || y->sign == 0)
+        return value_int(0);
+    LoBigInt *r = big_alloc((size_t)x->count + y->count);
+    mag_mul(r->limbs, x->limbs, x->count, y->limbs, y->count);
+    return big_finish(r, x->sign * y->sign);
+}
+
+static Value div_operands(const Operand *x, const Operand *y)
+{
+    if (y->sign == 0)
+    {
+        err_printf("Runtime Error: Division by zero\n");
+        return value_int(0);
+    }
+    if (mag_compare(x->limbs, x->count, y->limbs, y->count) < 0)
+        return value_int(0);
+    LoBigInt *q = big_alloc((size_t)x->count - y->count + 1);
+    mag_div(q->limbs, x->limbs, x->count, y->limbs, y->count);
+    return big_finish(q, x->sign * y->sign);
+}
+
+static Value operands_op(int op, const Operand *x, const Operand *y)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return add_operands(x, y, y->sign);
+    case TOKEN_MINUS:
+        return add_operands(x, y, -y->sign);
+    case TOKEN_MUL:
+        return mul_operands(x, y);
+    case TOKEN_DIV:
+        return div_operands(x, y);
+    case TOKEN_EQ:
+        return value_bool(compare_operands(x, y) == 0);
+    case TOKEN_NEQ:
+        return value_bool(compare_operands(x, y) != 0);
+    case TOKEN_LT:
+        return value_bool(compare_operands(x, y) < 0);
+    case TOKEN_GT:
+        return value_bool(compare_operands(x, y) > 0);
+    case TOKEN_LE:
+        return value_bool(compare_operands(x, y) <= 0);
+    case TOKEN_GE:
+        return value_bool(compare_operands(x, y) >= 0);
+    default:
+        return value_none();
+    }
+}
+
+Value bigint_int_op(int op, int64_t left, int64_t right)
+{
+    Operand x, y;
+    operand_of_int(&x, left);
+    operand_of_int(&y, right);
+    return operands_op(op, &x, &y);
+}
+
+Value bigint_binary_op(int op, Value left, Value right)
+{
+    Operand x, y;
+    operand_of(&x, left);
+    operand_of(&y, right);
+    return operands_op(op, &x, &y);
+}
+
+int bigint_compare(Value left, Value right)
+{
+    Operand x, y;
+    operand_of(&x, left);
+    operand_of(&y, right);
+    return compare_operands(&x, &y);
+}
+
+// ---------------------------------------------------------------------------
+// Conversions
+
+Value bigint_parse(const char *digits, size_t length)
+{
+    // 10^9 < 2^32, so each group of nine digits adds at most one limb
+    LoBigInt *b = big_alloc(length / 9 + 1);
+    uint32_t count = 0;
+    size_t i = 0;
+    size_t take = length % 9 != 0 ? length % 9 : 9;
+    while (i < length)
+    {
+        uint32_t group = 0;
+        uint32_t scale = 1;
+        for (size_t k = 0; k < take; k++)
+        {
+            group = group * 10 + (uint32_t)(digits[i + k] - '0');
+            scale *= 10;
+        }
+        uint64_t carry = group;
+        for (uint32_t j = 0; j < count; j++)
+        {
+            carry += (uint64_t)b->limbs[j] * scale;
+            b->limbs[j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        if (carry != 0)
+            b->limbs[count++] = (uint32_t)carry;
+        i += take;
+        take = 9;
+    }
+    b->count = count;
+    return big_finish(b, 1);
+}
+
+int bigint_to_int64(const LoBigInt *b, int64_t *i)
+{
+    if (b->count > 2)
+        return 0;
+    uint64_t magnitude = b->limbs[0];
+    if (b->count == 2)
+        magnitude |= (uint64_t)b->limbs[1] << 32;
+    if (b->sign > 0 && magnitude <= (uint64_t)INT64_MAX)
+        *i = (int64_t)magnitude;
+    else if (b->sign < 0 && magnitude - 1 <= (uint64_t)INT64_MAX)
+        *i = -(int64_t)(magnitude - 1) - 1;
+    else
+        return 0;
+    return 1;
+}
+
+double bigint_to_double(const LoBigInt *b)
+{
+    // The top three limbs carry more bits than a double keeps
+    uint32_t low = b->count > 3 ? b->count - 3 : 0;
+    double d = 0.0;
+    for (uint32_t i = b->count; i-- > low;)
+        d = d * 4294967296.0 + b->limbs[i];
+    for (uint32_t i = 0; i < low; i++)
+        d *= 4294967296.0;
+    return b->sign < 0 ? -d : d;
+}
+
+uint32_t bigint_hash(const LoBigInt *b)
+{
+    // FNV-1a over the sign and the limbs
+    uint32_t h = 2166136261u ^ (uint32_t)(b->sign < 0);
+    for (uint32_t i = 0; i < b->count; i++)
+    {
+        h ^= b->limbs[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void bigint_print(const LoBigInt *b)
+{
+    // Peel off base-10^9 digits from the bottom, then print from the top
+    uint32_t *work = (uint32_t *)malloc(b->count * sizeof(uint32_t));
+    uint32_t *groups = (uint32_t *)malloc((b->count * 2 + 1) * sizeof(uint32_t));
+    memcpy(work, b->limbs, b->count * sizeof(uint32_t));
+    uint32_t n = b->count;
+    size_t count = 0;
+    do
+    {
+        uint64_t rem = 0;
+        for (uint32_t j = n; j-- > 0;)
+        {
+            uint64_t cur = (rem << 32) | work[j];
+            work[j] = (uint32_t)(cur / 1000000000u);
+            rem = cur % 1000000000u;
+        }
+        groups[count++] = (uint32_t)rem;
+        while (n > 0 && work[n - 1] == 0)
+            n--;
+    } while (n > 0);
+
+    char *text = (char *)malloc(count * 9 + 2);
+    int length = 0;
+    if (b->sign < 0)
+        text[length++] = '-';
+    length += sprintf(text + length, "%u", (unsigned)groups[count - 1]);
+    for (size_t i = count - 1; i-- > 0;)
+        length += sprintf(text + length, "%09u", (unsigned)groups[i]);
+    out_write(text, (size_t)length);
+    free(text);
+    free(groups);
+    free(work);
+}
@@ -0,0 +1,105 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include "value.h"
+#include "token.h"
+
+// Arbitrary-precision ints. Arithmetic on small ints runs inline with an
+// overflow check, and only a result that doesn't fit the small range is
+// built as a LoBigInt (value.h); results that fit again are demoted, so
+// code that never overflows never allocates.
+
+// Multiplies where both sides have at least this many limbs split with
+// Karatsuba; smaller ones use the schoolbook method
+#define KARATSUBA_THRESHOLD 32
+
+// Checked int64_t arithmetic: stores the wrapped result and is nonzero if
+// the true one doesn't fit. Macros, so the builtins stay inline even in
+// unoptimized builds.
+#if defined(__GNUC__)
+#define int_add_overflow(x, y, result) __builtin_add_overflow(x, y, result)
+#define int_sub_overflow(x, y, result) __builtin_sub_overflow(x, y, result)
+#define int_mul_overflow(x, y, result) __builtin_mul_overflow(x, y, result)
+#else
+static inline int int_add_overflow(int64_t x, int64_t y, int64_t *result)
+{
+    *result = (int64_t)((uint64_t)x + (uint64_t)y);
+    return y > 0 ? x > INT64_MAX - y : x < INT64_MIN - y;
+}
+
+static inline int int_sub_overflow(int64_t x, int64_t y, int64_t *result)
+{
+    *result = (int64_t)((uint64_t)x - (uint64_t)y);
+    return y < 0 ? x > INT64_MAX + y : x < INT64_MIN + y;
+}
+
+static inline int int_mul_overflow(int64_t x, int64_t y, int64_t *result)
+{
+    *result = (int64_t)((uint64_t)x * (uint64_t)y);
+    if (x == 0 || y == 0)
+        return 0;
+    if (x == -1)
+        return y == INT64_MIN;
+    if (y == -1)
+        return x == INT64_MIN;
+    return x > 0 ? (y > 0 ? x > INT64_MAX / y : y < INT64_MIN / x)
+                 : (y > 0 ? x < INT64_MIN / y : x < INT64_MAX / y);
+}
+#endif
+
+// `op` on two small ints whose result doesn't fit a small int
+Value bigint_int_op(int op, int64_t left, int64_t right);
+
+// Whether an int64_t result needs a range check before value_int(); a
+// constant, so the check folds away where small ints are all of int64_t
+#define INT_RANGE_NARROW (VALUE_INT_MAX < INT64_MAX)
+
+// Nonzero if x + y (x - y, x * y) of two small ints is a small int too,
+// which is stored in *result. For the interpreters' inline int paths.
+#define small_int_add(x, y, result) \
+    (!int_add_overflow(x, y, result) && (!INT_RANGE_NARROW || value_fits_int(*(result))))
+#define small_int_sub(x, y, result) \
+    (!int_sub_overflow(x, y, result) && (!INT_RANGE_NARROW || value_fits_int(*(result))))
+#define small_int_mul(x, y, result) \
+    (!int_mul_overflow(x, y, result) && (!INT_RANGE_NARROW || value_fits_int(*(result))))
+
+// x + y, x - y and x * y of two small ints, promoting on overflow
+static inline Value value_int_add(int64_t x, int64_t y)
+{
+    int64_t result;
+    return small_int_add(x, y, &result) ? value_int(result) : bigint_int_op(TOKEN_PLUS, x, y);
+}
+
+static inline Value value_int_sub(int64_t x, int64_t y)
+{
+    int64_t result;
+    return small_int_sub(x, y, &result) ? value_int(result) : bigint_int_op(TOKEN_MINUS, x, y);
+}
+
+static inline Value value_int_mul(int64_t x, int64_t y)
+{
+    int64_t result;
+    return small_int_mul(x, y, &result) ? value_int(result) : bigint_int_op(TOKEN_MUL, x, y);
+}
+
+// value_binary_op() for two ints, at least one of them a bigint. Division
+// truncates toward zero, like it does for small ints.
+Value bigint_binary_op(int op, Value left, Value right);
+
+// The int spelled by `length` decimal digits
+Value bigint_parse(const char *digits, size_t length);
+
+// Sets `*i` and returns 1 if `b` fits an int64_t (it may, in builds
+// whose small ints are narrower)
+int bigint_to_int64(const LoBigInt *b, int64_t *i);
+
+// Nearest double; infinite beyond the double range
+double bigint_to_double(const LoBigInt *b);
+
+// -1, 0 or 1 as left < right, ==, >, for any two ints
+int bigint_compare(Value left, Value right);
+
+uint32_t bigint_hash(const LoBigInt *b);
+void bigint_print(const LoBigInt *b);
+
+#endif
@@ -0,0 +1,144 @@
+#include <string.h>
+#include "builtins.h"
+#include "array.h"
+#include "bigint.h"
+#include "dict.h"
+#include "output.h"
+
+typedef struct
+{
+    const char *name;
+    int min_args;
+    int max_args;
+} BuiltinInfo;
+
+static const BuiltinInfo builtin_info[BUILTIN_COUNT] = {
+    {"len", 1, 1},
+    {"array", 1, 2},    // array(n[, fill]): n copies of fill, 0 by default
+    {"append", 2, 2},   // append(a, v): in place, returns None
+    {"sum", 1, 1},
+    {"min", 1, CALL_MAX_ARGS}, // Of one array, or of the arguments
+    {"max", 1, CALL_MAX_ARGS},
+    {"dot", 2, 2},
+    {"$items", 1, 1}, // The elements of an array, or the keys of a dict, as an array
+    {"$len", 1, 1}};
+
+void builtins_init(Environment *env)
+{
+    for (int b = 0; b < BUILTIN_COUNT; b++)
+    {
+        const char *name = builtin_info[b].name;
+        env->builtins[b] = symbol_intern(env->symbols, name, (int)strlen(name));
+    }
+}
+
+int builtin_lookup(Environment *env, int sym)
+{
+    if (sym < env->function_of_capacity && env->function_of[sym] >= 0)
+        return -1;
+    for (int b = 0; b < BUILTIN_COUNT; b++)
+    {
+        if (env->builtins[b] == sym)
+            return b;
+    }
+    return -1;
+}
+
+// Reports that builtin `b` wants an array as its argument
+static Value needs_array(int b)
+{
+    err_printf("Runtime Error: %s() needs an array\n", builtin_info[b].name);
+    return value_none();
+}
+
+// min() or max() of the arguments themselves
+static Value extreme_of_args(int b, const Value *args, int count)
+{
+    Value copies[CALL_MAX_ARGS];
+    for (int i = 0; i < count; i++)
+    {
+        copies[i] = value_copy(args[i]);
+    }
+    Value items = array_from_values(copies, (uint32_t)count);
+    Value v = b == BUILTIN_MIN ? array_min(value_as_array(items)) : array_max(value_as_array(items));
+    value_free(items);
+    return v;
+}
+
+Value builtin_call(int b, const Value *args, int count)
+{
+    const BuiltinInfo *info = &builtin_info[b];
+    if (count < info->min_args || count > info->max_args)
+    {
+        if (info->min_args == info->max_args)
+            err_printf("Runtime Error: '%s' takes %d argument%s, got %d\n", info->name, info->min_args,
+                       info->min_args == 1 ? "" : "s", count);
+        else if (info->max_args == CALL_MAX_ARGS)
+            err_printf("Runtime Error: '%s' takes at least %d argument%s, got %d\n", info->name, info->min_args,
+                       info->min_args == 1 ? "" : "s", count);
+        else
+            err_printf("Runtime Error: '%s' takes %d or %d arguments, got %d\n", info->name, info->min_args,
+                       info->max_args, count);
+        return value_none();
+    }
+
+    switch (b)
+    {
+    case BUILTIN_LEN:
+    case BUILTIN_LOOP_LEN:
+        if (value_is_array(args[0]))
+            return value_int(value_as_array(args[0])->count);
+        if (value_is_dict(args[0]))
+            return value_int(value_as_dict(args[0])->count);
+        if (value_type(args[0]) == VAL_STRING)
+            return value_int((int64_t)value_string_length(&args[0]));
+        err_printf("Runtime Error: len() needs an array, a dict or a string\n");
+        return value_none();
+
+    case BUILTIN_LOOP_ITEMS:
+        if (value_is_array(args[0]))
+            return value_copy(args[0]);
+        if (value_is_dict(args[0]))
+            return dict_keys(value_as_dict(args[0]));
+        // An empty loop follows, not a second error from $len()
+        err_printf("Runtime Error: Can only loop over an array or a dict\n");
+        return value_from_array(array_new(ARRAY_INT, 0));
+
+    case BUILTIN_ARRAY:
+        if (!value_is_integer(args[0]) || bigint_compare(args[0], value_int(0)) < 0)
+        {
+            err_printf("Runtime Error: array() size must be a non-negative int\n");
+            return value_none();
+        }
+        if (value_is_bigint(args[0]) || value_as_int(args[0]) > UINT32_MAX)
+        {
+            err_printf("Runtime Error: array() size is too large\n");
+            return value_none();
+        }
+        return array_filled((uint32_t)value_as_int(args[0]), count > 1 ? args[1] : value_int(0));
+
+    case BUILTIN_APPEND:
+        if (!value_is_array(args[0]))
+            return needs_array(b);
+        array_append(value_as_array(args[0]), args[1]);
+        return value_none();
+
+    case BUILTIN_SUM:
+        if (!value_is_array(args[0]))
+            return needs_array(b);
+        return array_sum(value_as_array(args[0]));
+
+    case BUILTIN_MIN:
+    case BUILTIN_MAX:
+        if (count > 1 || !value_is_array(args[0]))
+            return extreme_of_args(b, args, count);
+        if (b == BUILTIN_MIN)
+            return array_min(value_as_array(args[0]));
+        return array_max(value_as_array(args[0]));
+
+    default:
+        if (!value_is_array(args[0]) || !value_is_array(args[1]))
+            return needs_array(b);
+        return array_dot(value_as_array(args[0]), value_as_array(args[1]));
+    }
+}
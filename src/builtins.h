@@ -0,0 +1,17 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "eval.h"
+
+// Interns the builtin names into the environment's symbol table.
+void builtins_init(Environment *env);
+
+// The BUILTIN_* a call to `sym` runs, or -1 if `sym` names no builtin or
+// a def of that name shadows it.
+int builtin_lookup(Environment *env, int sym);
+
+// Runs `builtin` on `count` arguments, which stay the caller's. Bad
+// arguments are reported and give None.
+Value builtin_call(int builtin, const Value *args, int count);
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bytecode.h"
+#include "jit.h"
+#include "output.h"
+
+void chunk_init(Chunk *chunk)
+{
+    chunk->code = NULL;
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->constants = NULL;
+    chunk->const_count = 0;
+    chunk->const_capacity = 0;
+    chunk->global_count = 0;
+    chunk->reg_count = 0;
+    chunk->borrowed = 0;
+    chunk->jit = NULL;
+}
+
+void chunk_free(Chunk *chunk)
+{
+    if (!chunk->borrowed)
+    {
+        free(chunk->code);
+        for (int i = 0; i < chunk->const_count; i++)
+        {
+            value_free(chunk->constants[i]);
+        }
+        free(chunk->constants);
+    }
+    jit_release(chunk);
+    chunk_init(chunk);
+}
+
+int chunk_emit(Chunk *chunk, Instr ins)
+{
+    if (chunk->count >= chunk->capacity)
+    {
+        int new_capacity = chunk->capacity == 0 ? 16 : chunk->capacity * 2;
+        chunk->code = (Instr *)realloc(chunk->code, new_capacity * sizeof(Instr));
+        chunk->capacity = new_capacity;
+    }
+    chunk->code[chunk->count] = ins;
+    return chunk->count++;
+}
+
+int chunk_add_constant(Chunk *chunk, Value value)
+{
+    if (chunk->const_count >= chunk->const_capacity)
+    {
+        int new_capacity = chunk->const_capacity == 0 ? 8 : chunk->const_capacity * 2;
+        chunk->constants = (Value *)realloc(chunk->constants, new_capacity * sizeof(Value));
+        chunk->const_capacity = new_capacity;
+    }
+    chunk->constants[chunk->const_count] = value;
+    return chunk->const_count++;
+}
+
+static const char *op_names[] = {
+    "LOADNIL", "LOADK", "MOVE",
+    "ADD", "SUB", "MUL", "DIV", "EQ", "NEQ", "LT", "GT", "LE", "GE",
+    "ADD_II", "SUB_II", "MUL_II", "ADD_FF", "SUB_FF", "MUL_FF",
+    "ADDI", "JEQ", "JNEQ", "JLT", "JGT", "JLE", "JGE",
+    "ADDI_I", "JEQ_II", "JNEQ_II", "JLT_II", "JGT_II", "JLE_II", "JGE_II",
+    "JMP", "JMPIF", "PRINT", "RETURN",
+    "GETGLOBAL", "CALL", "TAILCALL",
+    "NEWARRAY", "GETINDEX", "SETINDEX", "NEWDICT", "IN", "DEF"};
+
+void chunk_disassemble(Chunk *chunk)
+{
+    out_printf("; %d registers, %d globals, %d constants\n",
+           chunk->reg_count, chunk->global_count, chunk->const_count);
+    for (int pc = 0; pc < chunk->count; pc++)
+    {
+        Instr ins = chunk->code[pc];
+        out_printf("%04d  %-9s", pc, op_names[ins.op]);
+        switch (ins.op)
+        {
+        case OP_LOADNIL:
+        case OP_PRINT:
+        case OP_RETURN:
+            out_printf("r%d", ins.a);
+            break;
+        case OP_LOADK:
+            out_printf("r%d, k%d  ; ", ins.a, ins.sx);
+            value_print(chunk->constants[ins.sx]);
+            break;
+        case OP_MOVE:
+            out_printf("r%d, r%d", ins.a, ins.b);
+            break;
+        case OP_ADDI:
+        case OP_ADDI_I:
+            out_printf("r%d, r%d, %d", ins.a, ins.b, (int16_t)ins.c);
+            break;
+        case OP_JEQ:
+        case OP_JNEQ:
+        case OP_JLT:
+        case OP_JGT:
+        case OP_JLE:
+        case OP_JGE:
+        case OP_JEQ_II:
+        case OP_JNEQ_II:
+        case OP_JLT_II:
+        case OP_JGT_II:
+        case OP_JLE_II:
+        case OP_JGE_II:
+            out_printf("r%d, r%d, k=%d -> %d", ins.a, ins.b, ins.k, chunk->code[pc + 1].sx);
+            pc++;
+            break;
+        case OP_JMP:
+            out_printf("-> %d", ins.sx);
+            break;
+        case OP_JMPIF:
+            out_printf("r%d, k=%d -> %d", ins.a, ins.k, ins.sx);
+            break;
+        case OP_GETGLOBAL:
+            out_printf("r%d, g%d", ins.a, ins.sx);
+            break;
+        case OP_CALL:
+        case OP_TAILCALL:
+            out_printf("r%d, %d args, sym %d", ins.a, ins.k, ins.sx);
+            break;
+        case OP_NEWARRAY:
+        case OP_NEWDICT:
+            out_printf("r%d, r%d, %d items", ins.a, ins.b, ins.c);
+            break;
+        case OP_DEF:
+            out_printf("f%d", ins.sx);
+            break;
+        default:
+            out_printf("r%d, r%d, r%d", ins.a, ins.b, ins.c);
+            break;
+        }
+        out_printf("\n");
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include "value.h"
+
+// Register-based bytecode. Every instruction is one 8-byte word; operands
+// a/b/c name registers in the current frame. The low registers are the
+// environment's global slots, literal constants sit right above them and
+// temporaries come last, so most statements compile to a single instruction.
+typedef enum
+{
+    OP_LOADNIL, // R[a] = None
+    OP_LOADK,   // R[a] = K[sx]
+    OP_MOVE,    // R[a] = R[b]
+
+    OP_ADD, // R[a] = R[b] + R[c]
+    OP_SUB, // R[a] = R[b] - R[c]
+    OP_MUL, // R[a] = R[b] * R[c]
+    OP_DIV, // R[a] = R[b] / R[c]
+    OP_EQ,  // R[a] = R[b] == R[c]
+    OP_NEQ, // R[a] = R[b] != R[c]
+    OP_LT,  // R[a] = R[b] < R[c]
+    OP_GT,  // R[a] = R[b] > R[c]
+    OP_LE,  // R[a] = R[b] <= R[c]
+    OP_GE,  // R[a] = R[b] >= R[c]
+
+    // Type-specialized forms, emitted where infer_types() proved the
+    // operand types; they skip the run-time type dispatch. The int forms
+    // still check for bigints, which ints promote to on overflow.
+    OP_ADD_II, // R[a] = R[b] + R[c], both ints
+    OP_SUB_II,
+    OP_MUL_II,
+    OP_ADD_FF, // R[a] = R[b] + R[c], both floats
+    OP_SUB_FF,
+    OP_MUL_FF,
+
+    // Superinstructions
+    OP_ADDI, // R[a] = R[b] + (int16_t)c   (load-add-store, e.g. i = i + 1)
+    OP_JEQ,  // if ((R[a] == R[b]) == k) pc = next.sx else skip next
+    OP_JNEQ, // compare-and-branch; the following OP_JMP word holds the target
+    OP_JLT,
+    OP_JGT,
+    OP_JLE,
+    OP_JGE,
+    OP_ADDI_I, // OP_ADDI with R[b] known to be an int
+    OP_JEQ_II, // compare-and-branch on two ints
+    OP_JNEQ_II,
+    OP_JLT_II,
+    OP_JGT_II,
+    OP_JLE_II,
+    OP_JGE_II,
+
+    OP_JMP,   // pc = sx
+    OP_JMPIF, // if (truthy(R[a]) == k) pc = sx
+    OP_PRINT, // print R[a]
+    OP_RETURN, // return R[a]
+
+    // Function frames (compile_function()) have no globals in their low
+    // registers; they start with the parameters and other locals instead
+    OP_GETGLOBAL, // R[a] = global slot sx
+    OP_CALL,      // R[a] = function sx called with the k arguments in R[a]..
+    OP_TAILCALL,  // return function sx called with the k arguments in R[a]..
+
+    OP_NEWARRAY, // R[a] = [R[b], .. R[b+c-1]], moving the items out
+    OP_GETINDEX, // R[a] = R[b][R[c]]
+    OP_SETINDEX, // R[a][R[b]] = R[c]
+    OP_NEWDICT,  // R[a] = {R[b]: R[b+1], ..}, c items in all, moving them out
+    OP_IN,       // R[a] = R[b] in R[c]
+    OP_DEF       // Binds function sx (an index into env->functions) to its name
+} OpCode;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t k; // Branch polarity for conditional jumps
+    uint16_t a;
+    union
+    {
+        struct
+        {
+            uint16_t b;
+            uint16_t c;
+        };
+        int32_t sx;
+    };
+} Instr;
+
+typedef struct
+{
+    Instr *code;
+    int count;
+    int capacity;
+
+    Value *constants;
+    int const_count;
+    int const_capacity;
+
+    int global_count; // Registers 0..global_count-1 are environment slots; 0 for functions
+    int reg_count;
+
+    int borrowed; // Code and constants belong to a loaded image, not the chunk
+
+    struct JitCache *jit; // Loop counters and compiled code; NULL until --jit sees a back-edge
+} Chunk;
+
+void chunk_init(Chunk *chunk);
+void chunk_free(Chunk *chunk);
+int chunk_emit(Chunk *chunk, Instr ins);
+int chunk_add_constant(Chunk *chunk, Value value);
+void chunk_disassemble(Chunk *chunk);
+
+#endif
@@ -0,0 +1,683 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "bigint.h"
+#include "token.h"
+
+#define MAX_REGISTERS 65535
+
+// Registers kept free for temporaries when pinning literals. Literals that
+// don't fit below them are loaded into a temporary at each use instead.
+#define TEMPORARY_RESERVE 1024
+
+typedef struct
+{
+    AST *ast;
+    Chunk *chunk;
+    int const_base; // First literal register
+    int pinned;     // Constants [0, pinned) have registers; the rest are loaded
+    int next_reg;   // First free temporary register
+    int error;
+    int in_function; // Globals are read with OP_GETGLOBAL, not addressed as registers
+
+    int *literal_const; // Node id -> constant index, for literal nodes
+
+    int *const_index;   // open-addressing table of constant indices, -1 when empty
+    int const_index_capacity;
+} Compiler;
+
+// Literal payload as raw bits, so -0.0 and 0.0 stay distinct constants
+static uint64_t constant_bits(Value k)
+{
+    uint64_t bits = 0;
+    if (value_is_float(k))
+    {
+        double d = value_as_float(k);
+        memcpy(&bits, &d, sizeof(double));
+    }
+    else
+    {
+        bits = (uint64_t)(int64_t)value_as_int(k);
+    }
+    return bits;
+}
+
+static unsigned int hash_constant(Value k)
+{
+    if (value_type(k) == VAL_STRING)
+        return value_string_hash(&k);
+    if (value_is_bigint(k))
+        return bigint_hash(value_as_bigint(k));
+
+    // FNV-1a over the payload bytes
+    uint64_t bits = constant_bits(k);
+    unsigned int h = 2166136261u ^ (unsigned int)value_type(k);
+    for (size_t i = 0; i < sizeof(bits); i++)
+    {
+        h ^= (unsigned char)(bits >> (i * 8));
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int constants_equal(Value a, Value b)
+{
+    if (value_type(a) != value_type(b))
+        return 0;
+    if (value_type(a) == VAL_STRING)
+        return value_string_length(&a) == value_string_length(&b) &&
+               memcmp(value_string_chars(&a), value_string_chars(&b), value_string_length(&a)) == 0;
+    if (value_is_bigint(a))
+        return bigint_compare(a, b) == 0;
+    return constant_bits(a) == constant_bits(b);
+}
+
+static void const_index_insert(Compiler *c, int index)
+{
+    unsigned int mask = c->const_index_capacity - 1;
+    unsigned int i = hash_constant(c->chunk->constants[index]) & mask;
+    while (c->const_index[i] >= 0)
+    {
+        i = (i + 1) & mask;
+    }
+    c->const_index[i] = index;
+}
+
+// Returns the index of constant `k`, taking ownership of it.
+static int intern_constant(Compiler *c, Value k)
+{
+    Chunk *chunk = c->chunk;
+
+    // Keep the index at most half full
+    if ((chunk->const_count + 1) * 2 > c->const_index_capacity)
+    {
+        int new_capacity = c->const_index_capacity == 0 ? 64 : c->const_index_capacity * 2;
+        free(c->const_index);
+        c->const_index = (int *)malloc(new_capacity * sizeof(int));
+        c->const_index_capacity = new_capacity;
+        for (int i = 0; i < new_capacity; i++)
+        {
+            c->const_index[i] = -1;
+        }
+        for (int i = 0; i < chunk->const_count; i++)
+        {
+            const_index_insert(c, i);
+        }
+    }
+
+    unsigned int mask = c->const_index_capacity - 1;
+    unsigned int i = hash_constant(k) & mask;
+    while (c->const_index[i] >= 0)
+    {
+        if (constants_equal(chunk->constants[c->const_index[i]], k))
+        {
+            value_free(k);
+            return c->const_index[i];
+        }
+        i = (i + 1) & mask;
+    }
+    int index = chunk_add_constant(chunk, k);
+    c->const_index[i] = index;
+    return index;
+}
+
+// First pass: number every distinct literal, to be pinned to a register
+// as far as they fit.
+static void collect(Compiler *c, NodeId id)
+{
+    if (id == AST_NONE)
+        return;
+
+    AST *ast = c->ast;
+    ASTNode *node = ast_node(ast, id);
+    switch (node->type)
+    {
+    case AST_INT:
+    case AST_FLOAT:
+    case AST_STRING:
+    case AST_BIGINT:
+    {
+        Value k;
+        if (node->type == AST_INT)
+            k = value_int(ast_int(node));
+        else if (node->type == AST_FLOAT)
+            k = value_float(ast_float(ast, node));
+        else
+            k = value_copy(ast_string(ast, node));
+        c->literal_const[id] = intern_constant(c, k);
+        break;
+    }
+    case AST_ASSIGNMENT:
+    case AST_LOCAL_ASSIGNMENT:
+        collect(c, node->assignment.value);
+        break;
+    case AST_BINARY_OP:
+        collect(c, node->binary.left);
+        collect(c, node->binary.right);
+        break;
+    case AST_IF:
+        collect(c, node->if_stmt.condition);
+        collect(c, node->if_stmt.then_branch);
+        collect(c, node->if_stmt.else_branch);
+        break;
+    case AST_WHILE:
+        collect(c, node->while_loop.condition);
+        collect(c, node->while_loop.body);
+        break;
+    case AST_PRINT:
+        collect(c, node->print_stmt.expr);
+        break;
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            collect(c, ast_block_statement(ast, node, i));
+        }
+        break;
+    case AST_CALL:
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            collect(c, ast_call_arg(ast, node, i));
+        }
+        break;
+    case AST_RETURN:
+        collect(c, node->return_stmt.value);
+        break;
+    case AST_ARRAY:
+    case AST_DICT:
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            collect(c, ast_array_item(ast, node, i));
+        }
+        break;
+    case AST_INDEX:
+    case AST_INDEX_ASSIGNMENT:
+        collect(c, node->index.target);
+        collect(c, node->index.index);
+        collect(c, node->index.value);
+        break;
+    default:
+        break;
+    }
+}
+
+static int emit(Compiler *c, uint8_t op, int a, int b, int cc)
+{
+    Instr ins = {0};
+    ins.op = op;
+    ins.a = (uint16_t)a;
+    ins.b = (uint16_t)b;
+    ins.c = (uint16_t)cc;
+    return chunk_emit(c->chunk, ins);
+}
+
+static int emit_jump(Compiler *c, uint8_t op, int a, int k)
+{
+    Instr ins = {0};
+    ins.op = op;
+    ins.k = (uint8_t)k;
+    ins.a = (uint16_t)a;
+    ins.sx = -1;
+    return chunk_emit(c->chunk, ins);
+}
+
+static void patch_jump(Compiler *c, int at, int target)
+{
+    c->chunk->code[at].sx = target;
+}
+
+static int alloc_reg(Compiler *c)
+{
+    if (c->next_reg >= MAX_REGISTERS)
+    {
+        c->error = 1;
+        return MAX_REGISTERS - 1;
+    }
+    int reg = c->next_reg++;
+    if (c->next_reg > c->chunk->reg_count)
+        c->chunk->reg_count = c->next_reg;
+    return reg;
+}
+
+static int binary_opcode(int op)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS: return OP_ADD;
+    case TOKEN_MINUS: return OP_SUB;
+    case TOKEN_MUL: return OP_MUL;
+    case TOKEN_DIV: return OP_DIV;
+    case TOKEN_EQ: return OP_EQ;
+    case TOKEN_NEQ: return OP_NEQ;
+    case TOKEN_LT: return OP_LT;
+    case TOKEN_GT: return OP_GT;
+    case TOKEN_LE: return OP_LE;
+    case TOKEN_GE: return OP_GE;
+    case TOKEN_IN: return OP_IN;
+    default: return -1;
+    }
+}
+
+// The specialized form of an arithmetic opcode, if the operand types allow
+static int specialize_opcode(int op, int form)
+{
+    if (form == BINARY_INT_INT)
+    {
+        switch (op)
+        {
+        case OP_ADD: return OP_ADD_II;
+        case OP_SUB: return OP_SUB_II;
+        case OP_MUL: return OP_MUL_II;
+        }
+    }
+    else if (form == BINARY_FLOAT_FLOAT)
+    {
+        switch (op)
+        {
+        case OP_ADD: return OP_ADD_FF;
+        case OP_SUB: return OP_SUB_FF;
+        case OP_MUL: return OP_MUL_FF;
+        }
+    }
+    return op;
+}
+
+static int is_comparison(ASTNode *node)
+{
+    if (node->type != AST_BINARY_OP)
+        return 0;
+    int op = binary_opcode(node->op);
+    return op >= OP_EQ && op <= OP_GE;
+}
+
+static void compile_node(Compiler *c, NodeId id, int dest);
+
+// Evaluates the arguments of the call at `id` into consecutive temporaries
+// and emits `op` on them. The result lands in the first one, returned.
+static int compile_call(Compiler *c, NodeId id, int op)
+{
+    ASTNode *node = ast_node(c->ast, id);
+    int count = (int)node->call.count;
+    int base = alloc_reg(c);
+    for (int i = 1; i < count; i++)
+    {
+        alloc_reg(c);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        compile_node(c, ast_call_arg(c->ast, ast_node(c->ast, id), i), base + i);
+    }
+    Instr ins = {0};
+    ins.op = (uint8_t)op;
+    ins.k = (uint8_t)count;
+    ins.a = (uint16_t)base;
+    ins.sx = ast_node(c->ast, id)->call.sym;
+    chunk_emit(c->chunk, ins);
+    return base;
+}
+
+static int is_literal(ASTNode *node)
+{
+    return node->type == AST_INT || node->type == AST_FLOAT || node->type == AST_STRING ||
+           node->type == AST_BIGINT;
+}
+
+static void emit_loadk(Compiler *c, int dest, int index)
+{
+    Instr ins = {0};
+    ins.op = OP_LOADK;
+    ins.a = (uint16_t)dest;
+    ins.sx = index;
+    chunk_emit(c->chunk, ins);
+}
+
+// Returns a register holding the value of `id`. Variables and pinned
+// literals already live in registers, everything else goes to a fresh
+// temporary.
+static int compile_operand(Compiler *c, NodeId id)
+{
+    ASTNode *node = ast_node(c->ast, id);
+    if (id != AST_NONE)
+    {
+        if (node->type == AST_LOCAL || (node->type == AST_IDENTIFIER && !c->in_function))
+            return node->identifier.slot;
+        if (is_literal(node) && c->literal_const[id] < c->pinned)
+            return c->const_base + c->literal_const[id];
+        if (node->type == AST_CALL)
+            return compile_call(c, id, OP_CALL);
+    }
+
+    int reg = alloc_reg(c);
+    compile_node(c, id, reg);
+    return reg;
+}
+
+// Emits a branch taken when the truthiness of `cond` equals `k`.
+// Returns the index of the word holding the jump target.
+static int compile_branch(Compiler *c, NodeId cond, int k)
+{
+    int saved = c->next_reg;
+    ASTNode *node = ast_node(c->ast, cond);
+    int at;
+
+    if (cond != AST_NONE && is_comparison(node))
+    {
+        int l = compile_operand(c, node->binary.left);
+        int r = compile_operand(c, node->binary.right);
+        int base = node->aux == BINARY_INT_INT ? OP_JEQ_II : OP_JEQ;
+        int op = binary_opcode(node->op) - OP_EQ + base;
+        Instr ins = {0};
+        ins.op = (uint8_t)op;
+        ins.k = (uint8_t)k;
+        ins.a = (uint16_t)l;
+        ins.b = (uint16_t)r;
+        chunk_emit(c->chunk, ins);
+        at = emit_jump(c, OP_JMP, 0, 0);
+    }
+    else
+    {
+        int reg = compile_operand(c, cond);
+        at = emit_jump(c, OP_JMPIF, reg, k);
+    }
+
+    c->next_reg = saved;
+    return at;
+}
+
+// Compiles `id` so that its value ends up in register `dest`, or is
+// discarded when `dest` is negative.
+static void compile_node(Compiler *c, NodeId id, int dest)
+{
+    int saved = c->next_reg;
+
+    if (id == AST_NONE)
+    {
+        if (dest >= 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        return;
+    }
+
+    AST *ast = c->ast;
+    ASTNode *node = ast_node(ast, id);
+    switch (node->type)
+    {
+    case AST_INT:
+    case AST_FLOAT:
+    case AST_STRING:
+    case AST_BIGINT:
+        if (dest >= 0 && c->literal_const[id] >= c->pinned)
+            emit_loadk(c, dest, c->literal_const[id]);
+        else if (dest >= 0)
+            emit(c, OP_MOVE, dest, compile_operand(c, id), 0);
+        break;
+
+    case AST_LOCAL:
+        if (dest >= 0)
+            emit(c, OP_MOVE, dest, compile_operand(c, id), 0);
+        break;
+
+    case AST_IDENTIFIER:
+        if (dest < 0)
+            break;
+        if (c->in_function)
+        {
+            Instr ins = {0};
+            ins.op = OP_GETGLOBAL;
+            ins.a = (uint16_t)dest;
+            ins.sx = node->identifier.slot;
+            chunk_emit(c->chunk, ins);
+        }
+        else
+        {
+            emit(c, OP_MOVE, dest, node->identifier.slot, 0);
+        }
+        break;
+
+    case AST_BINARY_OP:
+    {
+        // Still evaluated when discarded: division by zero reports an error
+        if (dest < 0)
+            dest = alloc_reg(c);
+
+        int l = compile_operand(c, node->binary.left);
+        ASTNode *right = ast_node(ast, node->binary.right);
+        if (node->op == TOKEN_PLUS && node->binary.right != AST_NONE && right->type == AST_INT &&
+            ast_int(right) >= INT16_MIN && ast_int(right) <= INT16_MAX)
+        {
+            emit(c, node->aux == BINARY_INT_INT ? OP_ADDI_I : OP_ADDI, dest, l,
+                 (uint16_t)(int16_t)ast_int(right));
+            break;
+        }
+        int r = compile_operand(c, node->binary.right);
+        int op = specialize_opcode(binary_opcode(node->op), node->aux);
+        if (op < 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        else
+            emit(c, (uint8_t)op, dest, l, r);
+        break;
+    }
+
+    case AST_ASSIGNMENT:
+    case AST_LOCAL_ASSIGNMENT:
+    {
+        // Operands are read before the result is written, so the value can
+        // be computed straight into the variable's register.
+        int var = node->assignment.slot;
+        NodeId value = node->assignment.value;
+        int type = ast_node(ast, value)->type; // Node 0 (AST_NONE) exists too
+        if (value != AST_NONE && (type == AST_BINARY_OP || type == AST_CALL ||
+                                  type == AST_ARRAY || type == AST_DICT || type == AST_INDEX))
+            compile_node(c, value, var);
+        else
+            emit(c, OP_MOVE, var, compile_operand(c, value), 0);
+        if (dest >= 0)
+            emit(c, OP_MOVE, dest, var, 0);
+        break;
+    }
+
+    case AST_IF:
+    {
+        int to_else = compile_branch(c, node->if_stmt.condition, 0);
+        compile_node(c, node->if_stmt.then_branch, dest);
+        if (node->if_stmt.else_branch != AST_NONE || dest >= 0)
+        {
+            int to_end = emit_jump(c, OP_JMP, 0, 0);
+            patch_jump(c, to_else, c->chunk->count);
+            if (node->if_stmt.else_branch != AST_NONE)
+                compile_node(c, node->if_stmt.else_branch, dest);
+            else
+                emit(c, OP_LOADNIL, dest, 0, 0);
+            patch_jump(c, to_end, c->chunk->count);
+        }
+        else
+        {
+            patch_jump(c, to_else, c->chunk->count);
+        }
+        break;
+    }
+
+    case AST_WHILE:
+    {
+        // Rotated loop: one compare-and-branch per iteration
+        int to_test = emit_jump(c, OP_JMP, 0, 0);
+        int body = c->chunk->count;
+        compile_node(c, node->while_loop.body, -1);
+        patch_jump(c, to_test, c->chunk->count);
+        int to_body = compile_branch(c, node->while_loop.condition, 1);
+        patch_jump(c, to_body, body);
+        if (dest >= 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        break;
+    }
+
+    case AST_PRINT:
+        emit(c, OP_PRINT, compile_operand(c, node->print_stmt.expr), 0, 0);
+        if (dest >= 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        break;
+
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            compile_node(c, ast_block_statement(ast, node, i), -1);
+        }
+        if (dest >= 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        break;
+
+    case AST_CALL:
+    {
+        int result = compile_call(c, id, OP_CALL);
+        if (dest >= 0)
+            emit(c, OP_MOVE, dest, result, 0);
+        break;
+    }
+
+    case AST_RETURN:
+    {
+        NodeId value = node->return_stmt.value;
+        if (value != AST_NONE && ast_node(ast, value)->type == AST_CALL &&
+            ast_node(ast, value)->aux == CALL_TAIL)
+            compile_call(c, value, OP_TAILCALL);
+        else
+            emit(c, OP_RETURN, compile_operand(c, value), 0, 0);
+        if (dest >= 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        break;
+    }
+
+    case AST_ARRAY:
+    case AST_DICT:
+    {
+        // Items are evaluated into consecutive temporaries, which the array
+        // or dict takes over
+        if (dest < 0)
+            dest = alloc_reg(c);
+        int count = (int)node->array.count;
+        int base = c->next_reg;
+        for (int i = 0; i < count; i++)
+        {
+            alloc_reg(c);
+        }
+        for (int i = 0; i < count; i++)
+        {
+            compile_node(c, ast_array_item(ast, ast_node(ast, id), i), base + i);
+        }
+        emit(c, ast_node(ast, id)->type == AST_ARRAY ? OP_NEWARRAY : OP_NEWDICT, dest, base, count);
+        break;
+    }
+
+    case AST_INDEX:
+    {
+        // Still evaluated when discarded: a bad index reports an error
+        if (dest < 0)
+            dest = alloc_reg(c);
+        int target = compile_operand(c, node->index.target);
+        int index = compile_operand(c, ast_node(ast, id)->index.index);
+        emit(c, OP_GETINDEX, dest, target, index);
+        break;
+    }
+
+    case AST_INDEX_ASSIGNMENT:
+    {
+        int target = compile_operand(c, node->index.target);
+        int index = compile_operand(c, ast_node(ast, id)->index.index);
+        int value = compile_operand(c, ast_node(ast, id)->index.value);
+        emit(c, OP_SETINDEX, target, index, value);
+        if (dest >= 0)
+            emit(c, OP_MOVE, dest, value, 0);
+        break;
+    }
+
+    case AST_DEF:
+    {
+        // The resolver already made the function; this binds its name
+        Instr ins = {0};
+        ins.op = OP_DEF;
+        ins.sx = node->def.function;
+        chunk_emit(c->chunk, ins);
+        if (dest >= 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        break;
+    }
+
+    default:
+        if (dest >= 0)
+            emit(c, OP_LOADNIL, dest, 0, 0);
+        break;
+    }
+
+    c->next_reg = saved;
+}
+
+// Lays out `frame` registers (globals or a function's locals), then as
+// many constants of the tree at `id` as leave TEMPORARY_RESERVE free, then
+// temporaries, and emits the loads of the pinned constants. Returns -1 if
+// the frame alone doesn't fit.
+static int begin_chunk(Compiler *c, AST *ast, NodeId id, int frame, Chunk *chunk)
+{
+    c->ast = ast;
+    c->chunk = chunk;
+    c->error = 0;
+    c->literal_const = (int *)malloc((ast->count > 0 ? ast->count : 1) * sizeof(int));
+    c->const_index = NULL;
+    c->const_index_capacity = 0;
+
+    collect(c, id);
+    free(c->const_index);
+
+    if (frame >= MAX_REGISTERS)
+        return -1;
+    int room = MAX_REGISTERS - TEMPORARY_RESERVE - frame;
+    c->pinned = chunk->const_count < room ? chunk->const_count : (room > 0 ? room : 0);
+    c->const_base = frame;
+    c->next_reg = frame + c->pinned;
+    chunk->reg_count = c->next_reg;
+
+    for (int i = 0; i < c->pinned; i++)
+    {
+        emit_loadk(c, c->const_base + i, i);
+    }
+    return 0;
+}
+
+int compile(AST *ast, NodeId id, Environment *env, Chunk *chunk)
+{
+    Compiler c;
+    c.in_function = 0;
+    chunk->global_count = env->count;
+    if (begin_chunk(&c, ast, id, env->count, chunk) != 0)
+    {
+        free(c.literal_const);
+        return -1;
+    }
+
+    int result = alloc_reg(&c);
+    compile_node(&c, id, result);
+    emit(&c, OP_RETURN, result, 0, 0);
+
+    free(c.literal_const);
+    return c.error ? -1 : 0;
+}
+
+int compile_function(Function *fn)
+{
+    Compiler c;
+    c.in_function = 1;
+    Chunk *chunk = &fn->chunk;
+    chunk->global_count = 0;
+    if (begin_chunk(&c, &fn->ast, fn->body, fn->local_count, chunk) != 0)
+    {
+        free(c.literal_const);
+        return -1;
+    }
+
+    // Falling off the end returns None
+    compile_node(&c, fn->body, -1);
+    int none = alloc_reg(&c);
+    emit(&c, OP_LOADNIL, none, 0, 0);
+    emit(&c, OP_RETURN, none, 0, 0);
+
+    free(c.literal_const);
+    return c.error ? -1 : 0;
+}
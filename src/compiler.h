@@ -0,0 +1,20 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "ast.h"
+#include "bytecode.h"
+#include "eval.h"
+
+// Compiles the resolved tree at `id` into `chunk`. The chunk returns the
+// value of the node, so the REPL can echo expression statements exactly
+// like eval() does. Global slots of `env` become the chunk's low registers, which ties the
+// chunk to the environment's current layout.
+// Returns 0 on success, -1 if the program needs more registers than fit.
+int compile(AST *ast, NodeId id, Environment *env, Chunk *chunk);
+
+// Compiles the body of `fn` into its chunk, whose low registers are the
+// function's frame: parameters, then its other locals. Globals are read by
+// slot. Returns 0 on success, -1 if the body needs more registers than fit.
+int compile_function(Function *fn);
+
+#endif
@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dict.h"
+#include "array.h"
+#include "bigint.h"
+#include "output.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DICT_SSE2 1
+#endif
+
+// Control byte of a slot that holds nothing. A full slot holds the low 7
+// bits of its key's hash, so the high bit alone tells the two apart.
+// Nothing is ever removed, so there are no tombstones.
+#define DICT_EMPTY 0x80
+
+// Entries a table of `capacity` slots takes before it doubles. Keeping
+// 1/8 of the slots empty bounds the probes and guarantees they end.
+#define DICT_MAX_LOAD(capacity) ((capacity) / 8 * 7)
+
+// Entry index of a key that isn't there
+#define DICT_MISSING UINT32_MAX
+
+// Spreads `x` over all 32 bits (Fibonacci hashing): the low 7 bits go in
+// the control byte and the rest pick the group, so both must vary
+static uint32_t mix(uint64_t x)
+{
+    return (uint32_t)((x * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+// Sets `*hash` and returns 1 for an int or string key; reports anything else
+static int key_hash(const Value *key, uint32_t *hash)
+{
+    if (value_is_int(*key))
+        *hash = mix((uint64_t)value_as_int(*key));
+    else if (value_type(*key) == VAL_STRING)
+        *hash = mix(value_string_hash(key));
+    else if (value_is_bigint(*key))
+        *hash = mix(bigint_hash(value_as_bigint(*key)));
+    else
+    {
+        err_printf("Runtime Error: Dict keys must be ints or strings\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int keys_equal(const Value *a, const Value *b)
+{
+    if (value_is_int(*a))
+        return value_is_int(*b) && value_as_int(*a) == value_as_int(*b);
+    if (value_type(*a) == VAL_STRING)
+    {
+        size_t length = value_string_length(a);
+        return value_type(*b) == VAL_STRING && value_string_length(b) == length &&
+               memcmp(value_string_chars(a), value_string_chars(b), length) == 0;
+    }
+    return value_is_bigint(*b) && bigint_compare(*a, *b) == 0;
+}
+
+static int lowest_bit(unsigned mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+// Bit i is set where control byte i of the group at `ctrl` is `h2`
+static unsigned group_match(const uint8_t *ctrl, uint8_t h2)
+{
+#ifdef DICT_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < DICT_GROUP; i++)
+    {
+        mask |= (unsigned)(ctrl[i] == h2) << i;
+    }
+    return mask;
+#endif
+}
+
+// Bit i is set where slot i of the group at `ctrl` is empty
+static unsigned group_empty(const uint8_t *ctrl)
+{
+#ifdef DICT_SSE2
+    // Only DICT_EMPTY has the high bit set, which is what movemask collects
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < DICT_GROUP; i++)
+    {
+        mask |= (unsigned)(ctrl[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+// The entry holding `key`, or DICT_MISSING and, in `*empty`, the slot it
+// would go in. Groups are probed at triangular offsets from the one the
+// hash picks, which visits every group of a power-of-two table.
+static uint32_t find(const LoDict *d, const Value *key, uint32_t hash, uint32_t *empty)
+{
+    uint32_t group_mask = d->capacity / DICT_GROUP - 1;
+    uint32_t group = (hash >> 7) & group_mask;
+    uint8_t h2 = (uint8_t)(hash & 0x7F);
+    for (uint32_t step = 1;; step++)
+    {
+        const uint8_t *ctrl = d->ctrl + (size_t)group * DICT_GROUP;
+        for (unsigned match = group_match(ctrl, h2); match != 0; match &= match - 1)
+        {
+            uint32_t index = d->slots[group * DICT_GROUP + lowest_bit(match)];
+            const DictEntry *e = &d->entries[index];
+            if (e->hash == hash && keys_equal(&e->key, key))
+                return index;
+        }
+        unsigned free_mask = group_empty(ctrl);
+        if (free_mask != 0)
+        {
+            *empty = group * DICT_GROUP + lowest_bit(free_mask);
+            return DICT_MISSING;
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+// The first empty slot on the probe path of `hash`, for keys known to be new
+static uint32_t free_slot(const LoDict *d, uint32_t hash)
+{
+    uint32_t group_mask = d->capacity / DICT_GROUP - 1;
+    uint32_t group = (hash >> 7) & group_mask;
+    for (uint32_t step = 1;; step++)
+    {
+        unsigned free_mask = group_empty(d->ctrl + (size_t)group * DICT_GROUP);
+        if (free_mask != 0)
+            return group * DICT_GROUP + lowest_bit(free_mask);
+        group = (group + step) & group_mask;
+    }
+}
+
+// Control bytes and slots share one block; `capacity` is a multiple of
+// DICT_GROUP, which keeps the slots aligned
+static void table_alloc(LoDict *d, uint32_t capacity)
+{
+    d->capacity = capacity;
+    d->ctrl = (uint8_t *)malloc((size_t)capacity * (1 + sizeof(uint32_t)));
+    d->slots = (uint32_t *)(d->ctrl + capacity);
+    memset(d->ctrl, DICT_EMPTY, capacity);
+}
+
+static void place(LoDict *d, uint32_t slot, uint32_t index, uint32_t hash)
+{
+    d->ctrl[slot] = (uint8_t)(hash & 0x7F);
+    d->slots[slot] = index;
+}
+
+// Doubles the table and places every entry again by its kept hash. The
+// entries array only grows; no entry moves to another index.
+static void grow(LoDict *d)
+{
+    free(d->ctrl);
+    table_alloc(d, d->capacity * 2);
+    for (uint32_t i = 0; i < d->count; i++)
+    {
+        place(d, free_slot(d, d->entries[i].hash), i, d->entries[i].hash);
+    }
+    d->entries = (DictEntry *)realloc(d->entries, DICT_MAX_LOAD((size_t)d->capacity) * sizeof(DictEntry));
+}
+
+// Stores `v` under `key`, whose hash is `hash`, taking ownership of both
+static void insert(LoDict *d, Value key, uint32_t hash, Value v)
+{
+    uint32_t empty;
+    uint32_t at = find(d, &key, hash, &empty);
+    if (at != DICT_MISSING)
+    {
+        Value old = d->entries[at].value;
+        d->entries[at].value = v;
+        value_free(old);
+        value_free(key);
+        return;
+    }
+    if (d->count >= DICT_MAX_LOAD(d->capacity))
+    {
+        grow(d);
+        empty = free_slot(d, hash);
+    }
+    DictEntry *e = &d->entries[d->count];
+    e->key = key;
+    e->value = v;
+    e->hash = hash;
+    place(d, empty, d->count++, hash);
+}
+
+LoDict *dict_new(uint32_t count)
+{
+    uint32_t capacity = DICT_GROUP;
+    while (DICT_MAX_LOAD(capacity) < count)
+    {
+        capacity *= 2;
+    }
+    LoDict *d = (LoDict *)malloc(sizeof(LoDict));
+    d->refcount = 1;
+    d->count = 0;
+    table_alloc(d, capacity);
+    d->entries = (DictEntry *)malloc(DICT_MAX_LOAD(capacity) * sizeof(DictEntry));
+    return d;
+}
+
+void dict_destroy(LoDict *d)
+{
+    for (uint32_t i = 0; i < d->count; i++)
+    {
+        value_free(d->entries[i].key);
+        value_free(d->entries[i].value);
+    }
+    free(d->ctrl);
+    free(d->entries);
+    free(d);
+}
+
+Value dict_from_values(Value *items, uint32_t count)
+{
+    LoDict *d = dict_new(count / 2);
+    for (uint32_t i = 0; i + 1 < count; i += 2)
+    {
+        uint32_t hash;
+        if (key_hash(&items[i], &hash))
+        {
+            insert(d, items[i], hash, items[i + 1]);
+        }
+        else
+        {
+            value_free(items[i]);
+            value_free(items[i + 1]);
+        }
+    }
+    return value_from_dict(d);
+}
+
+Value dict_index(Value target, Value key)
+{
+    uint32_t hash, empty;
+    if (!key_hash(&key, &hash))
+        return value_none();
+    LoDict *d = value_as_dict(target);
+    uint32_t at = find(d, &key, hash, &empty);
+    if (at != DICT_MISSING)
+        return value_copy(d->entries[at].value);
+
+    if (value_is_int(key))
+        err_printf("Runtime Error: Key %lld not in dict\n", (long long)value_as_int(key));
+    else if (value_type(key) == VAL_STRING)
+        err_printf("Runtime Error: Key \"%.*s\" not in dict\n", (int)value_string_length(&key),
+                   value_string_chars(&key));
+    else
+        err_printf("Runtime Error: Key not in dict\n");
+    return value_none();
+}
+
+void dict_store(Value target, Value key, Value v)
+{
+    uint32_t hash;
+    if (key_hash(&key, &hash))
+        insert(value_as_dict(target), value_copy(key), hash, value_copy(v));
+}
+
+Value dict_contains(Value key, Value target)
+{
+    uint32_t hash, empty;
+    if (!value_is_dict(target))
+    {
+        err_printf("Runtime Error: 'in' needs a dict\n");
+        return value_none();
+    }
+    if (!key_hash(&key, &hash))
+        return value_none();
+    return value_bool(find(value_as_dict(target), &key, hash, &empty) != DICT_MISSING);
+}
+
+Value dict_keys(const LoDict *d)
+{
+    Value *keys = (Value *)malloc((d->count > 0 ? d->count : 1) * sizeof(Value));
+    for (uint32_t i = 0; i < d->count; i++)
+    {
+        keys[i] = value_copy(d->entries[i].key);
+    }
+    Value v = array_from_values(keys, d->count);
+    free(keys);
+    return v;
+}
+
+void dict_print(const LoDict *d, int depth)
+{
+    if (depth > VALUE_PRINT_DEPTH)
+    {
+        out_write("{...}", 5);
+        return;
+    }
+    out_write("{", 1);
+    for (uint32_t i = 0; i < d->count; i++)
+    {
+        if (i > 0)
+            out_write(", ", 2);
+        value_print_nested(d->entries[i].key, depth + 1);
+        out_write(": ", 2);
+        value_print_nested(d->entries[i].value, depth + 1);
+    }
+    out_write("}", 1);
+}
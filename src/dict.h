@@ -0,0 +1,35 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include "value.h"
+
+// Dicts (LoDict, value.h). Keys are ints or strings; a probe hashes the
+// key once, then tests a whole group of control bytes per step, with SSE2
+// where available, and only compares keys whose 7 hash bits matched. The
+// table and the entries are two flat arrays that grow by doubling, so
+// inserting never allocates per entry. Iteration follows insertion order.
+
+// Slots probed together, one control byte each
+#define DICT_GROUP 16
+
+// An empty dict with room for `count` entries before it grows, refcount 1.
+LoDict *dict_new(uint32_t count);
+
+// A dict of `count` items, alternating keys and values; a later duplicate
+// key wins. Takes ownership of the items, not of the buffer.
+Value dict_from_values(Value *items, uint32_t count);
+
+// target[key], target[key] = v and `key in target`, reporting run-time
+// errors for a missing key, a key that isn't an int or a string, or (for
+// `in`) a target that isn't a dict. None takes ownership of its operands.
+Value dict_index(Value target, Value key);
+void dict_store(Value target, Value key, Value v);
+Value dict_contains(Value key, Value target);
+
+// The keys, in insertion order, as a new array.
+Value dict_keys(const LoDict *d);
+
+// Prints `{a: 1, b: 2}`; see value_print_nested().
+void dict_print(const LoDict *d, int depth);
+
+#endif
@@ -2,158 +2,591 @@
 #include <string.h>
 #include <stdio.h>
 #include "eval.h"
+#include "array.h"
+#include "bigint.h"
+#include "dict.h"
+#include "builtins.h"
 #include "token.h"
+#include "profile.h"
+#include "output.h"
 
-void env_init(Environment *env)
+void env_init(Environment *env, SymbolTable *symbols)
 {
-    env->head = NULL;
+    env->values = NULL;
+    env->syms = NULL;
+    env->count = 0;
+    env->capacity = 0;
+    env->slot_of = NULL;
+    env->slot_of_capacity = 0;
+    env->symbols = symbols;
+    env->functions = NULL;
+    env->function_count = 0;
+    env->function_capacity = 0;
+    env->function_of = NULL;
+    env->function_of_capacity = 0;
+    env->stack = NULL;
+    env->stack_top = 0;
+    env->stack_capacity = 0;
+    env->frame = 0;
+    env->depth = 0;
+    env->unwinding = UNWIND_NONE;
+    env->tail = NULL;
+    memset(&env->quicken, 0, sizeof(env->quicken));
+    env->jit_threshold = 0;
+    env->profile = NULL;
+    builtins_init(env);
+}
+
+void env_free(Environment *env)
+{
+    for (int i = 0; i < env->capacity; i++)
+    {
+        value_free(env->values[i]);
+    }
+    free(env->values);
+    free(env->syms);
+    free(env->slot_of);
+    for (int i = 0; i < env->function_count; i++)
+    {
+        ast_free(&env->functions[i]->ast);
+        chunk_free(&env->functions[i]->chunk);
+        free(env->functions[i]);
+    }
+    free(env->functions);
+    free(env->function_of);
+    for (int i = 0; i < env->stack_capacity; i++)
+    {
+        value_free(env->stack[i]);
+    }
+    free(env->stack);
+    env_init(env, env->symbols);
+}
+
+int env_lookup(Environment *env, int sym)
+{
+    if (sym < 0 || sym >= env->slot_of_capacity)
+        return -1;
+    return env->slot_of[sym];
+}
+
+void env_reserve(Environment *env, int capacity)
+{
+    if (capacity <= env->capacity)
+        return;
+
+    int new_capacity = env->capacity == 0 ? 16 : env->capacity;
+    while (new_capacity < capacity)
+    {
+        new_capacity *= 2;
+    }
+    env->values = (Value *)realloc(env->values, new_capacity * sizeof(Value));
+    env->syms = (int *)realloc(env->syms, new_capacity * sizeof(int));
+    for (int i = env->capacity; i < new_capacity; i++)
+    {
+        env->values[i] = value_none();
+    }
+    env->capacity = new_capacity;
+}
+
+int env_define(Environment *env, int sym)
+{
+    int slot = env_lookup(env, sym);
+    if (slot >= 0)
+        return slot;
+
+    if (sym >= env->slot_of_capacity)
+    {
+        int new_capacity = env->slot_of_capacity == 0 ? 64 : env->slot_of_capacity;
+        while (new_capacity <= sym)
+        {
+            new_capacity *= 2;
+        }
+        env->slot_of = (int *)realloc(env->slot_of, new_capacity * sizeof(int));
+        for (int i = env->slot_of_capacity; i < new_capacity; i++)
+        {
+            env->slot_of[i] = -1;
+        }
+        env->slot_of_capacity = new_capacity;
+    }
+
+    env_reserve(env, env->count + 1);
+    slot = env->count++;
+    env->syms[slot] = sym;
+    env->values[slot] = value_none();
+    env->slot_of[sym] = slot;
+    return slot;
 }
 
 void env_set(Environment *env, const char *name, Value value)
 {
-    EnvNode *current = env->head;
-    while (current)
+    int slot = env_define(env, symbol_intern(env->symbols, name, strlen(name)));
+    value_free(env->values[slot]);
+    // Shares the string body, if any
+    env->values[slot] = value_copy(value);
+}
+
+Value env_get(Environment *env, const char *name)
+{
+    int slot = env_lookup(env, symbol_find(env->symbols, name, strlen(name)));
+    if (slot >= 0)
+    {
+        return value_copy(env->values[slot]);
+    }
+    return value_none();
+}
+
+int env_new_function(Environment *env, int sym)
+{
+    if (sym >= env->function_of_capacity)
     {
-        if (strcmp(current->name, name) == 0)
+        int new_capacity = env->function_of_capacity == 0 ? 64 : env->function_of_capacity;
+        while (new_capacity <= sym)
         {
-            // Update
-            value_free(current->value);
-            // Deep copy string if needed
-            if (value.type == VAL_STRING && value.string_val)
-            {
-                value.string_val = strdup(value.string_val);
-            }
-            current->value = value;
-            return;
+            new_capacity *= 2;
+        }
+        env->function_of = (int *)realloc(env->function_of, new_capacity * sizeof(int));
+        for (int i = env->function_of_capacity; i < new_capacity; i++)
+        {
+            env->function_of[i] = -1;
         }
-        current = current->next;
+        env->function_of_capacity = new_capacity;
     }
 
-    // New entry
-    EnvNode *node = (EnvNode *)malloc(sizeof(EnvNode));
-    node->name = strdup(name);
-    // Deep copy string if needed
-    if (value.type == VAL_STRING && value.string_val)
+    // Earlier definitions of `sym` stay allocated until env_free(), so
+    // nothing that still points at one is left dangling
+    if (env->function_count >= env->function_capacity)
     {
-        value.string_val = strdup(value.string_val);
+        env->function_capacity = env->function_capacity == 0 ? 8 : env->function_capacity * 2;
+        env->functions = (Function **)realloc(env->functions, env->function_capacity * sizeof(Function *));
     }
-    node->value = value;
-    node->next = env->head;
-    env->head = node;
+    Function *fn = (Function *)calloc(1, sizeof(Function));
+    fn->sym = sym;
+    ast_init(&fn->ast);
+    chunk_init(&fn->chunk);
+    env->functions[env->function_count] = fn;
+    return env->function_count++;
 }
 
-Value env_get(Environment *env, const char *name)
+void env_bind_function(Environment *env, int index)
+{
+    env->function_of[env->functions[index]->sym] = index;
+}
+
+Function *env_function(Environment *env, int sym)
+{
+    if (sym < 0 || sym >= env->function_of_capacity || env->function_of[sym] < 0)
+        return NULL;
+    return env->functions[env->function_of[sym]];
+}
+
+void env_reserve_stack(Environment *env, int top)
 {
-    EnvNode *current = env->head;
-    while (current)
+    if (top <= env->stack_capacity)
+        return;
+
+    int new_capacity = env->stack_capacity == 0 ? 256 : env->stack_capacity;
+    while (new_capacity < top)
+    {
+        new_capacity *= 2;
+    }
+    env->stack = (Value *)realloc(env->stack, new_capacity * sizeof(Value));
+    for (int i = env->stack_capacity; i < new_capacity; i++)
     {
-        if (strcmp(current->name, name) == 0)
+        env->stack[i] = value_none();
+    }
+    env->stack_capacity = new_capacity;
+}
+
+Function *env_call_target(Environment *env, int sym, int count, int tail)
+{
+    Function *fn = env_function(env, sym);
+    if (fn == NULL)
+    {
+        err_printf("Runtime Error: Undefined function '%s'\n", symbol_name(env->symbols, sym));
+        return NULL;
+    }
+    if (count != fn->param_count)
+    {
+        err_printf("Runtime Error: '%s' takes %d argument%s, got %d\n", symbol_name(env->symbols, sym),
+                   fn->param_count, fn->param_count == 1 ? "" : "s", count);
+        return NULL;
+    }
+    if (!tail && env->depth >= CALL_DEPTH_MAX)
+    {
+        err_printf("Runtime Error: Maximum call depth exceeded in '%s'\n", symbol_name(env->symbols, sym));
+        return NULL;
+    }
+    return fn;
+}
+
+// Picks a cached form for an unproven binary op from its first operands
+static void quicken(Environment *env, ASTNode *node, Value left, Value right)
+{
+    // `in` wants a dict on the right; it is an error for any cached form
+    if (node->op == TOKEN_IN)
+    {
+        node->aux = BINARY_POLYMORPHIC;
+        env->quicken.polymorphic++;
+    }
+    else if (value_is_int(left) && value_is_int(right))
+    {
+        node->aux = BINARY_CACHED_INT_INT;
+        env->quicken.quickened++;
+    }
+    else if (value_is_float(left) && value_is_float(right))
+    {
+        node->aux = BINARY_CACHED_FLOAT_FLOAT;
+        env->quicken.quickened++;
+    }
+    else
+    {
+        node->aux = BINARY_POLYMORPHIC;
+        env->quicken.polymorphic++;
+    }
+}
+
+static void deoptimize(Environment *env, ASTNode *node)
+{
+    node->aux = BINARY_POLYMORPHIC;
+    env->quicken.deoptimized++;
+}
+
+static inline int counter_test(int op, int64_t i, int64_t bound)
+{
+    switch (op)
+    {
+    case TOKEN_NEQ: return i != bound;
+    case TOKEN_LT: return i < bound;
+    case TOKEN_GT: return i > bound;
+    case TOKEN_LE: return i <= bound;
+    default: return i >= bound;
+    }
+}
+
+// The variable an identifier, local or assignment names
+static inline Value *variable(Environment *env, const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_LOCAL:
+        return &env->stack[env->frame + node->identifier.slot];
+    case AST_LOCAL_ASSIGNMENT:
+        return &env->stack[env->frame + node->assignment.slot];
+    case AST_ASSIGNMENT:
+        return &env->values[node->assignment.slot];
+    default:
+        return &env->values[node->identifier.slot];
+    }
+}
+
+// Runs a loop the optimizer marked as counted, keeping the test out of
+// eval(). Returns 0 if the counter or bound isn't a small int on entry, or
+// once the counter is about to leave the small range; the generic path
+// then carries on from wherever this stopped. A return from the body
+// leaves its value in `*result`.
+static int eval_counted_loop(AST *ast, ASTNode *node, Environment *env, Value *result)
+{
+    ASTNode *test = ast_node(ast, node->while_loop.condition);
+    ASTNode *counter = ast_node(ast, test->binary.left);
+    ASTNode *bound = ast_node(ast, test->binary.right);
+    Value limit = bound->type == AST_INT ? value_int(ast_int(bound)) : *variable(env, bound);
+    if (!value_is_int(*variable(env, counter)) || !value_is_int(limit))
+        return 0;
+
+    // The body only ever adds int literals to the counter, and the bound is
+    // loop-invariant
+    int64_t n = value_as_int(limit);
+    int op = test->op;
+
+    if (node->aux == LOOP_COUNTED_BARE)
+    {
+        ASTNode *body = ast_node(ast, node->while_loop.body);
+        if (body->type == AST_BLOCK)
+            body = ast_node(ast, ast_block_statement(ast, body, 0));
+        int64_t step = ast_int(ast_node(ast, ast_node(ast, body->assignment.value)->binary.right));
+
+        Value *var = variable(env, counter);
+        int64_t i = value_as_int(*var);
+        int64_t next;
+        while (counter_test(op, i, n) && !int_add_overflow(i, step, &next) && value_fits_int(next))
+            i = next;
+        *var = value_int(i);
+        return !counter_test(op, i, n);
+    }
+
+    // The stack may move during the body, so the counter is found afresh
+    for (;;)
+    {
+        Value *var = variable(env, counter);
+        if (!value_is_int(*var))
+            return 0; // Promoted to a bigint
+        if (!counter_test(op, value_as_int(*var), n))
+            break;
+        Value body_val = eval(ast, node->while_loop.body, env);
+        if (env->unwinding)
+        {
+            *result = body_val;
+            return 1;
+        }
+        value_free(body_val);
+    }
+    return 1;
+}
+
+// Runs `fn` on the frame at `base`, whose parameters are already in place,
+// and pops it. Tail calls from the body replace the frame and loop here,
+// so they take neither C stack nor value stack.
+static Value call_function(Environment *env, Function *fn, int base)
+{
+    int caller_frame = env->frame;
+    env->depth++;
+    Value result;
+    while (1)
+    {
+        env_reserve_stack(env, base + fn->local_count);
+        env->stack_top = base + fn->local_count;
+        env->frame = base;
+        Value v = eval(&fn->ast, fn->body, env);
+        int how = env->unwinding;
+        env->unwinding = UNWIND_NONE;
+
+        if (how == UNWIND_TAIL_CALL)
         {
-            Value v = current->value;
-            if (v.type == VAL_STRING && v.string_val)
+            // Release this frame and slide the new arguments down into it
+            value_free(v);
+            Function *next = env->tail;
+            int args = base + fn->local_count;
+            for (int i = base; i < args; i++)
             {
-                v.string_val = strdup(v.string_val);
+                value_free(env->stack[i]);
+                env->stack[i] = value_none();
             }
-            return v;
+            memmove(&env->stack[base], &env->stack[args], next->param_count * sizeof(Value));
+            for (int i = base + next->param_count; i < args + next->param_count; i++)
+            {
+                env->stack[i] = value_none();
+            }
+            fn = next;
+            continue;
         }
-        current = current->next;
+
+        if (how == UNWIND_RETURN)
+        {
+            result = v;
+        }
+        else
+        {
+            // Fell off the end of the body
+            value_free(v);
+            result = value_none();
+        }
+        break;
+    }
+
+    for (int i = base; i < env->stack_top; i++)
+    {
+        value_free(env->stack[i]);
+        env->stack[i] = value_none();
+    }
+    env->stack_top = base;
+    env->frame = caller_frame;
+    env->depth--;
+    return result;
+}
+
+// Drops the values above `base` off the stack
+static void stack_pop(Environment *env, int base)
+{
+    for (int i = base; i < env->stack_top; i++)
+    {
+        value_free(env->stack[i]);
+        env->stack[i] = value_none();
+    }
+    env->stack_top = base;
+}
+
+static Value eval_call(AST *ast, NodeId id, Environment *env)
+{
+    // Arguments go straight into the slots that become the callee's frame
+    int base = env->stack_top;
+    uint32_t count = ast_node(ast, id)->call.count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Value arg = eval(ast, ast_call_arg(ast, ast_node(ast, id), i), env);
+        env_reserve_stack(env, env->stack_top + 1);
+        env->stack[env->stack_top++] = arg;
+    }
+
+    ASTNode *node = ast_node(ast, id);
+    int builtin = builtin_lookup(env, node->call.sym);
+    if (builtin >= 0)
+    {
+        // Tail or not, the value is ready here for a return to pass up
+        Value v = builtin_call(builtin, &env->stack[base], (int)count);
+        stack_pop(env, base);
+        return v;
+    }
+
+    int tail = node->aux == CALL_TAIL;
+    Function *fn = env_call_target(env, node->call.sym, (int)count, tail);
+    if (fn == NULL)
+    {
+        stack_pop(env, base);
+        return value_none();
+    }
+    if (tail)
+    {
+        // call_function() of the frame being left takes it from here
+        env->tail = fn;
+        env->unwinding = UNWIND_TAIL_CALL;
+        return value_none();
+    }
+    return call_function(env, fn, base);
+}
+
+// An AST_ARRAY or AST_DICT
+static Value eval_array(AST *ast, NodeId id, Environment *env)
+{
+    uint32_t count = ast_node(ast, id)->array.count;
+    Value *items = (Value *)malloc((count > 0 ? count : 1) * sizeof(Value));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        items[i] = eval(ast, ast_array_item(ast, ast_node(ast, id), i), env);
     }
-    Value v;
-    v.type = VAL_NONE;
+    Value v = ast_node(ast, id)->type == AST_DICT ? dict_from_values(items, count) : array_from_values(items, count);
+    free(items);
     return v;
 }
 
-Value eval(ASTNode *node, Environment *env)
+Value eval(AST *ast, NodeId id, Environment *env)
 {
-    Value v = {0};
-    v.type = VAL_NONE;
+    Value v = value_none();
 
-    if (!node)
+    if (id == AST_NONE)
         return v;
 
+    ASTNode *node = ast_node(ast, id);
     switch (node->type)
     {
     case AST_INT:
-        v.type = VAL_INT;
-        v.int_val = node->int_val;
-        return v;
+        return value_int(ast_int(node));
 
     case AST_FLOAT:
-        v.type = VAL_FLOAT;
-        v.float_val = node->float_val;
-        return v;
+        return value_float(ast_float(ast, node));
 
     case AST_STRING:
-        v.type = VAL_STRING;
-        v.string_val = strdup(node->string_val);
-        return v;
+    case AST_BIGINT:
+        return value_copy(ast_string(ast, node));
 
     case AST_IDENTIFIER:
-        return env_get(env, node->string_val);
+        return value_copy(env->values[node->identifier.slot]);
+
+    case AST_LOCAL:
+        return value_copy(env->stack[env->frame + node->identifier.slot]);
 
     case AST_ASSIGNMENT:
+    case AST_LOCAL_ASSIGNMENT:
     {
-        Value val = eval(node->assignment.value, env);
-        env_set(env, node->assignment.name, val);
-        // Return a copy because env_set made a copy, and we return the original 'val'
-        // But wait, if 'val' is string, we return it, and caller frees it.
-        // env_set made its own copy. So this is safe.
+        Value val = eval(ast, node->assignment.value, env);
+        // Looked up after the value: evaluating it may move the stack
+        Value *slot = variable(env, node);
+        value_free(*slot);
+        *slot = value_copy(val);
+        // The slot holds its own copy, so the caller may free 'val'.
         return val;
     }
 
-    case AST_IF:
+    case AST_CALL:
+        return eval_call(ast, id, env);
+
+    case AST_ARRAY:
+    case AST_DICT:
+        return eval_array(ast, id, env);
+
+    case AST_INDEX:
+    {
+        Value target = eval(ast, node->index.target, env);
+        Value index = eval(ast, node->index.index, env);
+        v = value_is_dict(target) ? dict_index(target, index) : array_index(target, index);
+        value_free(target);
+        value_free(index);
+        return v;
+    }
+
+    case AST_INDEX_ASSIGNMENT:
     {
-        Value cond = eval(node->if_stmt.condition, env);
-        int is_true = 0;
-        if (cond.type == VAL_BOOL)
-            is_true = cond.int_val;
-        else if (cond.type == VAL_INT)
-            is_true = (cond.int_val != 0);
-        else if (cond.type == VAL_FLOAT)
-            is_true = (cond.float_val != 0.0);
+        Value target = eval(ast, node->index.target, env);
+        Value index = eval(ast, node->index.index, env);
+        v = eval(ast, node->index.value, env);
+        if (value_is_dict(target))
+            dict_store(target, index, v);
+        else
+            array_store(target, index, v);
+        value_free(target);
+        value_free(index);
+        return v;
+    }
+
+    case AST_RETURN:
+    {
+        v = eval(ast, node->return_stmt.value, env);
+        // A tail call in the value is already on its way out
+        if (env->unwinding == UNWIND_NONE)
+            env->unwinding = UNWIND_RETURN;
+        return v;
+    }
+
+    case AST_DEF:
+        // Made by the resolver; the name only calls it from here on
+        env_bind_function(env, node->def.function);
+        return v;
 
+    case AST_IF:
+    {
+        Value cond = eval(ast, node->if_stmt.condition, env);
+        int is_true = value_is_truthy(cond);
         value_free(cond);
 
         if (is_true)
         {
-            return eval(node->if_stmt.then_branch, env);
+            return eval(ast, node->if_stmt.then_branch, env);
         }
-        else if (node->if_stmt.else_branch)
+        else if (node->if_stmt.else_branch != AST_NONE)
         {
-            return eval(node->if_stmt.else_branch, env);
+            return eval(ast, node->if_stmt.else_branch, env);
         }
-        v.type = VAL_NONE;
+        return v;
+    }
+
+    case AST_WHILE:
+    {
+        if (node->aux != LOOP_GENERIC && eval_counted_loop(ast, node, env, &v))
             return v;
+
+        while (1)
+        {
+            Value cond = eval(ast, node->while_loop.condition, env);
+            int is_true = value_is_truthy(cond);
+            value_free(cond);
+
+            if (!is_true)
+                break;
+
+            Value body_val = eval(ast, node->while_loop.body, env);
+            if (env->unwinding)
+                return body_val;
+            value_free(body_val);
         }
-        
-        case AST_WHILE: {
-            Value v_ret;
-            v_ret.type = VAL_NONE;
-            
-            while (1) {
-                Value cond = eval(node->while_loop.condition, env);
-                int is_true = 0;
-                if (cond.type == VAL_BOOL) is_true = cond.int_val;
-                else if (cond.type == VAL_INT) is_true = (cond.int_val != 0);
-                else if (cond.type == VAL_FLOAT) is_true = (cond.float_val != 0.0);
-                
-                value_free(cond);
-                
-                if (!is_true) break;
-                
-                Value body_val = eval(node->while_loop.body, env);
-                value_free(body_val);
-            }
-            
-            return v_ret;
-        }
-        
-        case AST_PRINT: {
-        Value val = eval(node->print_stmt.expr, env);
+
+        return v;
+    }
+
+    case AST_PRINT:
+    {
+        Value val = eval(ast, node->print_stmt.expr, env);
         value_print(val);
-        printf("\n");
+        out_write("\n", 1);
         value_free(val);
-        v.type = VAL_NONE;
         return v;
     }
 
@@ -163,131 +596,92 @@ Value eval(ASTNode *node, Environment *env)
         // Usually statements return None, but expressions return values.
         // For REPL, we might want to print the last value if it's an expression.
         // But here AST_BLOCK is a sequence.
-        for (int i = 0; i < node->block.count; i++)
+        for (uint32_t i = 0; i < node->block.count; i++)
         {
-            Value res = eval(node->block.statements[i], env);
-            // In a real language, return statement would break here.
+            Value res = eval(ast, ast_block_statement(ast, node, i), env);
+            // A return passes its value up through every enclosing block
+            if (env->unwinding)
+                return res;
             value_free(res);
         }
-        v.type = VAL_NONE;
         return v;
     }
 
-    case AST_BINARY_OP:
+    case AST_PROFILE:
     {
-        Value left = eval(node->binary.left, env);
-        Value right = eval(node->binary.right, env);
+        profile_enter(env->profile, node->profile.line);
+        v = eval(ast, node->profile.stmt, env);
+        profile_exit(env->profile);
+        return v;
+    }
 
-        // Handle numeric ops
-        if (left.type == VAL_INT && right.type == VAL_INT)
+    case AST_BINARY_OP:
+    {
+        // Operand types proven by infer_types() skip the dispatch in
+        // value_binary_op(). Floats are plain numbers, nothing to free; a
+        // proven int may be a bigint, which the int paths check for.
+        switch (node->aux)
         {
-            switch (node->binary.op)
-            {
-            case TOKEN_PLUS:
-                v.type = VAL_INT;
-                v.int_val = left.int_val + right.int_val;
-                break;
-            case TOKEN_MINUS:
-                v.type = VAL_INT;
-                v.int_val = left.int_val - right.int_val;
-                break;
-            case TOKEN_MUL:
-                v.type = VAL_INT;
-                v.int_val = left.int_val * right.int_val;
-                break;
-            case TOKEN_DIV:
-                v.type = VAL_INT;
-                if (right.int_val != 0)
-                    v.int_val = left.int_val / right.int_val;
-                else
-                    printf("Runtime Error: Division by zero\n");
-                break;
-            case TOKEN_EQ:
-                v.type = VAL_BOOL;
-                v.int_val = (left.int_val == right.int_val);
-                break;
-            case TOKEN_NEQ:
-                v.type = VAL_BOOL;
-                v.int_val = (left.int_val != right.int_val);
-                break;
-            case TOKEN_LT:
-                v.type = VAL_BOOL;
-                v.int_val = (left.int_val < right.int_val);
-                break;
-            case TOKEN_GT:
-                v.type = VAL_BOOL;
-                v.int_val = (left.int_val > right.int_val);
-                break;
-            case TOKEN_LE:
-                v.type = VAL_BOOL;
-                v.int_val = (left.int_val <= right.int_val);
-                break;
-            case TOKEN_GE:
-                v.type = VAL_BOOL;
-                v.int_val = (left.int_val >= right.int_val);
-                break;
-            default:
-                v.type = VAL_NONE;
-                break;
-            }
+        case BINARY_INT_INT:
+        {
+            Value left = eval(ast, node->binary.left, env);
+            Value right = eval(ast, node->binary.right, env);
+            int64_t x, y;
+            if (value_get_ints(&left, &right, &x, &y))
+                return value_int_op(node->op, x, y);
+            v = bigint_binary_op(node->op, left, right);
+            value_free(left);
+            value_free(right);
+            return v;
+        }
+        case BINARY_FLOAT_FLOAT:
+        {
+            double l = value_as_float(eval(ast, node->binary.left, env));
+            double r = value_as_float(eval(ast, node->binary.right, env));
+            return value_float_op(node->op, l, r);
+        }
+        case BINARY_INT_FLOAT:
+        {
+            Value left = eval(ast, node->binary.left, env);
+            double r = value_as_float(eval(ast, node->binary.right, env));
+            v = value_float_op(node->op, value_as_number(left), r);
+            value_free(left);
+            return v;
         }
-        else if ((left.type == VAL_INT || left.type == VAL_FLOAT) &&
-                 (right.type == VAL_INT || right.type == VAL_FLOAT))
+        case BINARY_FLOAT_INT:
         {
-            double l = (left.type == VAL_INT) ? (double)left.int_val : left.float_val;
-            double r = (right.type == VAL_INT) ? (double)right.int_val : right.float_val;
+            double l = value_as_float(eval(ast, node->binary.left, env));
+            Value right = eval(ast, node->binary.right, env);
+            v = value_float_op(node->op, l, value_as_number(right));
+            value_free(right);
+            return v;
+        }
+        }
 
-            switch (node->binary.op)
-            {
-            case TOKEN_PLUS:
-                v.type = VAL_FLOAT;
-                v.float_val = l + r;
-                break;
-            case TOKEN_MINUS:
-                v.type = VAL_FLOAT;
-                v.float_val = l - r;
-                break;
-            case TOKEN_MUL:
-                v.type = VAL_FLOAT;
-                v.float_val = l * r;
-                break;
-            case TOKEN_DIV:
-                v.type = VAL_FLOAT;
-                if (r != 0)
-                    v.float_val = l / r;
-                else
-                    printf("Runtime Error: Division by zero\n");
-                break;
-            case TOKEN_EQ:
-                v.type = VAL_BOOL;
-                v.int_val = (l == r);
-                break;
-            case TOKEN_NEQ:
-                v.type = VAL_BOOL;
-                v.int_val = (l != r);
-                break;
-            case TOKEN_LT:
-                v.type = VAL_BOOL;
-                v.int_val = (l < r);
-                break;
-            case TOKEN_GT:
-                v.type = VAL_BOOL;
-                v.int_val = (l > r);
-                break;
-            case TOKEN_LE:
-                v.type = VAL_BOOL;
-                v.int_val = (l <= r);
-                break;
-            case TOKEN_GE:
-                v.type = VAL_BOOL;
-                v.int_val = (l >= r);
-                break;
-            default:
-                v.type = VAL_NONE;
-                break;
-            }
+        Value left = eval(ast, node->binary.left, env);
+        Value right = eval(ast, node->binary.right, env);
+
+        // Guarded fast paths for nodes quickened on an earlier run
+        int64_t x, y;
+        switch (node->aux)
+        {
+        case BINARY_CACHED_INT_INT:
+            if (value_get_ints(&left, &right, &x, &y))
+                return value_int_op(node->op, x, y);
+            deoptimize(env, node);
+            break;
+        case BINARY_CACHED_FLOAT_FLOAT:
+            if (value_is_float(left) && value_is_float(right))
+                return value_float_op(node->op, value_as_float(left), value_as_float(right));
+            deoptimize(env, node);
+            break;
+        case BINARY_GENERIC:
+            quicken(env, node, left, right);
+            break;
         }
 
+        v = value_binary_op(node->op, left, right);
+
         value_free(left);
         value_free(right);
         return v;
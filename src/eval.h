@@ -3,22 +3,122 @@
 
 #include "ast.h"
 #include "value.h"
+#include "symbol.h"
+#include "bytecode.h"
 
-// Simple environment
-typedef struct EnvNode {
-    char *name;
-    Value value;
-    struct EnvNode *next;
-} EnvNode;
+// How eval() has quickened binary-op sites whose types weren't proven
+// statically. Counts sites, not executions.
+typedef struct {
+    long quickened;   // Rewritten to a cached int/int or float/float form
+    long deoptimized; // Quickened, then saw other types and went generic
+    long polymorphic; // First run wasn't int/int or float/float; left generic
+} QuickenStats;
+
+// Non-tail calls nested deeper than this report an error instead of
+// running the C stack out; tail calls don't count.
+#define CALL_DEPTH_MAX 1000
+
+// A function defined with `def`. The resolver copies its body out of the
+// tree that defined it, so it outlives that tree (a REPL line, a program).
+// Its frame holds the parameters, then every other name the body assigns.
+typedef struct
+{
+    int sym;
+    int param_count;
+    int local_count; // Parameters included
+    AST ast;
+    NodeId body;
+    Chunk chunk;  // Compiled by the VM on the first call
+    int compiled; // 1 once `chunk` is ready, -1 if it failed to compile
+} Function;
 
+// Functions every program can call without defining them (builtins.c).
+// A def of the same name takes precedence.
+enum
+{
+    BUILTIN_LEN,
+    BUILTIN_ARRAY,
+    BUILTIN_APPEND,
+    BUILTIN_SUM,
+    BUILTIN_MIN,
+    BUILTIN_MAX,
+    BUILTIN_DOT,
+    // Hidden: named with a `$`, so programs can neither call nor shadow
+    // them; `for x in seq` is lowered to calls of these
+    BUILTIN_LOOP_ITEMS,
+    BUILTIN_LOOP_LEN,
+    BUILTIN_COUNT
+};
+
+// How eval() is leaving the statements of a function body
+enum
+{
+    UNWIND_NONE,
+    UNWIND_RETURN,   // A return ran; its value is being passed up
+    UNWIND_TAIL_CALL // `return f(...)`: the arguments sit above the frame
+};
+
+// Variables live in a dense array indexed by the slot the resolver assigned
+// to their symbol. The symbol map is only consulted at resolve time and by
+// the by-name accessors, never on the evaluation path.
+//
+// Every engine receives the environment, so it also carries the rest of
+// one interpreter's run-time state; there is none at file scope.
 typedef struct {
-    EnvNode *head;
+    Value *values;   // slot -> value
+    int *syms;       // slot -> symbol
+    int count;
+    int capacity;
+
+    int *slot_of;    // symbol -> slot, -1 when unbound
+    int slot_of_capacity;
+
+    SymbolTable *symbols;
+
+    Function **functions;    // Definitions, in order
+    int function_count;
+    int function_capacity;
+    int *function_of;        // symbol -> index into functions, -1 when undefined
+    int function_of_capacity;
+    int builtins[BUILTIN_COUNT]; // BUILTIN_* -> symbol
+
+    // One contiguous stack of frames for both engines. A call's arguments
+    // are evaluated straight into the slots that become its frame, and
+    // the stack only grows when a call goes deeper than ever before.
+    Value *stack;
+    int stack_top;      // First free slot
+    int stack_capacity;
+    int frame;          // Base of the innermost eval() frame
+    int depth;          // Non-tail calls in progress
+    int unwinding;      // UNWIND_*, for eval()
+    Function *tail;     // Callee of a pending UNWIND_TAIL_CALL
+
+    QuickenStats quicken;
+    int jit_threshold;       // Back-edges before the VM compiles a loop; 0 leaves the JIT off
+    struct Profile *profile; // Receives AST_PROFILE events; NULL unless profiling
 } Environment;
 
-void env_init(Environment *env);
+void env_init(Environment *env, SymbolTable *symbols);
+void env_free(Environment *env);
+int env_lookup(Environment *env, int sym);  // Slot of symbol or -1
+int env_define(Environment *env, int sym);  // Slot of symbol, created as None if missing
+void env_reserve(Environment *env, int capacity);     // Grow storage, new cells are None
 void env_set(Environment *env, const char *name, Value value);
 Value env_get(Environment *env, const char *name); 
 
-Value eval(ASTNode *node, Environment *env);
+// Makes a new, empty function for `sym` and returns its index in
+// `functions`. The name refers to it only once env_bind_function() runs,
+// which is when its def statement does.
+int env_new_function(Environment *env, int sym);
+// Makes function `index` the one its name calls, replacing any earlier one
+void env_bind_function(Environment *env, int index);
+Function *env_function(Environment *env, int sym); // NULL if undefined
+// Makes room for slots [0, top) of the stack; new slots are None.
+void env_reserve_stack(Environment *env, int top);
+// The function a call to `sym` with `count` arguments runs, or NULL after
+// reporting why it can't. Non-tail calls also count against the depth.
+Function *env_call_target(Environment *env, int sym, int count, int tail);
+
+Value eval(AST *ast, NodeId id, Environment *env);
 
 #endif
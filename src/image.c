@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "image.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define make_dir(path) _mkdir(path)
+#define process_id() _getpid()
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0777)
+#define process_id() getpid()
+#endif
+
+// Layout of an image file. Everything is in host byte order and Value
+// encoding; `value_size` tells the tagged-union and NaN-boxed builds apart.
+//
+//   header
+//   code       Instr[code_count], used in place
+//   constants  Value[const_count]; heap strings hold the file offset of
+//              their body until image_load() rebases them
+//   strings    immortal LoString bodies
+//   names      global_count NUL-terminated names, in slot order
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t value_size;
+    uint64_t source_hash;
+    uint64_t source_length;
+    uint32_t code_count;
+    uint32_t const_count;
+    uint32_t global_count;
+    uint32_t reg_count;
+    uint64_t code_offset;
+    uint64_t const_offset;
+    uint64_t names_offset;
+    uint64_t file_size;
+} ImageHeader;
+
+static const char image_magic[8] = "LOFYC\r\n";
+
+static uint64_t source_hash(const Source *source)
+{
+    // FNV-1a, 64-bit
+    uint64_t h = 14695981039346656037ull;
+    for (int i = 0; i < source->length; i++)
+    {
+        h ^= (unsigned char)source->data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+int image_path(char *path, size_t size, const char *dir, const Source *source)
+{
+    // Builds with a different format or Value encoding get their own files
+    uint64_t key = source_hash(source) ^ ((uint64_t)IMAGE_VERSION << 56) ^ (uint64_t)sizeof(Value);
+    int n = snprintf(path, size, "%s/%016llx.lofyc", dir, (unsigned long long)key);
+    return n < 0 || (size_t)n >= size ? -1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Loading
+
+#ifdef _WIN32
+
+static int map_file(Image *image, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    image->base = (char *)malloc((size_t)size);
+    image->size = (size_t)size;
+    image->mapped = 0;
+    size_t read = fread(image->base, 1, image->size, file);
+    fclose(file);
+    if (read != image->size)
+    {
+        image_close(image);
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+static int map_file(Image *image, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        close(fd);
+        return -1;
+    }
+    // Private and writable: rebasing string constants touches only the
+    // pages holding them, and never the file
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+    image->base = (char *)base;
+    image->size = (size_t)st.st_size;
+    image->mapped = 1;
+    return 0;
+}
+
+#endif
+
+void image_close(Image *image)
+{
+#ifndef _WIN32
+    if (image->mapped)
+        munmap(image->base, image->size);
+    else
+#endif
+        free(image->base);
+    image->base = NULL;
+    image->size = 0;
+    image->mapped = 0;
+}
+
+static int section_fits(const Image *image, uint64_t offset, uint64_t count, size_t item, size_t align)
+{
+    return offset % align == 0 && offset <= image->size && count <= (image->size - offset) / item;
+}
+
+// Points heap string constants, stored as file offsets, at their bodies
+static int rebase_strings(Image *image, Value *constants, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (value_is_bigint(constants[i]))
+            return -1;
+        if (!value_is_heap_string(constants[i]))
+            continue;
+        uint64_t offset = (uint64_t)(uintptr_t)value_as_lostring(constants[i]);
+        if (!section_fits(image, offset, 1, sizeof(LoString), 4))
+            return -1;
+        LoString *s = (LoString *)(image->base + offset);
+        if (s->refcount != LOSTRING_IMMORTAL || s->view ||
+            s->length >= image->size - offset - sizeof(LoString))
+            return -1;
+        constants[i] = value_from_lostring(s);
+    }
+    return 0;
+}
+
+int image_load(Image *image, const char *path, const Source *source, Chunk *chunk, Environment *env)
+{
+    if (env->count != 0 || map_file(image, path) != 0)
+        return -1;
+
+    const ImageHeader *h = (const ImageHeader *)image->base;
+    if (image->size < sizeof(ImageHeader) || memcmp(h->magic, image_magic, sizeof(image_magic)) != 0 ||
+        h->version != IMAGE_VERSION || h->value_size != sizeof(Value) ||
+        h->source_length != (uint64_t)source->length || h->source_hash != source_hash(source) ||
+        h->file_size != image->size || h->global_count > h->reg_count ||
+        !section_fits(image, h->code_offset, h->code_count, sizeof(Instr), 8) ||
+        !section_fits(image, h->const_offset, h->const_count, sizeof(Value), 8) ||
+        !section_fits(image, h->names_offset, 0, 1, 1))
+    {
+        image_close(image);
+        return -1;
+    }
+
+    Value *constants = (Value *)(image->base + h->const_offset);
+    if (rebase_strings(image, constants, (int)h->const_count) != 0)
+    {
+        image_close(image);
+        return -1;
+    }
+
+    // Globals are defined in slot order, so they land where the code
+    // expects them
+    const char *name = image->base + h->names_offset;
+    const char *end = image->base + image->size;
+    for (uint32_t i = 0; i < h->global_count; i++)
+    {
+        const char *nul = memchr(name, '\0', (size_t)(end - name));
+        if (nul == NULL)
+        {
+            image_close(image);
+            return -1;
+        }
+        int sym = symbol_intern(env->symbols, name, (int)(nul - name));
+        env_define(env, sym);
+        name = nul + 1;
+    }
+
+    chunk_init(chunk);
+    chunk->code = (Instr *)(image->base + h->code_offset);
+    chunk->count = chunk->capacity = (int)h->code_count;
+    chunk->constants = constants;
+    chunk->const_count = chunk->const_capacity = (int)h->const_count;
+    chunk->global_count = (int)h->global_count;
+    chunk->reg_count = (int)h->reg_count;
+    chunk->borrowed = 1;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Saving
+
+typedef struct {
+    char *data;
+    size_t count;
+    size_t capacity;
+} ImageBuffer;
+
+static size_t buffer_append(ImageBuffer *buffer, const void *bytes, size_t n)
+{
+    if (buffer->count + n > buffer->capacity)
+    {
+        while (buffer->count + n > buffer->capacity)
+            buffer->capacity = buffer->capacity == 0 ? 4096 : buffer->capacity * 2;
+        buffer->data = (char *)realloc(buffer->data, buffer->capacity);
+    }
+    size_t at = buffer->count;
+    if (bytes != NULL)
+        memcpy(buffer->data + at, bytes, n);
+    else
+        memset(buffer->data + at, 0, n);
+    buffer->count += n;
+    return at;
+}
+
+static size_t buffer_align(ImageBuffer *buffer, size_t align)
+{
+    size_t pad = (align - buffer->count % align) % align;
+    buffer_append(buffer, NULL, pad);
+    return buffer->count;
+}
+
+// Creates `dir` and any missing parents
+static void make_dirs(const char *dir)
+{
+    char path[4096];
+    size_t length = strlen(dir);
+    if (length >= sizeof(path))
+        return;
+    memcpy(path, dir, length + 1);
+    for (size_t i = 1; i <= length; i++)
+    {
+        if (path[i] == '/' || path[i] == '\0')
+        {
+            char saved = path[i];
+            path[i] = '\0';
+            make_dir(path);
+            path[i] = saved;
+        }
+    }
+}
+
+void image_save(const char *path, const Source *source, const Chunk *chunk, const Environment *env)
+{
+    // Bigint constants aren't written out; such programs just go uncached
+    for (int i = 0; i < chunk->const_count; i++)
+    {
+        if (value_is_bigint(chunk->constants[i]))
+            return;
+    }
+
+    ImageBuffer buffer = {NULL, 0, 0};
+    ImageHeader h;
+    memset(&h, 0, sizeof(h));
+    buffer_append(&buffer, NULL, sizeof(h));
+
+    h.code_offset = buffer_align(&buffer, 16);
+    buffer_append(&buffer, chunk->code, chunk->count * sizeof(Instr));
+    h.const_offset = buffer_align(&buffer, 16);
+    buffer_append(&buffer, chunk->constants, chunk->const_count * sizeof(Value));
+
+    for (int i = 0; i < chunk->const_count; i++)
+    {
+        Value k = chunk->constants[i];
+        if (!value_is_heap_string(k))
+            continue;
+        LoString *s = value_as_lostring(k);
+        LoString body = *s;
+        body.refcount = LOSTRING_IMMORTAL;
+        size_t at = buffer_align(&buffer, 8);
+        buffer_append(&buffer, &body, sizeof(body));
+        buffer_append(&buffer, s->data, s->length + 1);
+
+        Value stored = value_from_lostring((LoString *)(uintptr_t)at);
+        memcpy(buffer.data + h.const_offset + i * sizeof(Value), &stored, sizeof(Value));
+    }
+
+    h.names_offset = buffer.count;
+    for (int i = 0; i < chunk->global_count; i++)
+    {
+        const char *name = symbol_name(env->symbols, env->syms[i]);
+        buffer_append(&buffer, name, strlen(name) + 1);
+    }
+
+    memcpy(h.magic, image_magic, sizeof(image_magic));
+    h.version = IMAGE_VERSION;
+    h.value_size = sizeof(Value);
+    h.source_hash = source_hash(source);
+    h.source_length = (uint64_t)source->length;
+    h.code_count = (uint32_t)chunk->count;
+    h.const_count = (uint32_t)chunk->const_count;
+    h.global_count = (uint32_t)chunk->global_count;
+    h.reg_count = (uint32_t)chunk->reg_count;
+    h.file_size = buffer.count;
+    memcpy(buffer.data, &h, sizeof(h));
+
+    // Written under a private name and renamed into place, so concurrent
+    // runs never see a partial image
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    if (slash != NULL && (size_t)(slash - path) < sizeof(dir))
+    {
+        memcpy(dir, path, slash - path);
+        dir[slash - path] = '\0';
+        make_dirs(dir);
+    }
+    char temp[4096 + 32];
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)process_id());
+    FILE *file = fopen(temp, "wb");
+    if (file != NULL)
+    {
+        int ok = fwrite(buffer.data, 1, buffer.count, file) == buffer.count;
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(temp, path) != 0)
+            remove(temp);
+    }
+    free(buffer.data);
+}
@@ -0,0 +1,42 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include "bytecode.h"
+#include "eval.h"
+#include "source.h"
+
+// Compiled program images (.lofyc). A script's bytecode, constants and
+// global names are written to a cache directory under a hash of its source
+// text; on the next run with the same source the image is mapped and the
+// chunk points straight into it, skipping lexing, parsing, optimization
+// and compilation. Images record the format version and Value encoding
+// they were built with and are ignored if either doesn't match.
+
+#define IMAGE_VERSION 5
+
+typedef struct {
+    char *base;
+    size_t size;
+    int mapped; // 1 when `base` is a private file mapping, 0 when malloc'd
+} Image;
+
+// Writes the cache file name for `source` into `path`; returns -1 if it
+// doesn't fit.
+int image_path(char *path, size_t size, const char *dir, const Source *source);
+
+// Loads the image at `path` if it was built from `source`, filling `chunk`
+// (which borrows the image's memory) and defining its globals in the empty
+// environment `env`. Returns 0 on success, -1 if there is no usable image.
+int image_load(Image *image, const char *path, const Source *source, Chunk *chunk, Environment *env);
+
+// Saves `chunk`, compiled from `source` against `env`, to `path`, creating
+// the directory if needed. Failures are silent; the cache is best effort.
+void image_save(const char *path, const Source *source, const Chunk *chunk, const Environment *env);
+
+// Unmaps an image. Its string constants are immortal and shared, not
+// copied, so this must wait until nothing refers to them: the chunk and
+// every environment that ran it have to be freed first.
+void image_close(Image *image);
+
+#endif
@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <string.h>
+#include "infer.h"
+#include "token.h"
+
+unsigned types_of_binary(int op, unsigned left, unsigned right)
+{
+    int compare = op == TOKEN_EQ || op == TOKEN_NEQ || op == TOKEN_LT ||
+                  op == TOKEN_GT || op == TOKEN_LE || op == TOKEN_GE;
+    unsigned types = 0;
+
+    // Membership, or an error for anything but a dict with an int or string key
+    if (op == TOKEN_IN)
+        return TYPES_BOOL | TYPES_NONE;
+    if ((left & ~TYPES_NUMBER) || (right & ~TYPES_NUMBER))
+        types |= TYPES_NONE;
+    if ((left & TYPES_INT) && (right & TYPES_INT))
+        types |= compare ? TYPES_BOOL : TYPES_INT;
+    if (((left & TYPES_FLOAT) && (right & TYPES_NUMBER)) ||
+        ((left & TYPES_NUMBER) && (right & TYPES_FLOAT)))
+        types |= compare ? TYPES_BOOL : TYPES_FLOAT;
+    // Strings concatenate and compare with strings, and repeat by an int
+    if ((left & TYPES_STRING) && (right & TYPES_STRING) && (compare || op == TOKEN_PLUS))
+        types |= compare ? TYPES_BOOL : TYPES_STRING;
+    if (op == TOKEN_MUL && (((left & TYPES_STRING) && (right & TYPES_INT)) ||
+                            ((left & TYPES_INT) && (right & TYPES_STRING))))
+        types |= TYPES_STRING;
+    // Arithmetic on an array maps over it (or fails on a length mismatch)
+    if (((left | right) & TYPES_ARRAY) && !compare)
+        types |= TYPES_ARRAY;
+    return types;
+}
+
+// One bit set of types per environment slot
+typedef unsigned char TypeState;
+
+// At the top level the state covers the globals. In a function body it
+// covers the frame, and globals may hold anything by the time it runs.
+typedef struct
+{
+    AST *ast;
+    Environment *env;
+    int slot_count;
+    int in_function;
+} Inferrer;
+
+static void infer_function(Environment *env, Function *fn);
+
+static BinaryForm binary_form(unsigned left, unsigned right)
+{
+    if (left == TYPES_INT && right == TYPES_INT)
+        return BINARY_INT_INT;
+    if (left == TYPES_FLOAT && right == TYPES_FLOAT)
+        return BINARY_FLOAT_FLOAT;
+    if (left == TYPES_INT && right == TYPES_FLOAT)
+        return BINARY_INT_FLOAT;
+    if (left == TYPES_FLOAT && right == TYPES_INT)
+        return BINARY_FLOAT_INT;
+    return BINARY_GENERIC;
+}
+
+// Widens `into` by `from`; returns 1 if anything changed
+static int join(Inferrer *inf, TypeState *into, const TypeState *from)
+{
+    int changed = 0;
+    for (int i = 0; i < inf->slot_count; i++)
+    {
+        TypeState joined = into[i] | from[i];
+        changed |= joined != into[i];
+        into[i] = joined;
+    }
+    return changed;
+}
+
+static TypeState *copy_state(Inferrer *inf, const TypeState *state)
+{
+    TypeState *copy = (TypeState *)malloc(inf->slot_count > 0 ? inf->slot_count : 1);
+    memcpy(copy, state, inf->slot_count);
+    return copy;
+}
+
+// Walks `id` in execution order, updating `state` to what holds after it.
+// Returns the types the node itself may evaluate to.
+static unsigned infer(Inferrer *inf, NodeId id, TypeState *state)
+{
+    if (id == AST_NONE)
+        return TYPES_NONE;
+
+    AST *ast = inf->ast;
+    ASTNode *node = ast_node(ast, id);
+    switch (node->type)
+    {
+    case AST_INT:
+    case AST_BIGINT:
+        return TYPES_INT;
+    case AST_FLOAT:
+        return TYPES_FLOAT;
+    case AST_STRING:
+        return TYPES_STRING;
+    case AST_IDENTIFIER:
+        return inf->in_function ? TYPES_ANY : state[node->identifier.slot];
+    case AST_LOCAL:
+        return state[node->identifier.slot];
+
+    case AST_BINARY_OP:
+    {
+        unsigned left = infer(inf, node->binary.left, state);
+        unsigned right = infer(inf, node->binary.right, state);
+        node->aux = (uint16_t)(node->op == TOKEN_IN ? BINARY_GENERIC : binary_form(left, right));
+        return types_of_binary(node->op, left, right);
+    }
+
+    case AST_ASSIGNMENT:
+    case AST_LOCAL_ASSIGNMENT:
+    {
+        unsigned types = infer(inf, node->assignment.value, state);
+        state[node->assignment.slot] = (TypeState)types;
+        return types;
+    }
+
+    case AST_IF:
+    {
+        infer(inf, node->if_stmt.condition, state);
+        TypeState *other = copy_state(inf, state);
+        unsigned types = infer(inf, node->if_stmt.then_branch, state);
+        if (node->if_stmt.else_branch != AST_NONE)
+            types |= infer(inf, node->if_stmt.else_branch, other);
+        else
+            types |= TYPES_NONE;
+        join(inf, state, other);
+        free(other);
+        return types;
+    }
+
+    case AST_WHILE:
+    {
+        // Iterate to a fixed point at the loop head. States only widen, so
+        // this terminates, and the last pass leaves every node in the loop
+        // annotated for the final (widest) state.
+        TypeState *work = copy_state(inf, state);
+        do
+        {
+            memcpy(work, state, inf->slot_count);
+            infer(inf, node->while_loop.condition, work);
+            infer(inf, node->while_loop.body, work);
+        } while (join(inf, state, work));
+        free(work);
+
+        // The loop exits right after a failed test
+        infer(inf, node->while_loop.condition, state);
+        return TYPES_NONE;
+    }
+
+    case AST_PRINT:
+        infer(inf, node->print_stmt.expr, state);
+        return TYPES_NONE;
+
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            infer(inf, ast_block_statement(ast, node, i), state);
+        }
+        return TYPES_NONE;
+
+    // Functions can't assign globals, so a call leaves the state alone
+    case AST_CALL:
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            infer(inf, ast_call_arg(ast, node, i), state);
+        }
+        return TYPES_ANY;
+
+    case AST_RETURN:
+        infer(inf, node->return_stmt.value, state);
+        return TYPES_NONE;
+
+    case AST_ARRAY:
+    case AST_DICT:
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            infer(inf, ast_array_item(ast, node, i), state);
+        }
+        return node->type == AST_ARRAY ? TYPES_ARRAY : TYPES_DICT;
+
+    // Elements may be anything; storing one changes no slot's type
+    case AST_INDEX:
+        infer(inf, node->index.target, state);
+        infer(inf, node->index.index, state);
+        return TYPES_ANY;
+
+    case AST_INDEX_ASSIGNMENT:
+        infer(inf, node->index.target, state);
+        infer(inf, node->index.index, state);
+        return infer(inf, node->index.value, state);
+
+    case AST_DEF:
+    {
+        infer_function(inf->env, inf->env->functions[node->def.function]);
+        return TYPES_NONE;
+    }
+
+    default:
+        break;
+    }
+    return TYPES_ANY;
+}
+
+// Parameters may arrive as anything; the other locals start out None
+static void infer_function(Environment *env, Function *fn)
+{
+    Inferrer inf;
+    inf.ast = &fn->ast;
+    inf.env = env;
+    inf.slot_count = fn->local_count;
+    inf.in_function = 1;
+
+    TypeState *state = (TypeState *)malloc(fn->local_count > 0 ? fn->local_count : 1);
+    for (int slot = 0; slot < fn->local_count; slot++)
+    {
+        state[slot] = (TypeState)(slot < fn->param_count ? TYPES_ANY : TYPES_NONE);
+    }
+    infer(&inf, fn->body, state);
+    free(state);
+}
+
+void infer_types(AST *ast, NodeId id, Environment *env)
+{
+    Inferrer inf;
+    inf.ast = ast;
+    inf.env = env;
+    inf.slot_count = env->count;
+    inf.in_function = 0;
+
+    // The tree runs right after this, against exactly these values
+    TypeState *state = (TypeState *)malloc(env->count > 0 ? env->count : 1);
+    for (int slot = 0; slot < env->count; slot++)
+    {
+        state[slot] = (TypeState)types_of_value(env->values[slot]);
+    }
+    infer(&inf, id, state);
+    free(state);
+}
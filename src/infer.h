@@ -0,0 +1,37 @@
+#ifndef INFER_H
+#define INFER_H
+
+#include "ast.h"
+#include "eval.h"
+
+// Sets of the run-time types an expression may produce, one bit per
+// ValueType. Shared by the static passes over the AST. Small ints and
+// bigints go together: any int arithmetic may promote.
+#define TYPES_OF(t) (1u << (t))
+enum
+{
+    TYPES_NONE = TYPES_OF(VAL_NONE),
+    TYPES_INT = TYPES_OF(VAL_INT) | TYPES_OF(VAL_BIGINT),
+    TYPES_FLOAT = TYPES_OF(VAL_FLOAT),
+    TYPES_BOOL = TYPES_OF(VAL_BOOL),
+    TYPES_STRING = TYPES_OF(VAL_STRING),
+    TYPES_ARRAY = TYPES_OF(VAL_ARRAY),
+    TYPES_DICT = TYPES_OF(VAL_DICT),
+    TYPES_NUMBER = TYPES_INT | TYPES_FLOAT,
+    TYPES_ANY = TYPES_NONE | TYPES_NUMBER | TYPES_BOOL | TYPES_STRING | TYPES_ARRAY | TYPES_DICT
+};
+
+static inline unsigned types_of_value(Value v)
+{
+    return value_is_integer(v) ? TYPES_INT : TYPES_OF(value_type(v));
+}
+
+// The types value_binary_op() can return for operands drawn from these sets.
+unsigned types_of_binary(int op, unsigned left, unsigned right);
+
+// Flow-sensitive type inference over a resolved tree. Tracks the types each
+// slot may hold at every point, starting from the values in `env`, and
+// records the proven operand types of every binary op in its `aux` field.
+void infer_types(AST *ast, NodeId id, Environment *env);
+
+#endif
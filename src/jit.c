@@ -0,0 +1,732 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(LOFY_NAN_BOXING)
+#define JIT_AVAILABLE
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+int jit_available(void)
+{
+#ifdef JIT_AVAILABLE
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifndef JIT_AVAILABLE
+
+int jit_backedge(Chunk *chunk, int target, int exit_pc, Value *registers, int threshold)
+{
+    (void)chunk;
+    (void)exit_pc;
+    (void)registers;
+    (void)threshold;
+    return target;
+}
+
+void jit_release(Chunk *chunk)
+{
+    (void)chunk;
+}
+
+#else
+
+// Compiled code takes the register file and returns the pc to resume at
+typedef int (*JitLoopFn)(Value *registers);
+
+// A loop whose code keeps bailing out early is handed back to the VM for good
+#define JIT_MAX_SIDE_EXITS 16
+
+enum
+{
+    LOOP_COLD,
+    LOOP_COMPILED,
+    LOOP_REJECTED
+};
+
+typedef struct
+{
+    int state;
+    int backedges;
+    int side_exits;
+    int exit_pc;
+    JitLoopFn fn;
+    void *memory;
+    size_t size;
+} JitLoop;
+
+struct JitCache
+{
+    JitLoop *loops; // Indexed by the pc the loop starts at
+};
+
+// ---------------------------------------------------------------------------
+// x86-64 emission. Registers live in memory at rdi + 16*r throughout; rax,
+// rcx, rdx and xmm0-xmm2 are scratch. Nothing is cached across
+// instructions, so the VM state is exact at every instruction boundary and
+// any guard can simply return that instruction's pc.
+
+#define TYPE_AT(r) ((int32_t)((r) * sizeof(Value) + offsetof(Value, type)))
+#define INT_AT(r) ((int32_t)((r) * sizeof(Value) + offsetof(Value, int_val)))
+#define FLOAT_AT(r) ((int32_t)((r) * sizeof(Value) + offsetof(Value, float_val)))
+
+// Condition codes, as in the low nibble of Jcc/SETcc
+enum
+{
+    CC_O = 0x0,
+    CC_B = 0x2,
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_BE = 0x6,
+    CC_A = 0x7,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF
+};
+
+enum
+{
+    EAX = 0,
+    ECX = 1
+};
+
+typedef struct
+{
+    size_t at;  // Where the rel32 lives
+    int pc;     // Instruction it refers to
+    int exit;   // 1: return pc to the VM, 0: jump to its compiled code
+} Fixup;
+
+typedef struct
+{
+    uint8_t *code;
+    size_t count;
+    size_t capacity;
+
+    const Chunk *chunk;
+    int start;    // First pc of the loop
+    int exit_pc;  // First pc after it
+    size_t *label; // pc - start -> code offset
+
+    Fixup *fixups;
+    int fixup_count;
+    int fixup_capacity;
+} Emitter;
+
+static void emit8(Emitter *e, uint8_t byte)
+{
+    if (e->count >= e->capacity)
+    {
+        e->capacity = e->capacity == 0 ? 256 : e->capacity * 2;
+        e->code = (uint8_t *)realloc(e->code, e->capacity);
+    }
+    e->code[e->count++] = byte;
+}
+
+static void emit32(Emitter *e, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        emit8(e, (uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void patch32(Emitter *e, size_t at, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        e->code[at + i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// [rdi + disp32] with `reg` in the ModRM reg field
+static void emit_mem(Emitter *e, int reg, int32_t disp)
+{
+    emit8(e, (uint8_t)(0x80 | (reg << 3) | 7));
+    emit32(e, (uint32_t)disp);
+}
+
+static void load_int(Emitter *e, int reg, int r)
+{
+    emit8(e, 0x48); // mov r64, [rdi + disp]
+    emit8(e, 0x8B);
+    emit_mem(e, reg, INT_AT(r));
+}
+
+static void load_float(Emitter *e, int xmm, int r)
+{
+    emit8(e, 0xF2); // movsd xmm, [rdi + disp]
+    emit8(e, 0x0F);
+    emit8(e, 0x10);
+    emit_mem(e, xmm, FLOAT_AT(r));
+}
+
+// Writes the tag word (type, zero short_len and padding) of register r
+static void set_type(Emitter *e, int r, ValueType type)
+{
+    emit8(e, 0x48); // mov qword [rdi + disp], imm32
+    emit8(e, 0xC7);
+    emit_mem(e, 0, TYPE_AT(r));
+    emit32(e, (uint32_t)type);
+}
+
+static void store_eax(Emitter *e, int r, ValueType type)
+{
+    set_type(e, r, type);
+    emit8(e, 0x48); // mov [rdi + disp], rax (eax writes zero the top half)
+    emit8(e, 0x89);
+    emit_mem(e, EAX, INT_AT(r));
+}
+
+static void store_xmm0(Emitter *e, int r)
+{
+    set_type(e, r, VAL_FLOAT);
+    emit8(e, 0xF2); // movsd [rdi + disp], xmm0
+    emit8(e, 0x0F);
+    emit8(e, 0x11);
+    emit_mem(e, 0, FLOAT_AT(r));
+}
+
+static void cmp_type(Emitter *e, int r, ValueType type)
+{
+    emit8(e, 0x83); // cmp dword [rdi + disp], imm8
+    emit_mem(e, 7, TYPE_AT(r));
+    emit8(e, (uint8_t)type);
+}
+
+// Emits a jump with an unresolved rel32; returns where to patch it
+static size_t emit_jcc(Emitter *e, int cc)
+{
+    emit8(e, 0x0F);
+    emit8(e, (uint8_t)(0x80 | cc));
+    emit32(e, 0);
+    return e->count - 4;
+}
+
+static size_t emit_jmp(Emitter *e)
+{
+    emit8(e, 0xE9);
+    emit32(e, 0);
+    return e->count - 4;
+}
+
+// Points a jump emitted earlier at the current position
+static void patch_here(Emitter *e, size_t at)
+{
+    patch32(e, at, (uint32_t)(e->count - (at + 4)));
+}
+
+static void add_fixup(Emitter *e, size_t at, int pc, int exit)
+{
+    if (e->fixup_count >= e->fixup_capacity)
+    {
+        e->fixup_capacity = e->fixup_capacity == 0 ? 16 : e->fixup_capacity * 2;
+        e->fixups = (Fixup *)realloc(e->fixups, e->fixup_capacity * sizeof(Fixup));
+    }
+    Fixup *f = &e->fixups[e->fixup_count++];
+    f->at = at;
+    f->pc = pc;
+    f->exit = exit;
+}
+
+// Leaves compiled code for the VM to run instruction `pc` when `cc` holds
+static void exit_if(Emitter *e, int cc, int pc)
+{
+    add_fixup(e, emit_jcc(e, cc), pc, 1);
+}
+
+// Continues at bytecode `pc`, in compiled code when it is part of the loop
+static void jump_if(Emitter *e, int cc, int pc)
+{
+    int inside = pc >= e->start && pc < e->exit_pc;
+    add_fixup(e, emit_jcc(e, cc), pc, !inside);
+}
+
+static void jump_to(Emitter *e, int pc)
+{
+    int inside = pc >= e->start && pc < e->exit_pc;
+    add_fixup(e, emit_jmp(e), pc, !inside);
+}
+
+static void return_pc(Emitter *e, int pc)
+{
+    emit8(e, 0xB8); // mov eax, imm32
+    emit32(e, (uint32_t)pc);
+    emit8(e, 0xC3); // ret
+}
+
+// rax = rax <op> rcx, exiting to the VM where it would report an error or
+// promote to a bigint
+static void int_arith(Emitter *e, int op, int pc)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        emit8(e, 0x48); // add rax, rcx
+        emit8(e, 0x01);
+        emit8(e, 0xC8);
+        exit_if(e, CC_O, pc);
+        break;
+    case OP_SUB:
+        emit8(e, 0x48); // sub rax, rcx
+        emit8(e, 0x29);
+        emit8(e, 0xC8);
+        exit_if(e, CC_O, pc);
+        break;
+    case OP_MUL:
+        emit8(e, 0x48); // imul rax, rcx
+        emit8(e, 0x0F);
+        emit8(e, 0xAF);
+        emit8(e, 0xC1);
+        exit_if(e, CC_O, pc);
+        break;
+    case OP_DIV:
+        // Zero is a reported error and INT64_MIN / -1 traps; both go to the VM
+        emit8(e, 0x48); // cmp rcx, 0
+        emit8(e, 0x83);
+        emit8(e, 0xF9);
+        emit8(e, 0x00);
+        exit_if(e, CC_E, pc);
+        emit8(e, 0x48); // cmp rcx, -1
+        emit8(e, 0x83);
+        emit8(e, 0xF9);
+        emit8(e, 0xFF);
+        exit_if(e, CC_E, pc);
+        emit8(e, 0x48); // cqo
+        emit8(e, 0x99);
+        emit8(e, 0x48); // idiv rcx
+        emit8(e, 0xF7);
+        emit8(e, 0xF9);
+        break;
+    }
+}
+
+// xmm0 = xmm0 <op> xmm1
+static void float_arith(Emitter *e, int op, int pc)
+{
+    static const uint8_t sse_op[] = {0x58, 0x5C, 0x59, 0x5E}; // add, sub, mul, div
+    if (op == OP_DIV)
+    {
+        emit8(e, 0x66); // xorpd xmm2, xmm2
+        emit8(e, 0x0F);
+        emit8(e, 0x57);
+        emit8(e, 0xD2);
+        emit8(e, 0x66); // ucomisd xmm1, xmm2
+        emit8(e, 0x0F);
+        emit8(e, 0x2E);
+        emit8(e, 0xCA);
+        exit_if(e, CC_E, pc); // Zero divisor (or NaN): let the VM decide
+    }
+    emit8(e, 0xF2);
+    emit8(e, 0x0F);
+    emit8(e, sse_op[op - OP_ADD]);
+    emit8(e, 0xC1);
+}
+
+// Relations in opcode order: EQ, NEQ, LT, GT, LE, GE
+static const int int_cc[] = {CC_E, CC_NE, CC_L, CC_G, CC_LE, CC_GE};
+
+static void int_compare(Emitter *e, int left, int right)
+{
+    load_int(e, EAX, left);
+    load_int(e, ECX, right);
+    emit8(e, 0x48); // cmp rax, rcx
+    emit8(e, 0x39);
+    emit8(e, 0xC8);
+}
+
+// Sets flags so that the returned condition code means `left <rel> right`.
+// Returns -1 for == and !=, which need the parity flag; those go to the VM.
+static int float_compare(Emitter *e, int rel, int left, int right)
+{
+    if (rel < 2)
+        return -1;
+    load_float(e, 0, left);
+    load_float(e, 1, right);
+    // ucomisd leaves "above" false for unordered operands, matching C,
+    // so < and <= are done as > and >= with the operands swapped
+    int swap = rel == 2 || rel == 4;
+    emit8(e, 0x66);
+    emit8(e, 0x0F);
+    emit8(e, 0x2E);
+    emit8(e, swap ? 0xC8 : 0xC1); // ucomisd xmm1, xmm0 / ucomisd xmm0, xmm1
+    return (rel == 2 || rel == 3) ? CC_A : CC_AE;
+}
+
+static void setcc_eax(Emitter *e, int cc)
+{
+    emit8(e, 0x0F); // setcc al
+    emit8(e, (uint8_t)(0x90 | cc));
+    emit8(e, 0xC0);
+    emit8(e, 0x0F); // movzx eax, al
+    emit8(e, 0xB6);
+    emit8(e, 0xC0);
+}
+
+// Type-guarded ADD/SUB/MUL/DIV and EQ..GE: int/int and float/float run
+// inline, anything else is left to the VM.
+static void generic_binary(Emitter *e, Instr ins, int pc)
+{
+    int compare = ins.op >= OP_EQ && ins.op <= OP_GE;
+
+    cmp_type(e, ins.b, VAL_INT);
+    size_t not_int = emit_jcc(e, CC_NE);
+    cmp_type(e, ins.c, VAL_INT);
+    exit_if(e, CC_NE, pc);
+    if (compare)
+    {
+        int_compare(e, ins.b, ins.c);
+        setcc_eax(e, int_cc[ins.op - OP_EQ]);
+        store_eax(e, ins.a, VAL_BOOL);
+    }
+    else
+    {
+        load_int(e, EAX, ins.b);
+        load_int(e, ECX, ins.c);
+        int_arith(e, ins.op, pc);
+        store_eax(e, ins.a, VAL_INT);
+    }
+    size_t done = emit_jmp(e);
+
+    patch_here(e, not_int);
+    cmp_type(e, ins.b, VAL_FLOAT);
+    exit_if(e, CC_NE, pc);
+    cmp_type(e, ins.c, VAL_FLOAT);
+    exit_if(e, CC_NE, pc);
+    if (compare)
+    {
+        int cc = float_compare(e, ins.op - OP_EQ, ins.b, ins.c);
+        if (cc < 0)
+        {
+            add_fixup(e, emit_jmp(e), pc, 1);
+        }
+        else
+        {
+            setcc_eax(e, cc);
+            store_eax(e, ins.a, VAL_BOOL);
+        }
+    }
+    else
+    {
+        load_float(e, 0, ins.b);
+        load_float(e, 1, ins.c);
+        float_arith(e, ins.op, pc);
+        store_xmm0(e, ins.a);
+    }
+    patch_here(e, done);
+}
+
+// Both operands of a proven-int op must still be small ints; a bigint
+// goes to the VM
+static void guard_ints(Emitter *e, int left, int right, int pc)
+{
+    cmp_type(e, left, VAL_INT);
+    exit_if(e, CC_NE, pc);
+    cmp_type(e, right, VAL_INT);
+    exit_if(e, CC_NE, pc);
+}
+
+// Compare-and-branch: jump to `target` when (a <rel> b) == k
+static void compare_branch(Emitter *e, Instr ins, int target, int pc, int proven_int)
+{
+    int rel = proven_int ? ins.op - OP_JEQ_II : ins.op - OP_JEQ;
+    size_t not_int = 0;
+    if (proven_int)
+    {
+        guard_ints(e, ins.a, ins.b, pc);
+    }
+    else
+    {
+        cmp_type(e, ins.a, VAL_INT);
+        not_int = emit_jcc(e, CC_NE);
+        cmp_type(e, ins.b, VAL_INT);
+        exit_if(e, CC_NE, pc);
+    }
+    int_compare(e, ins.a, ins.b);
+    jump_if(e, ins.k ? int_cc[rel] : int_cc[rel] ^ 1, target);
+    if (proven_int)
+        return;
+
+    size_t done = emit_jmp(e);
+    patch_here(e, not_int);
+    cmp_type(e, ins.a, VAL_FLOAT);
+    exit_if(e, CC_NE, pc);
+    cmp_type(e, ins.b, VAL_FLOAT);
+    exit_if(e, CC_NE, pc);
+    int cc = float_compare(e, rel, ins.a, ins.b);
+    if (cc < 0)
+        add_fixup(e, emit_jmp(e), pc, 1);
+    else
+        jump_if(e, ins.k ? cc : cc ^ 1, target);
+    patch_here(e, done);
+}
+
+// Registers the loop writes must not hold a string, array or bigint on
+// entry: compiled code overwrites them without releasing anything, and only
+// ever stores small numbers, bools, None or copies of registers holding
+// none of those. VAL_STRING, VAL_ARRAY, VAL_BIGINT and VAL_DICT are the
+// last types, so one unsigned compare checks for all four.
+static int writes_register(Instr ins)
+{
+    switch (ins.op)
+    {
+    case OP_LOADNIL:
+    case OP_MOVE:
+    case OP_ADDI:
+    case OP_ADDI_I:
+        return 1;
+    default:
+        return ins.op >= OP_ADD && ins.op <= OP_MUL_FF;
+    }
+}
+
+static int is_compare_branch(int op)
+{
+    return (op >= OP_JEQ && op <= OP_JGE) || (op >= OP_JEQ_II && op <= OP_JGE_II);
+}
+
+// Emits instruction `pc`; returns 0 if the loop can't be compiled
+static int emit_instruction(Emitter *e, int pc)
+{
+    const Instr *code = e->chunk->code;
+    Instr ins = code[pc];
+
+    switch (ins.op)
+    {
+    case OP_LOADNIL:
+        set_type(e, ins.a, VAL_NONE);
+        return 1;
+
+    case OP_MOVE:
+        if (ins.a == ins.b)
+            return 1;
+        cmp_type(e, ins.b, VAL_STRING);
+        exit_if(e, CC_AE, pc);
+        for (int half = 0; half < 2; half++)
+        {
+            int32_t offset = 8 * half;
+            emit8(e, 0x48); // mov rax, [rdi + disp]
+            emit8(e, 0x8B);
+            emit_mem(e, EAX, TYPE_AT(ins.b) + offset);
+            emit8(e, 0x48); // mov [rdi + disp], rax
+            emit8(e, 0x89);
+            emit_mem(e, EAX, TYPE_AT(ins.a) + offset);
+        }
+        return 1;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_EQ:
+    case OP_NEQ:
+    case OP_LT:
+    case OP_GT:
+    case OP_LE:
+    case OP_GE:
+        generic_binary(e, ins, pc);
+        return 1;
+
+    case OP_ADD_II:
+    case OP_SUB_II:
+    case OP_MUL_II:
+        guard_ints(e, ins.b, ins.c, pc);
+        load_int(e, EAX, ins.b);
+        load_int(e, ECX, ins.c);
+        int_arith(e, ins.op - OP_ADD_II + OP_ADD, pc);
+        store_eax(e, ins.a, VAL_INT);
+        return 1;
+
+    case OP_ADD_FF:
+    case OP_SUB_FF:
+    case OP_MUL_FF:
+        load_float(e, 0, ins.b);
+        load_float(e, 1, ins.c);
+        float_arith(e, ins.op - OP_ADD_FF + OP_ADD, pc);
+        store_xmm0(e, ins.a);
+        return 1;
+
+    case OP_ADDI:
+    case OP_ADDI_I:
+        cmp_type(e, ins.b, VAL_INT);
+        exit_if(e, CC_NE, pc);
+        load_int(e, EAX, ins.b);
+        emit8(e, 0x48); // add rax, imm32
+        emit8(e, 0x05);
+        emit32(e, (uint32_t)(int32_t)(int16_t)ins.c);
+        exit_if(e, CC_O, pc);
+        store_eax(e, ins.a, VAL_INT);
+        return 1;
+
+    case OP_JMP:
+        jump_to(e, ins.sx);
+        return 1;
+
+    case OP_JMPIF:
+    {
+        // Ints and bools test their payload; other types go to the VM
+        cmp_type(e, ins.a, VAL_INT);
+        size_t is_int = emit_jcc(e, CC_E);
+        cmp_type(e, ins.a, VAL_BOOL);
+        exit_if(e, CC_NE, pc);
+        patch_here(e, is_int);
+        emit8(e, 0x48); // cmp qword [rdi + disp], 0
+        emit8(e, 0x83);
+        emit_mem(e, 7, INT_AT(ins.a));
+        emit8(e, 0x00);
+        jump_if(e, ins.k ? CC_NE : CC_E, ins.sx);
+        return 1;
+    }
+
+    default:
+        if (is_compare_branch(ins.op))
+        {
+            compare_branch(e, ins, code[pc + 1].sx, pc, ins.op >= OP_JEQ_II);
+            return 1;
+        }
+        // PRINT, LOADK, RETURN, calls: not a numeric loop
+        return 0;
+    }
+}
+
+static int compile_loop(const Chunk *chunk, int start, int exit_pc, JitLoop *loop)
+{
+    Emitter e;
+    memset(&e, 0, sizeof(e));
+    e.chunk = chunk;
+    e.start = start;
+    e.exit_pc = exit_pc;
+    e.label = (size_t *)malloc((exit_pc - start) * sizeof(size_t));
+
+    // The only way into the code is through the top, so guard once there
+    for (int pc = start; pc < exit_pc; pc += is_compare_branch(chunk->code[pc].op) ? 2 : 1)
+    {
+        Instr ins = chunk->code[pc];
+        if (writes_register(ins))
+        {
+            cmp_type(&e, ins.a, VAL_STRING);
+            exit_if(&e, CC_AE, start);
+        }
+    }
+
+    int ok = 1;
+    for (int pc = start; pc < exit_pc && ok; pc += is_compare_branch(chunk->code[pc].op) ? 2 : 1)
+    {
+        e.label[pc - start] = e.count;
+        ok = emit_instruction(&e, pc);
+    }
+    return_pc(&e, exit_pc); // Fell out of the bottom
+
+    // Exit stubs, one per distinct pc, then resolve every jump
+    int *stub_pc = (int *)malloc((e.fixup_count + 1) * sizeof(int));
+    size_t *stub_at = (size_t *)malloc((e.fixup_count + 1) * sizeof(size_t));
+    int stub_count = 0;
+    for (int i = 0; ok && i < e.fixup_count; i++)
+    {
+        Fixup *f = &e.fixups[i];
+        size_t target;
+        if (!f->exit)
+        {
+            target = e.label[f->pc - start];
+        }
+        else
+        {
+            int s = 0;
+            while (s < stub_count && stub_pc[s] != f->pc)
+                s++;
+            if (s == stub_count)
+            {
+                stub_pc[s] = f->pc;
+                stub_at[s] = e.count;
+                stub_count++;
+                return_pc(&e, f->pc);
+            }
+            target = stub_at[s];
+        }
+        patch32(&e, f->at, (uint32_t)(target - (f->at + 4)));
+    }
+    free(stub_pc);
+    free(stub_at);
+
+    if (ok)
+    {
+        long page = sysconf(_SC_PAGESIZE);
+        size_t size = (e.count + page - 1) / page * page;
+        void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            ok = 0;
+        }
+        else
+        {
+            memcpy(memory, e.code, e.count);
+            // Never writable and executable at the same time
+            if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+            {
+                munmap(memory, size);
+                ok = 0;
+            }
+            else
+            {
+                loop->memory = memory;
+                loop->size = size;
+                loop->fn = (JitLoopFn)memory;
+                loop->exit_pc = exit_pc;
+            }
+        }
+    }
+
+    free(e.code);
+    free(e.label);
+    free(e.fixups);
+    return ok;
+}
+
+int jit_backedge(Chunk *chunk, int target, int exit_pc, Value *registers, int threshold)
+{
+    if (chunk->jit == NULL)
+    {
+        chunk->jit = (struct JitCache *)malloc(sizeof(struct JitCache));
+        chunk->jit->loops = (JitLoop *)calloc(chunk->count, sizeof(JitLoop));
+    }
+
+    JitLoop *loop = &chunk->jit->loops[target];
+    if (loop->state == LOOP_COLD)
+    {
+        if (++loop->backedges < threshold)
+            return target;
+        loop->state = compile_loop(chunk, target, exit_pc, loop) ? LOOP_COMPILED : LOOP_REJECTED;
+    }
+    if (loop->state != LOOP_COMPILED || loop->exit_pc != exit_pc)
+        return target;
+
+    int resume = loop->fn(registers);
+    if (resume != exit_pc && ++loop->side_exits > JIT_MAX_SIDE_EXITS)
+        loop->state = LOOP_REJECTED;
+    return resume;
+}
+
+void jit_release(Chunk *chunk)
+{
+    if (chunk->jit == NULL)
+        return;
+    for (int pc = 0; pc < chunk->count; pc++)
+    {
+        JitLoop *loop = &chunk->jit->loops[pc];
+        if (loop->memory != NULL)
+            munmap(loop->memory, loop->size);
+    }
+    free(chunk->jit->loops);
+    free(chunk->jit);
+    chunk->jit = NULL;
+}
+
+#endif
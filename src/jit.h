@@ -0,0 +1,31 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "bytecode.h"
+
+// Baseline template JIT for hot bytecode loops. Available on x86-64 Linux
+// with the tagged-union Value layout; elsewhere jit_available() says so
+// and the VM keeps interpreting. It is switched on per environment, by a
+// nonzero Environment.jit_threshold.
+//
+// A loop is the span from a backward branch's target up to and including
+// the branch. Once it has branched back `threshold` times it is compiled,
+// provided it only does int/float arithmetic, comparisons and register
+// moves. Compiled code reads and writes the VM registers in place and
+// returns to the interpreter, at the instruction that needs it, whenever a
+// type guard fails or a division might report an error.
+
+#define JIT_DEFAULT_THRESHOLD 1000
+
+int jit_available(void);
+
+// Called by the VM on a taken branch from the loop ending just before
+// `exit_pc` back to `target`; the loop is compiled once it has branched
+// back `threshold` times. Returns the pc to continue interpreting at:
+// `target` itself, or wherever compiled code left the loop.
+int jit_backedge(Chunk *chunk, int target, int exit_pc, Value *registers, int threshold);
+
+// Frees the compiled loops of a chunk; called by chunk_free().
+void jit_release(Chunk *chunk);
+
+#endif
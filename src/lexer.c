@@ -1,7 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include "lexer.h"
 
 const char* token_type_to_string(TokenType type) {
@@ -17,6 +16,8 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_ELSE: return "ELSE";
         case TOKEN_WHILE: return "WHILE";
         case TOKEN_PRINT: return "PRINT";
+        case TOKEN_FOR: return "FOR";
+        case TOKEN_IN: return "IN";
         case TOKEN_PLUS: return "PLUS";
         case TOKEN_MINUS: return "MINUS";
         case TOKEN_MUL: return "MUL";
@@ -30,6 +31,10 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_GE: return "GE";
         case TOKEN_LPAREN: return "LPAREN";
         case TOKEN_RPAREN: return "RPAREN";
+        case TOKEN_LBRACKET: return "LBRACKET";
+        case TOKEN_RBRACKET: return "RBRACKET";
+        case TOKEN_LBRACE: return "LBRACE";
+        case TOKEN_RBRACE: return "RBRACE";
         case TOKEN_COLON: return "COLON";
         case TOKEN_COMMA: return "COMMA";
         case TOKEN_SEMICOLON: return "SEMICOLON";
@@ -38,198 +43,277 @@ const char* token_type_to_string(TokenType type) {
     }
 }
 
-void lexer_init(Lexer *lexer, const char *source) {
+// Character classes, indexed by byte. Bytes >= 0x80 have no class.
+#define A CC_ALPHA
+#define D CC_DIGIT
+#define S CC_SPACE
+enum { CC_ALPHA = 1, CC_DIGIT = 2, CC_SPACE = 4 };
+
+static const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, 0, 0, 0, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+};
+#undef A
+#undef D
+#undef S
+
+#define CLASS(c) char_class[(unsigned char)(c)]
+
+void lexer_init(Lexer *lexer, SymbolTable *symbols, const char *source, int length) {
     lexer->source = source;
     lexer->pos = 0;
-    lexer->len = strlen(source);
-    lexer->line = 1;
-    lexer->col = 1;
+    lexer->len = length;
+    lexer->mark_offset = 0;
+    lexer->mark_line = 1;
+    lexer->mark_line_start = 0;
+    lexer->symbols = symbols;
 }
 
-static char peek(Lexer *lexer) {
-    if (lexer->pos >= lexer->len) return 0;
-    return lexer->source[lexer->pos];
-}
-
-static char advance(Lexer *lexer) {
-    if (lexer->pos >= lexer->len) return 0;
-    char c = lexer->source[lexer->pos++];
-    lexer->col++;
-    if (c == '\n') {
-        lexer->line++;
-        lexer->col = 1;
+void lexer_position(Lexer *lexer, int offset, int *line, int *col) {
+    // Positions are only needed for diagnostics, so they are computed on
+    // demand by counting newlines forward from the last position asked for.
+    if (offset > lexer->len) offset = lexer->len;
+    if (offset < lexer->mark_offset) {
+        lexer->mark_offset = 0;
+        lexer->mark_line = 1;
+        lexer->mark_line_start = 0;
+    }
+    const char *s = lexer->source;
+    const char *nl = s + lexer->mark_offset;
+    const char *end = s + offset;
+    while ((nl = memchr(nl, '\n', end - nl)) != NULL) {
+        lexer->mark_line++;
+        lexer->mark_line_start = (int)(++nl - s);
     }
-    return c;
+    lexer->mark_offset = offset;
+    *line = lexer->mark_line;
+    *col = offset - lexer->mark_line_start + 1;
 }
 
-static Token make_token(Lexer *lexer, TokenType type, char *value) {
+static Token make_token(TokenType type, int start, int length) {
     Token token;
     token.type = type;
-    token.value = value;
-    token.line = lexer->line;
-    token.col = lexer->col;
+    token.start = start;
+    token.length = length;
+    token.sym = -1;
     return token;
 }
 
-void token_free(Token token) {
-    if (token.value) {
-        free(token.value);
+// Run scanners: each returns the offset of the first byte at or after `pos`
+// that ends the run. Whole 16-byte blocks are tested with SSE2 where
+// available; the tail (and other targets) fall back to the class table, so
+// no load ever reads past `len`.
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LEXER_SSE2 1
+
+static int lowest_bit(unsigned mask) {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while (!(mask & 1)) { mask >>= 1; i++; }
+    return i;
+#endif
+}
+
+// Mask of bytes in [lo, hi]; bytes >= 0x80 compare as negative and never match
+static __m128i in_range(__m128i chunk, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(chunk, _mm_set1_epi8(hi + 1)));
+}
+#endif
+
+static int scan_blanks(const char *s, int pos, int len) {
+#ifdef LEXER_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (pos + 16 <= len) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(s + pos));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                                _mm_cmpeq_epi8(chunk, tab)),
+                                   _mm_cmpeq_epi8(chunk, cr));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(hit) & 0xFFFF;
+        if (stop) return pos + lowest_bit(stop);
+        pos += 16;
+    }
+#endif
+    while (pos < len && (CLASS(s[pos]) & CC_SPACE)) pos++;
+    return pos;
+}
+
+static int scan_identifier(const char *s, int pos, int len) {
+#ifdef LEXER_SSE2
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i underscore = _mm_set1_epi8('_');
+    while (pos + 16 <= len) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(s + pos));
+        // Setting 0x20 folds A-Z onto a-z and leaves digits unchanged
+        __m128i folded = _mm_or_si128(chunk, lower);
+        __m128i hit = _mm_or_si128(_mm_or_si128(in_range(folded, 'a', 'z'),
+                                                in_range(chunk, '0', '9')),
+                                   _mm_cmpeq_epi8(chunk, underscore));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(hit) & 0xFFFF;
+        if (stop) return pos + lowest_bit(stop);
+        pos += 16;
     }
+#endif
+    while (pos < len && (CLASS(s[pos]) & (CC_ALPHA | CC_DIGIT))) pos++;
+    return pos;
 }
 
-static int is_alpha(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+// Stops at the closing quote or a NUL byte
+static int scan_string(const char *s, int pos, int len) {
+#ifdef LEXER_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i zero = _mm_setzero_si128();
+    while (pos + 16 <= len) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(s + pos));
+        unsigned stop = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, zero)));
+        if (stop) return pos + lowest_bit(stop);
+        pos += 16;
+    }
+#endif
+    while (pos < len && s[pos] != '"' && s[pos] != 0) pos++;
+    return pos;
 }
 
-static int is_digit(char c) {
-    return c >= '0' && c <= '9';
+static int scan_comment(const char *s, int pos, int len) {
+    // libc's memchr is already vectorised
+    const char *nl = memchr(s + pos, '\n', len - pos);
+    return nl ? (int)(nl - s) : len;
 }
 
-static int is_alnum(char c) {
-    return is_alpha(c) || is_digit(c);
+static TokenType check_keyword(const char *text, int length, int offset,
+                               const char *rest, int rest_length, TokenType type) {
+    if (length == offset + rest_length && memcmp(text + offset, rest, rest_length) == 0) {
+        return type;
+    }
+    return TOKEN_IDENTIFIER;
 }
 
-static Token lex_identifier_or_keyword(Lexer *lexer) {
-    int start = lexer->pos - 1;
-    while (is_alnum(peek(lexer))) {
-        advance(lexer);
+static TokenType keyword_type(const char *text, int length) {
+    switch (text[0]) {
+        case 'd': return check_keyword(text, length, 1, "ef", 2, TOKEN_DEF);
+        case 'e': return check_keyword(text, length, 1, "lse", 3, TOKEN_ELSE);
+        case 'f': return check_keyword(text, length, 1, "or", 2, TOKEN_FOR);
+        case 'i':
+            if (length == 2 && text[1] == 'f') return TOKEN_IF;
+            if (length == 2 && text[1] == 'n') return TOKEN_IN;
+            break;
+        case 'p': return check_keyword(text, length, 1, "rint", 4, TOKEN_PRINT);
+        case 'r': return check_keyword(text, length, 1, "eturn", 5, TOKEN_RETURN);
+        case 'w': return check_keyword(text, length, 1, "hile", 4, TOKEN_WHILE);
     }
+    return TOKEN_IDENTIFIER;
+}
+
+static Token lex_identifier_or_keyword(Lexer *lexer) {
+    int start = lexer->pos;
+    lexer->pos = scan_identifier(lexer->source, start + 1, lexer->len);
     int length = lexer->pos - start;
-    char *text = (char*)malloc(length + 1);
-    strncpy(text, lexer->source + start, length);
-    text[length] = '\0';
-
-    TokenType type = TOKEN_IDENTIFIER;
-    if (strcmp(text, "def") == 0) type = TOKEN_DEF;
-    else if (strcmp(text, "return") == 0) type = TOKEN_RETURN;
-    else if (strcmp(text, "if") == 0) type = TOKEN_IF;
-    else if (strcmp(text, "else") == 0) type = TOKEN_ELSE;
-    else if (strcmp(text, "while") == 0) type = TOKEN_WHILE;
-    else if (strcmp(text, "print") == 0) type = TOKEN_PRINT;
-
-    if (type != TOKEN_IDENTIFIER) {
-        free(text);
-        text = NULL;
+    const char *text = lexer->source + start;
+
+    TokenType type = keyword_type(text, length);
+    Token token = make_token(type, start, length);
+    if (type == TOKEN_IDENTIFIER) {
+        // Identifiers are interned straight from the source, no copy needed
+        token.sym = symbol_intern(lexer->symbols, text, length);
     }
-    
-    return make_token(lexer, type, text);
+    return token;
 }
 
 static Token lex_number(Lexer *lexer) {
-    int start = lexer->pos - 1;
+    const char *s = lexer->source;
+    int start = lexer->pos;
+    int pos = start + 1;
     int is_float = 0;
-    
-    while (is_digit(peek(lexer))) {
-        advance(lexer);
-    }
-    
-    if (peek(lexer) == '.') {
+
+    while (pos < lexer->len && (CLASS(s[pos]) & CC_DIGIT)) pos++;
+
+    if (pos < lexer->len && s[pos] == '.') {
         is_float = 1;
-        advance(lexer);
-        while (is_digit(peek(lexer))) {
-            advance(lexer);
-        }
+        pos++;
+        while (pos < lexer->len && (CLASS(s[pos]) & CC_DIGIT)) pos++;
     }
-    
-    int length = lexer->pos - start;
-    char *text = (char*)malloc(length + 1);
-    strncpy(text, lexer->source + start, length);
-    text[length] = '\0';
-    
-    return make_token(lexer, is_float ? TOKEN_FLOAT : TOKEN_INT, text);
+
+    lexer->pos = pos;
+    return make_token(is_float ? TOKEN_FLOAT : TOKEN_INT, start, pos - start);
 }
 
 static Token lex_string(Lexer *lexer) {
-    // Already consumed opening quote
-    int start = lexer->pos;
-    while (peek(lexer) != '"' && peek(lexer) != 0) {
-        if (peek(lexer) == '\n') {
-            // Error: multiline string not supported yet without triple quotes
-            // But let's just handle it loosely
-        }
-        advance(lexer);
-    }
-    
-    if (peek(lexer) == 0) {
+    int start = lexer->pos + 1; // Skip opening quote
+    int end = scan_string(lexer->source, start, lexer->len);
+
+    if (end >= lexer->len || lexer->source[end] == 0) {
         // Error: unterminated string
-        return make_token(lexer, TOKEN_EOF, NULL); // Should return error token
+        lexer->pos = end;
+        return make_token(TOKEN_EOF, end, 0); // Should return error token
     }
-    
-    int length = lexer->pos - start;
-    char *text = (char*)malloc(length + 1);
-    strncpy(text, lexer->source + start, length);
-    text[length] = '\0';
-    
-    advance(lexer); // consume closing quote
-    
-    return make_token(lexer, TOKEN_STRING, text);
+
+    lexer->pos = end + 1; // consume closing quote
+    return make_token(TOKEN_STRING, start, end - start);
 }
 
 Token lexer_next_token(Lexer *lexer) {
+    const char *s = lexer->source;
     while (1) {
-        char c = peek(lexer);
-        
-        if (c == 0) return make_token(lexer, TOKEN_EOF, NULL);
-        
-        if (c == ' ' || c == '\t' || c == '\r') {
-            advance(lexer);
-            continue;
-        }
-        
-        if (c == '#') {
-            while (peek(lexer) != '\n' && peek(lexer) != 0) {
-                advance(lexer);
-            }
+        if (lexer->pos >= lexer->len) return make_token(TOKEN_EOF, lexer->len, 0);
+
+        char c = s[lexer->pos];
+        unsigned char cls = CLASS(c);
+
+        if (cls & CC_SPACE) {
+            lexer->pos = scan_blanks(s, lexer->pos + 1, lexer->len);
             continue;
         }
-        
-        if (c == '\n') {
-            advance(lexer);
-            return make_token(lexer, TOKEN_NEWLINE, NULL);
-        }
-        
-        if (is_alpha(c)) {
-            advance(lexer);
-            return lex_identifier_or_keyword(lexer);
-        }
-        
-        if (is_digit(c)) {
-            advance(lexer);
-            return lex_number(lexer);
-        }
-        
-        if (c == '"') {
-            advance(lexer);
-            return lex_string(lexer);
-        }
-        
-        advance(lexer); // Consume symbol
-        
+        if (cls & CC_ALPHA) return lex_identifier_or_keyword(lexer);
+        if (cls & CC_DIGIT) return lex_number(lexer);
+
+        int start = lexer->pos++;
+        char next = lexer->pos < lexer->len ? s[lexer->pos] : 0;
+
         switch (c) {
-            case '+': return make_token(lexer, TOKEN_PLUS, NULL);
-            case '-': return make_token(lexer, TOKEN_MINUS, NULL);
-            case '*': return make_token(lexer, TOKEN_MUL, NULL);
-            case '/': return make_token(lexer, TOKEN_DIV, NULL);
-            case '(': return make_token(lexer, TOKEN_LPAREN, NULL);
-            case ')': return make_token(lexer, TOKEN_RPAREN, NULL);
-            case ':': return make_token(lexer, TOKEN_COLON, NULL);
-            case ',': return make_token(lexer, TOKEN_COMMA, NULL);
-            case ';': return make_token(lexer, TOKEN_SEMICOLON, NULL);
-            case '=': 
-                if (peek(lexer) == '=') { advance(lexer); return make_token(lexer, TOKEN_EQ, NULL); }
-                return make_token(lexer, TOKEN_ASSIGN, NULL);
+            case 0: lexer->pos = start; return make_token(TOKEN_EOF, start, 0);
+            case '#': lexer->pos = scan_comment(s, lexer->pos, lexer->len); continue;
+            case '\n': return make_token(TOKEN_NEWLINE, start, 1);
+            case '"': lexer->pos = start; return lex_string(lexer);
+            case '+': return make_token(TOKEN_PLUS, start, 1);
+            case '-': return make_token(TOKEN_MINUS, start, 1);
+            case '*': return make_token(TOKEN_MUL, start, 1);
+            case '/': return make_token(TOKEN_DIV, start, 1);
+            case '(': return make_token(TOKEN_LPAREN, start, 1);
+            case ')': return make_token(TOKEN_RPAREN, start, 1);
+            case '[': return make_token(TOKEN_LBRACKET, start, 1);
+            case ']': return make_token(TOKEN_RBRACKET, start, 1);
+            case '{': return make_token(TOKEN_LBRACE, start, 1);
+            case '}': return make_token(TOKEN_RBRACE, start, 1);
+            case ':': return make_token(TOKEN_COLON, start, 1);
+            case ',': return make_token(TOKEN_COMMA, start, 1);
+            case ';': return make_token(TOKEN_SEMICOLON, start, 1);
+            case '=':
+                if (next == '=') { lexer->pos++; return make_token(TOKEN_EQ, start, 2); }
+                return make_token(TOKEN_ASSIGN, start, 1);
             case '!':
-                if (peek(lexer) == '=') { advance(lexer); return make_token(lexer, TOKEN_NEQ, NULL); }
+                if (next == '=') { lexer->pos++; return make_token(TOKEN_NEQ, start, 2); }
                 break; // Error
             case '<':
-                if (peek(lexer) == '=') { advance(lexer); return make_token(lexer, TOKEN_LE, NULL); }
-                return make_token(lexer, TOKEN_LT, NULL);
+                if (next == '=') { lexer->pos++; return make_token(TOKEN_LE, start, 2); }
+                return make_token(TOKEN_LT, start, 1);
             case '>':
-                if (peek(lexer) == '=') { advance(lexer); return make_token(lexer, TOKEN_GE, NULL); }
-                return make_token(lexer, TOKEN_GT, NULL);
+                if (next == '=') { lexer->pos++; return make_token(TOKEN_GE, start, 2); }
+                return make_token(TOKEN_GT, start, 1);
         }
-        
+
         // Unknown token
-        // return make_token(lexer, TOKEN_ERROR, NULL);
+        // return make_token(TOKEN_ERROR, start, lexer->pos - start);
     }
 }
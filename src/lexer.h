@@ -2,17 +2,28 @@
 #define LEXER_H
 
 #include "token.h"
+#include "symbol.h"
 
 typedef struct {
     const char *source;
     int pos;
     int len;
-    int line;
-    int col;
+    // Line/column are computed lazily; this caches the last lookup
+    int mark_offset;
+    int mark_line;
+    int mark_line_start;
+    SymbolTable *symbols; // Where identifiers are interned
 } Lexer;
 
-void lexer_init(Lexer *lexer, const char *source);
+// `source` need not be NUL-terminated; it must outlive the tokens.
+// Identifiers are interned into `symbols`.
+void lexer_init(Lexer *lexer, SymbolTable *symbols, const char *source, int length);
 Token lexer_next_token(Lexer *lexer);
-void token_free(Token token);
+void lexer_position(Lexer *lexer, int offset, int *line, int *col); // 1-based
+
+static inline const char *token_text(const Lexer *lexer, Token token)
+{
+    return lexer->source + token.start;
+}
 
 #endif
@@ -1,22 +1,207 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "lexer.h"
 #include "parser.h"
 #include "eval.h"
+#include "resolver.h"
+#include "compiler.h"
+#include "vm.h"
+#include "source.h"
+#include "optimizer.h"
+#include "infer.h"
+#include "jit.h"
+#include "image.h"
+#include "profile.h"
+#include "output.h"
+#include "batch.h"
 
-int main(int argc, char **argv)
+static int use_tree_walker = 0;
+static int dump_bytecode = 0;
+static int dump_ast = 0;
+static int quicken_stats = 0;
+static int use_jit = 0;
+static int jit_threshold = JIT_DEFAULT_THRESHOLD;
+static const char *cache_dir = NULL; // Where program images go; NULL disables them
+static const char *profile_path = NULL; // Folded-stack output of --profile; NULL when off
+static const char *batch_dir = NULL; // Directory of scripts for --batch; NULL when off
+static int batch_threads = 0;        // -j N; 0 for one thread per core
+
+// Runs the optimizer over a freshly parsed program, dumping the tree before
+// and after if asked. Must come before resolve().
+static NodeId prepare(AST *ast, NodeId program, Environment *env)
 {
-    printf("LoFy Interpreter v0.1\n");
-    printf("Type 'exit' to quit.\n");
+    if (dump_ast)
+    {
+        out_printf("; AST before optimization\n");
+        ast_dump(ast, env->symbols, program, 0);
+    }
+    program = optimize(ast, program, env);
+    if (dump_ast)
+    {
+        out_printf("; AST after optimization\n");
+        ast_dump(ast, env->symbols, program, 0);
+    }
+    return program;
+}
 
-    Environment env;
-    env_init(&env);
+static Value run_chunk(Chunk *chunk, Environment *env)
+{
+    if (dump_bytecode)
+    {
+        chunk_disassemble(chunk);
+        // Compiled now rather than on their first call, so they can be shown
+        for (int i = 0; i < env->function_count; i++)
+        {
+            Function *fn = env->functions[i];
+            if (fn->compiled != 0)
+                continue;
+            fn->compiled = compile_function(fn) == 0 ? 1 : -1;
+            if (fn->compiled < 0)
+            {
+                chunk_free(&fn->chunk);
+                continue;
+            }
+            out_printf("; function %s\n", symbol_name(env->symbols, fn->sym));
+            chunk_disassemble(&fn->chunk);
+        }
+    }
+    return vm_run(chunk, env);
+}
+
+// Runs the tree at `id` on the selected engine and returns its value. A
+// program too big for the VM's register file runs on the tree-walker.
+static Value run(AST *ast, NodeId id, Environment *env)
+{
+    if (use_tree_walker)
+        return eval(ast, id, env);
 
-    char buffer[1024];
+    Chunk chunk;
+    chunk_init(&chunk);
+    Value v = compile(ast, id, env, &chunk) == 0 ? run_chunk(&chunk, env) : eval(ast, id, env);
+    chunk_free(&chunk);
+    return v;
+}
+
+// Parses a whole program once and runs it once, without the REPL echo.
+// With a cache directory, the compiled program is saved as an image and
+// later runs of the same source load that instead of parsing. A loaded
+// image is left in `*image`: values in `env` may still point into it.
+static void run_source(const Source *source, AST *ast, Environment *env, Image *image)
+{
+    // Images hold bytecode: no use to the tree-walker or --dump-ast
+    char path[4096];
+    int cached = cache_dir != NULL && !use_tree_walker && !dump_ast &&
+                 image_path(path, sizeof(path), cache_dir, source) == 0;
+    if (cached)
+    {
+        Chunk chunk;
+        if (image_load(image, path, source, &chunk, env) == 0)
+        {
+            value_free(run_chunk(&chunk, env));
+            chunk_free(&chunk);
+            return;
+        }
+    }
+
+    Lexer lexer;
+    lexer_init(&lexer, env->symbols, source->data, source->length);
+
+    Parser parser;
+    parser_init(&parser, &lexer, ast);
+    NodeId program = parser_parse(&parser);
+    int errors = parser.error_count;
+    parser_free(&parser);
+
+    if (program != AST_NONE)
+    {
+        program = prepare(ast, program, env);
+        int first_function = env->function_count;
+        resolve(ast, program, env);
+        infer_types(ast, program, env);
+        if (profile_path != NULL)
+        {
+            profile_instrument(ast, program);
+            for (int i = first_function; i < env->function_count; i++)
+                profile_instrument(&env->functions[i]->ast, env->functions[i]->body);
+        }
+        // Functions live in the environment, not the chunk, so programs
+        // that define any can't be rebuilt from an image
+        if (env->function_count > 0)
+            cached = 0;
+        if (cached && errors == 0)
+        {
+            // Saved before running, since runtime errors replay anyway
+            Chunk chunk;
+            chunk_init(&chunk);
+            if (compile(ast, program, env, &chunk) == 0)
+            {
+                image_save(path, source, &chunk, env);
+                value_free(run_chunk(&chunk, env));
+            }
+            else
+            {
+                value_free(eval(ast, program, env));
+            }
+            chunk_free(&chunk);
+        }
+        else
+        {
+            Value v = run(ast, program, env);
+            value_free(v);
+        }
+    }
+}
+
+// $LOFY_CACHE_DIR, else ~/.cache/lofy
+static const char *default_cache_dir(void)
+{
+    static char dir[4096];
+    const char *env_dir = getenv("LOFY_CACHE_DIR");
+    if (env_dir != NULL && env_dir[0] != '\0')
+        return env_dir;
+    const char *home = getenv("HOME");
+    if (home == NULL)
+        home = getenv("USERPROFILE");
+    if (home == NULL)
+        return ".lofy-cache";
+    snprintf(dir, sizeof(dir), "%s/.cache/lofy", home);
+    return dir;
+}
+
+// Reads one line into `*buffer`, growing it as needed. Returns the line's
+// length including any newline, or -1 at end of input.
+static int read_line(char **buffer, int *capacity, FILE *stream)
+{
+    int length = 0;
     while (1)
     {
-        printf(">>> ");
-        if (fgets(buffer, sizeof(buffer), stdin) == NULL)
+        if (*capacity - length < 2)
+        {
+            *capacity = *capacity == 0 ? 1024 : *capacity * 2;
+            *buffer = (char *)realloc(*buffer, *capacity);
+        }
+        if (fgets(*buffer + length, *capacity - length, stream) == NULL)
+            return length > 0 ? length : -1;
+        length += (int)strlen(*buffer + length);
+        if ((*buffer)[length - 1] == '\n')
+            return length;
+    }
+}
+
+static void repl(AST *ast, Environment *env)
+{
+    out_printf("LoFy Interpreter v0.1\n");
+    out_printf("Type 'exit' to quit.\n");
+
+    char *buffer = NULL;
+    int capacity = 0;
+    while (1)
+    {
+        out_printf(">>> ");
+        output_flush();
+        int length = read_line(&buffer, &capacity, stdin);
+        if (length < 0)
         {
             break;
         }
@@ -27,45 +212,159 @@ int main(int argc, char **argv)
         }
 
         Lexer lexer;
-        lexer_init(&lexer, buffer);
+        lexer_init(&lexer, env->symbols, buffer, length);
 
         Parser parser;
-        parser_init(&parser, &lexer);
+        ast_reset(ast);
+        parser_init(&parser, &lexer, ast);
 
-        ASTNode *program = parser_parse(&parser);
+        NodeId program = parser_parse(&parser);
+        parser_free(&parser);
 
-        if (program)
+        if (program != AST_NONE)
         {
-            // REPL behavior: if single expression, print result
-            if (program->type == AST_BLOCK && program->block.count == 1)
+            // REPL behavior: if single expression, print result.
+            // Assignments and Print statements shouldn't auto-print. This
+            // is decided on the line as written, before the optimizer can
+            // turn e.g. `if 1: x = 1` into a bare assignment.
+            int echo = 0;
+            ASTNode *block = ast_node(ast, program);
+            if (block->type == AST_BLOCK && block->block.count == 1)
             {
-                ASTNode *stmt = program->block.statements[0];
-                // Check if it's an expression that should be printed
-                // Assignments and Print statements shouldn't auto-print
-                if (stmt->type != AST_ASSIGNMENT && stmt->type != AST_PRINT)
-                {
-                    Value v = eval(stmt, &env);
-                    if (v.type != VAL_NONE)
-                    {
-                        value_print(v);
-                        printf("\n");
-                    }
-                    value_free(v);
-                }
-                else
+                ASTNode *node = ast_node(ast, ast_block_statement(ast, block, 0));
+                echo = node->type != AST_ASSIGNMENT && node->type != AST_PRINT;
+            }
+
+            program = prepare(ast, program, env);
+            resolve(ast, program, env);
+            infer_types(ast, program, env);
+
+            block = ast_node(ast, program);
+            if (echo && block->type == AST_BLOCK && block->block.count == 1)
+            {
+                Value v = run(ast, ast_block_statement(ast, block, 0), env);
+                if (!value_is_none(v))
                 {
-                    Value v = eval(program, &env);
-                    value_free(v);
+                    value_print(v);
+                    out_write("\n", 1);
                 }
+                value_free(v);
             }
             else
             {
-                Value v = eval(program, &env);
+                Value v = run(ast, program, env);
                 value_free(v);
             }
-            ast_free(program);
         }
     }
+    free(buffer);
+}
+
+int main(int argc, char **argv)
+{
+    const char *script = NULL; // NULL for the REPL, "-" for stdin
+    atexit(output_flush);        // Output is buffered until then
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--tree") == 0)
+            use_tree_walker = 1;
+        else if (strcmp(argv[i], "--dump-bytecode") == 0)
+            dump_bytecode = 1;
+        else if (strcmp(argv[i], "--dump-ast") == 0)
+            dump_ast = 1;
+        else if (strcmp(argv[i], "--quicken-stats") == 0)
+            quicken_stats = 1;
+        else if (strcmp(argv[i], "--profile") == 0)
+            profile_path = "lofy.folded";
+        else if (strncmp(argv[i], "--profile=", 10) == 0 && argv[i][10] != '\0')
+            profile_path = argv[i] + 10;
+        else if (strcmp(argv[i], "--cache") == 0)
+            cache_dir = default_cache_dir();
+        else if (strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8] != '\0')
+            cache_dir = argv[i] + 8;
+        else if (strcmp(argv[i], "--batch") == 0 && script == NULL && i + 1 < argc)
+            batch_dir = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            batch_threads = atoi(argv[++i]);
+        else if (strncmp(argv[i], "-j", 2) == 0 && atoi(argv[i] + 2) > 0)
+            batch_threads = atoi(argv[i] + 2);
+        else if (strcmp(argv[i], "--jit") == 0)
+            use_jit = 1;
+        else if (strncmp(argv[i], "--jit-threshold=", 16) == 0 && atoi(argv[i] + 16) > 0)
+            jit_threshold = atoi(argv[i] + 16);
+        else if (script == NULL && batch_dir == NULL && (argv[i][0] != '-' || strcmp(argv[i], "-") == 0))
+            script = argv[i];
+        else
+        {
+            err_printf("Usage: %s [--tree] [--dump-bytecode] [--dump-ast] [--quicken-stats] [--jit] [--jit-threshold=N] [--cache[=dir]] [--profile[=file]] [script.lofy | - | --batch dir [-j N]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Batch scripts run in embedded states, on the bytecode VM
+    if (batch_dir != NULL)
+        return batch_run(batch_dir, batch_threads);
+
+    if (use_jit && !jit_available())
+    {
+        err_printf("Error: The JIT needs x86-64 Linux and a build without NAN_BOXING\n");
+        return 1;
+    }
+
+    SymbolTable symbols;
+    symtab_init(&symbols);
+    Environment env;
+    env_init(&env, &symbols);
+    env.jit_threshold = use_jit ? jit_threshold : 0;
+
+    // One tree recycled for every REPL line
+    AST ast;
+    ast_init(&ast);
+    if (profile_path != NULL)
+    {
+        // Profiling measures eval(), statement by statement
+        ast_track_positions(&ast);
+        use_tree_walker = 1;
+        env.profile = profile_new();
+    }
+
+    Image image = {NULL, 0, 0}; // Set when a script is loaded from the cache
+    int status = 0;
+    if (script == NULL)
+    {
+        repl(&ast, &env);
+    }
+    else
+    {
+        Source source;
+        int loaded = strcmp(script, "-") == 0 ? source_read_stream(&source, stdin)
+                                              : source_open_file(&source, script);
+        if (loaded == 0)
+        {
+            run_source(&source, &ast, &env, &image);
+            if (profile_path != NULL)
+                profile_report(env.profile, &source, strcmp(script, "-") == 0 ? "stdin" : script, profile_path);
+            source_close(&source);
+        }
+        else
+        {
+            status = 1;
+        }
+    }
+
+    if (quicken_stats)
+    {
+        const QuickenStats *stats = &env.quicken;
+        out_printf("; quickening: %ld sites specialized, %ld deoptimized, %ld polymorphic\n",
+               stats->quickened, stats->deoptimized, stats->polymorphic);
+    }
 
-    return 0;
+    ast_free(&ast);
+    profile_free(env.profile);
+    env_free(&env);
+    symtab_free(&symbols);
+    if (image.base != NULL)
+        image_close(&image);
+    return status;
 }
@@ -0,0 +1,868 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "optimizer.h"
+#include "bigint.h"
+#include "infer.h"
+#include "token.h"
+
+typedef struct
+{
+    AST *ast;
+    SymbolTable *symbols;
+    unsigned char *kinds; // sym -> types any assignment may store
+    int kind_count;
+    int hoist_count;      // Numbers the temporaries made by loop hoisting
+    int in_function;      // Optimizing a def body
+    int loop_mutates;     // The loop being hoisted from may change arrays in place
+} Optimizer;
+
+static int is_comparison_op(int op)
+{
+    return op == TOKEN_EQ || op == TOKEN_NEQ || op == TOKEN_LT ||
+           op == TOKEN_GT || op == TOKEN_LE || op == TOKEN_GE;
+}
+
+static int expr_kind(Optimizer *opt, NodeId id)
+{
+    if (id == AST_NONE)
+        return TYPES_NONE;
+
+    ASTNode *node = ast_node(opt->ast, id);
+    switch (node->type)
+    {
+    case AST_INT:
+    case AST_BIGINT:
+        return TYPES_INT;
+    case AST_FLOAT:
+        return TYPES_FLOAT;
+    case AST_STRING:
+        return TYPES_STRING;
+    case AST_ARRAY:
+        return TYPES_ARRAY;
+    case AST_DICT:
+        return TYPES_DICT;
+    case AST_IDENTIFIER:
+    {
+        // Temporaries added by this pass aren't tracked. A def body can
+        // read globals that later programs assign, so nothing is known there.
+        int sym = node->identifier.sym;
+        return sym < opt->kind_count && !opt->in_function ? opt->kinds[sym] : TYPES_ANY;
+    }
+    case AST_BINARY_OP:
+        return types_of_binary(node->op, expr_kind(opt, node->binary.left),
+                               expr_kind(opt, node->binary.right));
+    case AST_ASSIGNMENT:
+        return expr_kind(opt, node->assignment.value);
+    default:
+        // Statements evaluate to None or to a branch's value; stay conservative
+        return TYPES_ANY;
+    }
+}
+
+// Widens the kind of every assigned variable until nothing changes. The
+// result holds for any point of the program, whichever order it runs in.
+// Def bodies are skipped: they only assign their own locals.
+static int collect_kinds(Optimizer *opt, NodeId id)
+{
+    if (id == AST_NONE)
+        return 0;
+
+    ASTNode *node = ast_node(opt->ast, id);
+    switch (node->type)
+    {
+    case AST_ASSIGNMENT:
+    {
+        int changed = collect_kinds(opt, node->assignment.value);
+        node = ast_node(opt->ast, id);
+        int sym = node->assignment.sym;
+        int kind = expr_kind(opt, node->assignment.value);
+        if (sym < opt->kind_count && (opt->kinds[sym] | kind) != opt->kinds[sym])
+        {
+            opt->kinds[sym] |= kind;
+            changed = 1;
+        }
+        return changed;
+    }
+    case AST_BINARY_OP:
+        return collect_kinds(opt, node->binary.left) | collect_kinds(opt, node->binary.right);
+    case AST_IF:
+        return collect_kinds(opt, node->if_stmt.condition) |
+               collect_kinds(opt, node->if_stmt.then_branch) |
+               collect_kinds(opt, node->if_stmt.else_branch);
+    case AST_WHILE:
+        return collect_kinds(opt, node->while_loop.condition) |
+               collect_kinds(opt, node->while_loop.body);
+    case AST_PRINT:
+        return collect_kinds(opt, node->print_stmt.expr);
+    case AST_BLOCK:
+    {
+        int changed = 0;
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            changed |= collect_kinds(opt, ast_block_statement(opt->ast, node, i));
+        }
+        return changed;
+    }
+    case AST_CALL:
+    {
+        int changed = 0;
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            changed |= collect_kinds(opt, ast_call_arg(opt->ast, node, i));
+        }
+        return changed;
+    }
+    case AST_RETURN:
+        return collect_kinds(opt, node->return_stmt.value);
+    case AST_ARRAY:
+    case AST_DICT:
+    {
+        int changed = 0;
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            changed |= collect_kinds(opt, ast_array_item(opt->ast, node, i));
+        }
+        return changed;
+    }
+    case AST_INDEX:
+    case AST_INDEX_ASSIGNMENT:
+        return collect_kinds(opt, node->index.target) | collect_kinds(opt, node->index.index) |
+               collect_kinds(opt, node->index.value);
+    default:
+        return 0;
+    }
+}
+
+static int is_int_literal(ASTNode *node)
+{
+    return node->type == AST_INT || node->type == AST_BIGINT;
+}
+
+static int is_literal(ASTNode *node)
+{
+    return is_int_literal(node) || node->type == AST_FLOAT || node->type == AST_STRING;
+}
+
+static int is_number_literal(ASTNode *node)
+{
+    return is_int_literal(node) || node->type == AST_FLOAT;
+}
+
+// Borrowed: the AST keeps its reference to string and bigint literals
+static Value literal_value(AST *ast, ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_INT:
+        return value_int(ast_int(node));
+    case AST_FLOAT:
+        return value_float(ast_float(ast, node));
+    default:
+        return ast_string(ast, node);
+    }
+}
+
+static double literal_number(AST *ast, ASTNode *node)
+{
+    return value_as_number(literal_value(ast, node));
+}
+
+// True if `op` on these literals would report a division by zero; such
+// expressions are left for run time so the error still appears there.
+static int divides_by_zero(AST *ast, int op, ASTNode *right)
+{
+    return op == TOKEN_DIV && is_number_literal(right) && literal_number(ast, right) == 0.0;
+}
+
+// Folds arithmetic on two number literals. Comparisons are not folded here
+// since there is no bool literal; conditions handle them separately.
+static NodeId fold_binary(Optimizer *opt, NodeId id)
+{
+    AST *ast = opt->ast;
+    ASTNode *node = ast_node(ast, id);
+    ASTNode *left = ast_node(ast, node->binary.left);
+    ASTNode *right = ast_node(ast, node->binary.right);
+    int op = node->op;
+
+    if (!is_number_literal(left) || !is_number_literal(right) || is_comparison_op(op) || op == TOKEN_IN ||
+        divides_by_zero(ast, op, right))
+        return id;
+
+    if (is_int_literal(left) && is_int_literal(right))
+    {
+        // Exact, promoting to a bigint just like the engines would
+        Value result = value_binary_op(op, literal_value(ast, left), literal_value(ast, right));
+        if (value_is_int(result))
+            return ast_create_int(ast, value_as_int(result));
+        if (value_is_bigint(result))
+            return ast_create_bigint(ast, result);
+        value_free(result);
+        return id;
+    }
+
+    double l = literal_number(ast, left);
+    double r = literal_number(ast, right);
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return ast_create_float(ast, l + r);
+    case TOKEN_MINUS:
+        return ast_create_float(ast, l - r);
+    case TOKEN_MUL:
+        return ast_create_float(ast, l * r);
+    case TOKEN_DIV:
+        return ast_create_float(ast, l / r);
+    default:
+        return id;
+    }
+}
+
+// Is `literal` the number `n`, in a form that leaves an operand of kind
+// `kind` unchanged? An int literal keeps ints and floats as they are; a
+// float literal would turn an int into a float.
+static int is_identity_literal(AST *ast, ASTNode *literal, int n, int kind)
+{
+    if (literal->type == AST_INT)
+        return ast_int(literal) == n;
+    if (literal->type == AST_FLOAT)
+        return ast_float(ast, literal) == n && !(kind & ~(TYPES_FLOAT | TYPES_NONE));
+    return 0;
+}
+
+static NodeId simplify_binary(Optimizer *opt, NodeId id)
+{
+    AST *ast = opt->ast;
+    ASTNode *node = ast_node(ast, id);
+    NodeId left_id = node->binary.left;
+    NodeId right_id = node->binary.right;
+    ASTNode *left = ast_node(ast, left_id);
+    ASTNode *right = ast_node(ast, right_id);
+    int left_kind = expr_kind(opt, left_id);
+    int right_kind = expr_kind(opt, right_id);
+
+    // Anything that is not a number makes the whole expression None, so an
+    // identity only holds when the other side is numeric (or None already)
+    int left_number = !(left_kind & ~(TYPES_NUMBER | TYPES_NONE));
+    int right_number = !(right_kind & ~(TYPES_NUMBER | TYPES_NONE));
+    int left_int = !(left_kind & ~(TYPES_INT | TYPES_NONE));
+    int right_int = !(right_kind & ~(TYPES_INT | TYPES_NONE));
+
+    switch (node->op)
+    {
+    case TOKEN_PLUS:
+        // -0.0 + 0 is 0.0, so only ints survive adding zero unchanged
+        if (left_int && is_identity_literal(ast, right, 0, left_kind))
+            return left_id;
+        if (right_int && is_identity_literal(ast, left, 0, right_kind))
+            return right_id;
+        break;
+    case TOKEN_MINUS:
+        if (left_number && is_identity_literal(ast, right, 0, left_kind))
+            return left_id;
+        break;
+    case TOKEN_MUL:
+        if (left_number && is_identity_literal(ast, right, 1, left_kind))
+            return left_id;
+        if (right_number && is_identity_literal(ast, left, 1, right_kind))
+            return right_id;
+        // x*2 -> x+x gives the same result for every type, including None
+        if (left->type == AST_IDENTIFIER && right->type == AST_INT && ast_int(right) == 2)
+            return ast_create_binary(ast, TOKEN_PLUS, left_id, left_id);
+        if (right->type == AST_IDENTIFIER && left->type == AST_INT && ast_int(left) == 2)
+            return ast_create_binary(ast, TOKEN_PLUS, right_id, right_id);
+        break;
+    case TOKEN_DIV:
+        if (left_number && is_identity_literal(ast, right, 1, left_kind))
+            return left_id;
+        break;
+    }
+    return id;
+}
+
+// Returns 1 and sets `*truthy` if the condition's value is known now.
+static int constant_condition(Optimizer *opt, NodeId id, int *truthy)
+{
+    AST *ast = opt->ast;
+    ASTNode *node = ast_node(ast, id);
+
+    if (is_literal(node))
+    {
+        *truthy = value_is_truthy(literal_value(ast, node));
+        return 1;
+    }
+
+    if (node->type == AST_BINARY_OP)
+    {
+        ASTNode *left = ast_node(ast, node->binary.left);
+        ASTNode *right = ast_node(ast, node->binary.right);
+        if (!is_literal(left) || !is_literal(right) || node->op == TOKEN_IN ||
+            divides_by_zero(ast, node->op, right))
+            return 0;
+        Value v = value_binary_op(node->op, literal_value(ast, left), literal_value(ast, right));
+        *truthy = value_is_truthy(v);
+        value_free(v);
+        return 1;
+    }
+    return 0;
+}
+
+// Flags, in `assigned[sym]`, every variable the tree under `id` writes.
+// Index assignments and calls (append(), or a def doing either) change
+// arrays and dicts without writing a variable; they set `loop_mutates`
+// instead.
+static void mark_assigned(Optimizer *opt, NodeId id, unsigned char *assigned)
+{
+    if (id == AST_NONE)
+        return;
+
+    ASTNode *node = ast_node(opt->ast, id);
+    switch (node->type)
+    {
+    case AST_ASSIGNMENT:
+        assigned[node->assignment.sym] = 1;
+        mark_assigned(opt, node->assignment.value, assigned);
+        break;
+    case AST_BINARY_OP:
+        mark_assigned(opt, node->binary.left, assigned);
+        mark_assigned(opt, node->binary.right, assigned);
+        break;
+    case AST_IF:
+        mark_assigned(opt, node->if_stmt.condition, assigned);
+        mark_assigned(opt, node->if_stmt.then_branch, assigned);
+        mark_assigned(opt, node->if_stmt.else_branch, assigned);
+        break;
+    case AST_WHILE:
+        mark_assigned(opt, node->while_loop.condition, assigned);
+        mark_assigned(opt, node->while_loop.body, assigned);
+        break;
+    case AST_PRINT:
+        mark_assigned(opt, node->print_stmt.expr, assigned);
+        break;
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            mark_assigned(opt, ast_block_statement(opt->ast, node, i), assigned);
+        }
+        break;
+    case AST_CALL:
+        opt->loop_mutates = 1;
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            mark_assigned(opt, ast_call_arg(opt->ast, node, i), assigned);
+        }
+        break;
+    case AST_RETURN:
+        mark_assigned(opt, node->return_stmt.value, assigned);
+        break;
+    case AST_ARRAY:
+    case AST_DICT:
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            mark_assigned(opt, ast_array_item(opt->ast, node, i), assigned);
+        }
+        break;
+    case AST_INDEX_ASSIGNMENT:
+        opt->loop_mutates = 1;
+        // fall through
+    case AST_INDEX:
+        mark_assigned(opt, node->index.target, assigned);
+        mark_assigned(opt, node->index.index, assigned);
+        mark_assigned(opt, node->index.value, assigned);
+        break;
+    default:
+        break;
+    }
+}
+
+// An expression can move out of a loop if it reads nothing the loop writes,
+// has no side effect, and builds no value the iterations must not share.
+// Nothing that may make an array or a dict is moved, since each iteration
+// must get its own. Arithmetic is only moved when both operands are
+// numbers, bools or None (which makes None, silently): on arrays it may
+// report a length mismatch, and on strings it may be too long, or stop a
+// concatenation from appending in place (strbuf.c). Divisions are kept
+// unless the divisor is a nonzero literal, and `in` may fail. A variable
+// that may hold an array or a dict is written through any alias by a loop
+// that changes them.
+static int is_invariant(Optimizer *opt, NodeId id, const unsigned char *assigned)
+{
+    ASTNode *node = ast_node(opt->ast, id);
+    switch (node->type)
+    {
+    case AST_INT:
+    case AST_FLOAT:
+    case AST_STRING:
+    case AST_BIGINT:
+        return 1;
+    case AST_IDENTIFIER:
+        if (opt->loop_mutates && (expr_kind(opt, id) & (TYPES_ARRAY | TYPES_DICT)))
+            return 0;
+        return !assigned[node->identifier.sym];
+    case AST_BINARY_OP:
+    {
+        if (node->op == TOKEN_IN)
+            return 0;
+        if (node->op == TOKEN_DIV && (!is_number_literal(ast_node(opt->ast, node->binary.right)) ||
+                                      divides_by_zero(opt->ast, node->op, ast_node(opt->ast, node->binary.right))))
+            return 0;
+        if (expr_kind(opt, id) & (TYPES_ARRAY | TYPES_DICT | TYPES_STRING))
+            return 0;
+        unsigned scalar = TYPES_NUMBER | TYPES_BOOL | TYPES_NONE;
+        if (!is_comparison_op(node->op) &&
+            ((expr_kind(opt, node->binary.left) & ~scalar) || (expr_kind(opt, node->binary.right) & ~scalar)))
+            return 0;
+        return is_invariant(opt, node->binary.left, assigned) &&
+               is_invariant(opt, ast_node(opt->ast, id)->binary.right, assigned);
+    }
+    default:
+        // Array and dict literals and indexing build or share mutable values
+        return 0;
+    }
+}
+
+// Whether evaluating `id` an extra time is harmless: it reads only
+// variables and literals, can't report an error, and builds nothing bigger
+// than a number. Comparisons never fail; arithmetic is only safe on numbers,
+// as strings and arrays can be too long, or of different lengths.
+static int is_repeatable(Optimizer *opt, NodeId id)
+{
+    ASTNode *node = ast_node(opt->ast, id);
+    switch (node->type)
+    {
+    case AST_INT:
+    case AST_FLOAT:
+    case AST_STRING:
+    case AST_BIGINT:
+    case AST_IDENTIFIER:
+        return 1;
+    case AST_BINARY_OP:
+    {
+        if (node->op == TOKEN_IN)
+            return 0;
+        if (node->op == TOKEN_DIV && (!is_number_literal(ast_node(opt->ast, node->binary.right)) ||
+                                      divides_by_zero(opt->ast, node->op, ast_node(opt->ast, node->binary.right))))
+            return 0;
+        unsigned scalar = TYPES_NUMBER | TYPES_BOOL | TYPES_NONE;
+        if (!is_comparison_op(node->op) &&
+            ((expr_kind(opt, node->binary.left) & ~scalar) || (expr_kind(opt, node->binary.right) & ~scalar)))
+            return 0;
+        return is_repeatable(opt, node->binary.left) && is_repeatable(opt, ast_node(opt->ast, id)->binary.right);
+    }
+    default:
+        return 0;
+    }
+}
+
+typedef struct
+{
+    NodeId *items;
+    int count;
+    int capacity;
+} NodeList;
+
+static void node_list_push(NodeList *list, NodeId id)
+{
+    if (list->count >= list->capacity)
+    {
+        list->capacity = list->capacity == 0 ? 8 : list->capacity * 2;
+        list->items = (NodeId *)realloc(list->items, list->capacity * sizeof(NodeId));
+    }
+    list->items[list->count++] = id;
+}
+
+// Replaces each largest invariant binary op under `id` by a temporary and
+// queues the assignment that computes it. Returns the rewritten `id`. Only
+// the parts that run whenever the loop body does are searched: not the
+// branches of an `if`, nor the body of an inner loop, which may never run.
+static NodeId hoist(Optimizer *opt, NodeId id, const unsigned char *assigned, NodeList *hoisted)
+{
+    if (id == AST_NONE)
+        return id;
+
+    AST *ast = opt->ast;
+    ASTNode *node = ast_node(ast, id);
+    switch (node->type)
+    {
+    case AST_BINARY_OP:
+    {
+        if (is_invariant(opt, id, assigned))
+        {
+            char name[32];
+            int length = snprintf(name, sizeof(name), "$hoist%d", opt->hoist_count++);
+            int sym = symbol_intern(opt->symbols, name, length);
+            NodeId assign = ast_create_assignment(ast, sym, id);
+            ast_copy_position(ast, assign, id); // Profiled as part of the loop's line
+            node_list_push(hoisted, assign);
+            return ast_create_identifier(ast, sym);
+        }
+        NodeId left = hoist(opt, node->binary.left, assigned, hoisted);
+        NodeId right = hoist(opt, ast_node(ast, id)->binary.right, assigned, hoisted);
+        node = ast_node(ast, id);
+        node->binary.left = left;
+        node->binary.right = right;
+        return id;
+    }
+    case AST_ASSIGNMENT:
+    {
+        NodeId value = hoist(opt, node->assignment.value, assigned, hoisted);
+        ast_node(ast, id)->assignment.value = value;
+        return id;
+    }
+    case AST_PRINT:
+    {
+        NodeId expr = hoist(opt, node->print_stmt.expr, assigned, hoisted);
+        ast_node(ast, id)->print_stmt.expr = expr;
+        return id;
+    }
+    case AST_IF:
+    {
+        NodeId condition = hoist(opt, node->if_stmt.condition, assigned, hoisted);
+        ast_node(ast, id)->if_stmt.condition = condition;
+        return id;
+    }
+    case AST_WHILE:
+    {
+        NodeId condition = hoist(opt, node->while_loop.condition, assigned, hoisted);
+        ast_node(ast, id)->while_loop.condition = condition;
+        return id;
+    }
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            uint32_t at = ast_node(ast, id)->block.start + i;
+            NodeId stmt = hoist(opt, ast->extra[at], assigned, hoisted);
+            ast->extra[at] = stmt;
+        }
+        return id;
+    case AST_CALL:
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            uint32_t at = ast_node(ast, id)->call.start + i;
+            NodeId arg = hoist(opt, ast->extra[at], assigned, hoisted);
+            ast->extra[at] = arg;
+        }
+        return id;
+    case AST_RETURN:
+    {
+        NodeId value = hoist(opt, node->return_stmt.value, assigned, hoisted);
+        ast_node(ast, id)->return_stmt.value = value;
+        return id;
+    }
+    case AST_ARRAY:
+    case AST_DICT:
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            uint32_t at = ast_node(ast, id)->array.start + i;
+            NodeId item = hoist(opt, ast->extra[at], assigned, hoisted);
+            ast->extra[at] = item;
+        }
+        return id;
+    case AST_INDEX:
+    case AST_INDEX_ASSIGNMENT:
+    {
+        NodeId target = hoist(opt, node->index.target, assigned, hoisted);
+        NodeId index = hoist(opt, ast_node(ast, id)->index.index, assigned, hoisted);
+        NodeId value = hoist(opt, ast_node(ast, id)->index.value, assigned, hoisted);
+        node = ast_node(ast, id);
+        node->index.target = target;
+        node->index.index = index;
+        node->index.value = value;
+        return id;
+    }
+    default:
+        return id;
+    }
+}
+
+// Checks that every write to `sym` under `id` is `sym = sym + <int>`.
+// Counts them in `*count` and returns 0 on any other kind of write.
+static int only_increments(Optimizer *opt, NodeId id, int sym, int *count)
+{
+    if (id == AST_NONE)
+        return 1;
+
+    AST *ast = opt->ast;
+    ASTNode *node = ast_node(ast, id);
+    switch (node->type)
+    {
+    case AST_ASSIGNMENT:
+    {
+        if (node->assignment.sym == sym)
+        {
+            ASTNode *value = ast_node(ast, node->assignment.value);
+            if (value->type != AST_BINARY_OP || value->op != TOKEN_PLUS)
+                return 0;
+            ASTNode *left = ast_node(ast, value->binary.left);
+            ASTNode *right = ast_node(ast, value->binary.right);
+            if (left->type != AST_IDENTIFIER || left->identifier.sym != sym || right->type != AST_INT)
+                return 0;
+            (*count)++;
+            return 1;
+        }
+        return only_increments(opt, node->assignment.value, sym, count);
+    }
+    case AST_BINARY_OP:
+        return only_increments(opt, node->binary.left, sym, count) &&
+               only_increments(opt, node->binary.right, sym, count);
+    case AST_IF:
+        return only_increments(opt, node->if_stmt.condition, sym, count) &&
+               only_increments(opt, node->if_stmt.then_branch, sym, count) &&
+               only_increments(opt, node->if_stmt.else_branch, sym, count);
+    case AST_WHILE:
+        return only_increments(opt, node->while_loop.condition, sym, count) &&
+               only_increments(opt, node->while_loop.body, sym, count);
+    case AST_PRINT:
+        return only_increments(opt, node->print_stmt.expr, sym, count);
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            if (!only_increments(opt, ast_block_statement(ast, node, i), sym, count))
+                return 0;
+        }
+        return 1;
+    case AST_CALL:
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            if (!only_increments(opt, ast_call_arg(ast, node, i), sym, count))
+                return 0;
+        }
+        return 1;
+    case AST_RETURN:
+        return only_increments(opt, node->return_stmt.value, sym, count);
+    default:
+        return 1;
+    }
+}
+
+static LoopForm loop_form(Optimizer *opt, ASTNode *loop, const unsigned char *assigned, int sym_count)
+{
+    AST *ast = opt->ast;
+    ASTNode *test = ast_node(ast, loop->while_loop.condition);
+    if (test->type != AST_BINARY_OP || test->op == TOKEN_EQ || !is_comparison_op(test->op))
+        return LOOP_GENERIC;
+
+    ASTNode *counter = ast_node(ast, test->binary.left);
+    ASTNode *bound = ast_node(ast, test->binary.right);
+    if (counter->type != AST_IDENTIFIER)
+        return LOOP_GENERIC;
+    if (bound->type != AST_INT && bound->type != AST_IDENTIFIER)
+        return LOOP_GENERIC;
+    // Temporaries hoisted just now are past the end of `assigned` and are
+    // only written before the loop
+    if (bound->type == AST_IDENTIFIER && bound->identifier.sym < sym_count &&
+        assigned[bound->identifier.sym])
+        return LOOP_GENERIC;
+
+    int increments = 0;
+    if (!only_increments(opt, loop->while_loop.body, counter->identifier.sym, &increments))
+        return LOOP_GENERIC;
+
+    ASTNode *body = ast_node(ast, loop->while_loop.body);
+    if (body->type == AST_BLOCK && body->block.count == 1)
+        body = ast_node(ast, ast_block_statement(ast, body, 0));
+    if (increments == 1 && body->type == AST_ASSIGNMENT && body->assignment.sym == counter->identifier.sym)
+        return LOOP_COUNTED_BARE;
+    return LOOP_COUNTED;
+}
+
+// Moves invariant expressions out of the loop at `id` and classifies it.
+// Returns the loop, or `if cond: <hoisted assignments; loop>`: the guard
+// keeps a loop that runs zero times from computing anything, so it is
+// only added, and anything hoisted, when the condition can run twice.
+static NodeId optimize_loop(Optimizer *opt, NodeId id)
+{
+    AST *ast = opt->ast;
+    int sym_count = opt->symbols->count;
+    unsigned char *assigned = (unsigned char *)calloc(sym_count > 0 ? sym_count : 1, 1);
+    opt->loop_mutates = 0;
+    mark_assigned(opt, id, assigned);
+
+    // Copied first: hoisting may rewrite the loop's own condition
+    NodeList hoisted = {0};
+    NodeId condition = ast_node(ast, id)->while_loop.condition;
+    if (is_repeatable(opt, condition))
+    {
+        condition = ast_copy_tree(ast, ast, condition);
+        NodeId test = hoist(opt, ast_node(ast, id)->while_loop.condition, assigned, &hoisted);
+        NodeId body = hoist(opt, ast_node(ast, id)->while_loop.body, assigned, &hoisted);
+        ast_node(ast, id)->while_loop.condition = test;
+        ast_node(ast, id)->while_loop.body = body;
+    }
+    ast_node(ast, id)->aux = (uint16_t)loop_form(opt, ast_node(ast, id), assigned, sym_count);
+    free(assigned);
+
+    if (hoisted.count == 0)
+        return id;
+    node_list_push(&hoisted, id);
+    NodeId block = ast_create_block(ast, hoisted.items, hoisted.count);
+    free(hoisted.items);
+    NodeId guard = ast_create_if(ast, condition, block, AST_NONE);
+    ast_copy_position(ast, guard, id);
+    return guard;
+}
+
+static NodeId optimize_node(Optimizer *opt, NodeId id)
+{
+    if (id == AST_NONE)
+        return id;
+
+    AST *ast = opt->ast;
+    ASTNode *node = ast_node(ast, id);
+    switch (node->type)
+    {
+    case AST_BINARY_OP:
+    {
+        NodeId left = optimize_node(opt, node->binary.left);
+        NodeId right = optimize_node(opt, node->binary.right);
+        node = ast_node(ast, id);
+        node->binary.left = left;
+        node->binary.right = right;
+
+        NodeId folded = fold_binary(opt, id);
+        return folded != id ? folded : simplify_binary(opt, id);
+    }
+
+    case AST_ASSIGNMENT:
+    {
+        NodeId value = optimize_node(opt, node->assignment.value);
+        ast_node(ast, id)->assignment.value = value;
+        return id;
+    }
+
+    case AST_PRINT:
+    {
+        NodeId expr = optimize_node(opt, node->print_stmt.expr);
+        ast_node(ast, id)->print_stmt.expr = expr;
+        return id;
+    }
+
+    case AST_IF:
+    {
+        NodeId condition = optimize_node(opt, node->if_stmt.condition);
+        int truthy;
+        if (constant_condition(opt, condition, &truthy))
+        {
+            node = ast_node(ast, id);
+            return optimize_node(opt, truthy ? node->if_stmt.then_branch : node->if_stmt.else_branch);
+        }
+        NodeId then_branch = optimize_node(opt, ast_node(ast, id)->if_stmt.then_branch);
+        NodeId else_branch = optimize_node(opt, ast_node(ast, id)->if_stmt.else_branch);
+        node = ast_node(ast, id);
+        node->if_stmt.condition = condition;
+        node->if_stmt.then_branch = then_branch;
+        node->if_stmt.else_branch = else_branch;
+        return id;
+    }
+
+    case AST_WHILE:
+    {
+        NodeId condition = optimize_node(opt, node->while_loop.condition);
+        int truthy;
+        if (constant_condition(opt, condition, &truthy) && !truthy)
+            return AST_NONE;
+        NodeId body = optimize_node(opt, ast_node(ast, id)->while_loop.body);
+        node = ast_node(ast, id);
+        node->while_loop.condition = condition;
+        node->while_loop.body = body;
+        return optimize_loop(opt, id);
+    }
+
+    case AST_BLOCK:
+    {
+        // Statements are rewritten in place; removed ones are squeezed out
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            NodeId stmt = optimize_node(opt, ast_block_statement(ast, ast_node(ast, id), i));
+            node = ast_node(ast, id);
+            if (stmt != AST_NONE)
+            {
+                ast->extra[node->block.start + kept++] = stmt;
+            }
+        }
+        node->block.count = kept;
+        return id;
+    }
+
+    case AST_CALL:
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            uint32_t at = ast_node(ast, id)->call.start + i;
+            NodeId arg = optimize_node(opt, ast->extra[at]);
+            ast->extra[at] = arg;
+        }
+        return id;
+
+    case AST_RETURN:
+    {
+        NodeId value = optimize_node(opt, node->return_stmt.value);
+        ast_node(ast, id)->return_stmt.value = value;
+        return id;
+    }
+
+    case AST_ARRAY:
+    case AST_DICT:
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            uint32_t at = ast_node(ast, id)->array.start + i;
+            NodeId item = optimize_node(opt, ast->extra[at]);
+            ast->extra[at] = item;
+        }
+        return id;
+
+    case AST_INDEX:
+    case AST_INDEX_ASSIGNMENT:
+    {
+        NodeId target = optimize_node(opt, node->index.target);
+        NodeId index = optimize_node(opt, ast_node(ast, id)->index.index);
+        NodeId value = optimize_node(opt, ast_node(ast, id)->index.value);
+        node = ast_node(ast, id);
+        node->index.target = target;
+        node->index.index = index;
+        node->index.value = value;
+        return id;
+    }
+
+    case AST_DEF:
+    {
+        int outer = opt->in_function;
+        opt->in_function = 1;
+        NodeId body = optimize_node(opt, node->def.body);
+        opt->in_function = outer;
+        ast_node(ast, id)->def.body = body;
+        return id;
+    }
+
+    default:
+        return id;
+    }
+}
+
+NodeId optimize(AST *ast, NodeId id, Environment *env)
+{
+    Optimizer opt;
+    opt.ast = ast;
+    opt.symbols = env->symbols;
+    opt.hoist_count = 0;
+    opt.in_function = 0;
+    opt.loop_mutates = 0;
+    opt.kind_count = env->symbols->count;
+    opt.kinds = (unsigned char *)calloc(opt.kind_count > 0 ? opt.kind_count : 1, 1);
+
+    // Variables start out with whatever they hold before this tree runs
+    for (int sym = 0; sym < opt.kind_count; sym++)
+    {
+        int slot = env_lookup(env, sym);
+        if (slot >= 0)
+            opt.kinds[sym] = (unsigned char)types_of_value(env->values[slot]);
+        else
+            opt.kinds[sym] = TYPES_NONE;
+    }
+    while (collect_kinds(&opt, id))
+    {
+    }
+
+    NodeId result = optimize_node(&opt, id);
+    free(opt.kinds);
+    return result;
+}
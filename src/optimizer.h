@@ -0,0 +1,14 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+#include "eval.h"
+
+// Rewrites the tree under `id` before it is resolved: folds arithmetic on
+// literals, simplifies identities such as x*1 and x+0 where the operand is
+// known to be numeric, and drops branches and loops whose condition is a
+// constant. `env` supplies the values variables hold before the tree runs.
+// Returns the (possibly new) root; observable behavior is unchanged.
+NodeId optimize(AST *ast, NodeId id, Environment *env);
+
+#endif
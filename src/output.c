@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+static _Thread_local Output *current = NULL;
+
+// What an unbound thread writes through: stdout for both
+static _Thread_local Output unbound = {{NULL, NULL}, {NULL, NULL}, NULL, 0};
+
+static Output *active(void)
+{
+    return current != NULL ? current : &unbound;
+}
+
+static void sink_write(const OutputSink *sink, const char *data, size_t length)
+{
+    if (sink->write != NULL)
+    {
+        sink->write(sink->user, data, length);
+        return;
+    }
+#ifdef _WIN32
+    fwrite(data, 1, length, stdout);
+    fflush(stdout);
+#else
+    while (length > 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return; // A closed pipe or full disk; there's nowhere to report it
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+#endif
+}
+
+static void flush(Output *output)
+{
+    if (output->length > 0)
+    {
+        sink_write(&output->out, output->buffer, output->length);
+        output->length = 0;
+    }
+}
+
+Output *output_bind(Output *output)
+{
+    flush(active());
+    Output *previous = current;
+    current = output;
+    return previous;
+}
+
+void output_flush(void)
+{
+    flush(active());
+}
+
+void output_free(Output *output)
+{
+    flush(output);
+    free(output->buffer);
+    output->buffer = NULL;
+}
+
+// Bytes free in the buffer, flushing it first if `length` more don't fit
+static size_t reserve(Output *output, size_t length)
+{
+    if (output->buffer == NULL)
+        output->buffer = (char *)malloc(OUTPUT_BUFFER_SIZE);
+    if (length > OUTPUT_BUFFER_SIZE - output->length)
+        flush(output);
+    return OUTPUT_BUFFER_SIZE - output->length;
+}
+
+void out_write(const char *data, size_t length)
+{
+    Output *output = active();
+    if (reserve(output, length) < length)
+    {
+        sink_write(&output->out, data, length);
+        return;
+    }
+    memcpy(output->buffer + output->length, data, length);
+    output->length += length;
+}
+
+// Formats into a stack buffer, falling back to the heap for long messages
+static void sink_vprintf(const OutputSink *sink, const char *format, va_list args)
+{
+    char buffer[256];
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, copy);
+    va_end(copy);
+    if (length < 0)
+        return;
+    if ((size_t)length < sizeof(buffer))
+    {
+        sink_write(sink, buffer, (size_t)length);
+        return;
+    }
+    char *text = (char *)malloc((size_t)length + 1);
+    vsnprintf(text, (size_t)length + 1, format, args);
+    sink_write(sink, text, (size_t)length);
+    free(text);
+}
+
+// Formats straight into the buffer; only text that doesn't fit the room
+// left is formatted a second time, after a flush
+void out_printf(const char *format, ...)
+{
+    Output *output = active();
+    size_t room = reserve(output, 0);
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(output->buffer + output->length, room, format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+    if ((size_t)length < room)
+    {
+        output->length += (size_t)length;
+        return;
+    }
+
+    flush(output);
+    va_start(args, format);
+    if ((size_t)length < OUTPUT_BUFFER_SIZE)
+    {
+        vsnprintf(output->buffer, OUTPUT_BUFFER_SIZE, format, args);
+        output->length = (size_t)length;
+    }
+    else
+    {
+        sink_vprintf(&output->out, format, args);
+    }
+    va_end(args);
+}
+
+void err_printf(const char *format, ...)
+{
+    Output *output = active();
+    flush(output);
+    va_list args;
+    va_start(args, format);
+    sink_vprintf(&output->err, format, args);
+    va_end(args);
+}
@@ -0,0 +1,49 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include "lofy.h"
+
+// Where program output (print) and diagnostics (syntax, runtime and I/O
+// errors) go. Each thread has its own current pair of sinks: the embedding
+// API binds a state's sinks for the duration of each call, so independent
+// interpreters on different threads never share one. Unbound threads, like
+// the command-line tool's, write both to stdout.
+//
+// Program output is buffered: it reaches its sink when the buffer fills, on
+// output_flush(), just before any diagnostic (so the two stay in order when
+// they share a sink) and whenever the binding changes. Diagnostics are
+// written at once. Output to stdout goes straight to write(2), bypassing
+// stdio, so nothing else should write to stdout through stdio.
+
+// Bytes of program output held back before they are written
+#define OUTPUT_BUFFER_SIZE 65536
+
+typedef struct {
+    lofy_WriteFn write; // NULL for stdout
+    void *user;
+} OutputSink;
+
+typedef struct {
+    OutputSink out;
+    OutputSink err;
+    char *buffer;  // Pending output for `out`; NULL until first written
+    size_t length;
+} Output;
+
+// Makes `output` the calling thread's sinks (NULL for stdout) and returns
+// the previous binding, to be restored with another output_bind(). What
+// the outgoing binding has buffered is flushed first.
+Output *output_bind(Output *output);
+
+// Writes out what the calling thread's current binding has buffered.
+void output_flush(void);
+
+// Flushes `output` and frees its buffer. It must not be bound.
+void output_free(Output *output);
+
+void out_write(const char *data, size_t length);
+void out_printf(const char *format, ...);
+void err_printf(const char *format, ...);
+
+#endif
@@ -2,32 +2,95 @@
 #include <stdlib.h>
 #include <string.h>
 #include "parser.h"
+#include "bigint.h"
+#include "output.h"
 
-void parser_init(Parser *parser, Lexer *lexer)
+void parser_init(Parser *parser, Lexer *lexer, AST *ast)
 {
     parser->lexer = lexer;
-    parser->current_token = lexer_next_token(lexer);
+    parser->ast = ast;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->head = 0;
+    parser->for_count = 0;
+    parser->error_count = 0;
+    parser->depth = 0;
+    parser->in_function = 0;
+    for (int i = 0; i < PARSER_LOOKAHEAD; i++)
+    {
+        parser->tokens[i] = lexer_next_token(lexer);
+    }
+}
+
+void parser_free(Parser *parser)
+{
+    free(parser->scratch);
+    parser->scratch = NULL;
+}
+
+static Token *current(Parser *parser)
+{
+    return &parser->tokens[parser->head];
 }
 
 static void advance(Parser *parser)
 {
-    token_free(parser->current_token);
-    parser->current_token = lexer_next_token(parser->lexer);
+    // Refill the slot being vacated; it becomes the furthest lookahead
+    parser->tokens[parser->head] = lexer_next_token(parser->lexer);
+    parser->head = (parser->head + 1) % PARSER_LOOKAHEAD;
+}
+
+// Converts an integer literal without copying it out of the source.
+// Returns 0 if it doesn't fit a small int; bigint_parse() takes those.
+static int parse_int_literal(const char *text, int length, int64_t *value)
+{
+    int64_t v = 0;
+    for (int i = 0; i < length; i++)
+    {
+        int digit = text[i] - '0';
+        if (v > (VALUE_INT_MAX - digit) / 10)
+            return 0;
+        v = v * 10 + digit;
+    }
+    *value = v;
+    return 1;
+}
+
+static double parse_float_literal(const char *text, int length)
+{
+    // strtod needs a terminator; literals are short, so copy to the stack
+    char buffer[64];
+    if (length < (int)sizeof(buffer))
+    {
+        memcpy(buffer, text, length);
+        buffer[length] = '\0';
+        return strtod(buffer, NULL);
+    }
+    char *copy = (char *)malloc(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    double value = strtod(copy, NULL);
+    free(copy);
+    return value;
 }
 
 static void eat(Parser *parser, TokenType type)
 {
-    if (parser->current_token.type == type)
+    if (current(parser)->type == type)
     {
         advance(parser);
     }
     else
     {
-        printf("Syntax Error: Expected %s, got %s at line %d col %d\n",
+        int line, col;
+        lexer_position(parser->lexer, current(parser)->start, &line, &col);
+        parser->error_count++;
+        err_printf("Syntax Error: Expected %s, got %s at line %d col %d\n",
                token_type_to_string(type),
-               token_type_to_string(parser->current_token.type),
-               parser->current_token.line,
-               parser->current_token.col);
+               token_type_to_string(current(parser)->type),
+               line,
+               col);
         // Basic error recovery: just advance or exit?
         // For now, let's just advance to avoid infinite loops if possible,
         // but often it's better to panic in simple interpreters.
@@ -35,37 +98,143 @@ static void eat(Parser *parser, TokenType type)
     }
 }
 
+// A statement ends at a newline, or at the end of the program
+static void end_statement(Parser *parser)
+{
+    if (current(parser)->type != TOKEN_EOF)
+    {
+        eat(parser, TOKEN_NEWLINE);
+    }
+}
+
 // Forward declarations
-static ASTNode *parse_expression(Parser *parser);
+static NodeId parse_expression(Parser *parser);
 
-static ASTNode *parse_factor(Parser *parser)
+// name(expression, ...)
+static NodeId parse_call(Parser *parser)
 {
-    Token token = parser->current_token;
+    int sym = current(parser)->sym;
+    advance(parser); // eat name
+    advance(parser); // eat '('
+
+    NodeId args[CALL_MAX_ARGS];
+    int count = 0;
+    if (current(parser)->type != TOKEN_RPAREN)
+    {
+        while (1)
+        {
+            if (count == CALL_MAX_ARGS)
+            {
+                parser->error_count++;
+                err_printf("Syntax Error: Too many arguments in call to '%s'\n",
+                           symbol_name(parser->lexer->symbols, sym));
+                return AST_NONE;
+            }
+            args[count++] = parse_expression(parser);
+            if (current(parser)->type != TOKEN_COMMA)
+                break;
+            advance(parser);
+        }
+    }
+    eat(parser, TOKEN_RPAREN);
+    return ast_create_call(parser->ast, sym, args, count);
+}
+
+// [expression, ...]
+static NodeId parse_array(Parser *parser)
+{
+    advance(parser); // eat '['
+
+    NodeId *items = NULL;
+    int count = 0;
+    int capacity = 0;
+    if (current(parser)->type != TOKEN_RBRACKET)
+    {
+        while (1)
+        {
+            if (count >= capacity)
+            {
+                capacity = capacity == 0 ? 8 : capacity * 2;
+                items = (NodeId *)realloc(items, capacity * sizeof(NodeId));
+            }
+            items[count++] = parse_expression(parser);
+            if (current(parser)->type != TOKEN_COMMA)
+                break;
+            advance(parser);
+        }
+    }
+    eat(parser, TOKEN_RBRACKET);
+    NodeId node = ast_create_array(parser->ast, items, count);
+    free(items);
+    return node;
+}
+
+// {key: value, ...}
+static NodeId parse_dict(Parser *parser)
+{
+    advance(parser); // eat '{'
+
+    NodeId *items = NULL;
+    int count = 0;
+    int capacity = 0;
+    if (current(parser)->type != TOKEN_RBRACE)
+    {
+        while (1)
+        {
+            if (count + 2 > capacity)
+            {
+                capacity = capacity == 0 ? 8 : capacity * 2;
+                items = (NodeId *)realloc(items, capacity * sizeof(NodeId));
+            }
+            items[count++] = parse_expression(parser);
+            eat(parser, TOKEN_COLON);
+            items[count++] = parse_expression(parser);
+            if (current(parser)->type != TOKEN_COMMA)
+                break;
+            advance(parser);
+        }
+    }
+    eat(parser, TOKEN_RBRACE);
+    NodeId node = ast_create_dict(parser->ast, items, count);
+    free(items);
+    return node;
+}
+
+static NodeId parse_primary(Parser *parser)
+{
+    Token token = *current(parser);
+    AST *ast = parser->ast;
 
     if (token.type == TOKEN_INT)
     {
-        int val = atoi(token.value);
+        const char *text = token_text(parser->lexer, token);
+        int64_t val;
+        NodeId node = parse_int_literal(text, token.length, &val)
+                          ? ast_create_int(ast, val)
+                          : ast_create_bigint(ast, bigint_parse(text, token.length));
         advance(parser);
-        return ast_create_int(val);
+        return node;
     }
 
     if (token.type == TOKEN_FLOAT)
     {
-        double val = atof(token.value);
+        double val = parse_float_literal(token_text(parser->lexer, token), token.length);
         advance(parser);
-        return ast_create_float(val);
+        return ast_create_float(ast, val);
     }
 
     if (token.type == TOKEN_STRING)
     {
-        ASTNode *node = ast_create_string(token.value);
+        NodeId node = ast_create_string(ast, token_text(parser->lexer, token), token.length);
         advance(parser);
         return node;
     }
 
     if (token.type == TOKEN_IDENTIFIER)
     {
-        ASTNode *node = ast_create_identifier(token.value);
+        if (parser_peek(parser, 1)->type == TOKEN_LPAREN)
+            return parse_call(parser);
+        NodeId node = ast_create_identifier(ast, token.sym);
         advance(parser);
         return node;
     }
@@ -73,86 +242,355 @@ static ASTNode *parse_factor(Parser *parser)
     if (token.type == TOKEN_LPAREN)
     {
         advance(parser);
-        ASTNode *node = parse_expression(parser);
+        NodeId node = parse_expression(parser);
         eat(parser, TOKEN_RPAREN);
         return node;
     }
 
-    printf("Syntax Error: Unexpected token %s in factor\n", token_type_to_string(token.type));
+    if (token.type == TOKEN_LBRACKET)
+    {
+        return parse_array(parser);
+    }
+
+    if (token.type == TOKEN_LBRACE)
+    {
+        return parse_dict(parser);
+    }
+
+    parser->error_count++;
+    err_printf("Syntax Error: Unexpected token %s in factor\n", token_type_to_string(token.type));
     advance(parser);
-    return NULL;
+    return AST_NONE;
+}
+
+// A primary followed by any number of [index] suffixes
+static NodeId parse_factor(Parser *parser)
+{
+    NodeId node = parse_primary(parser);
+
+    while (current(parser)->type == TOKEN_LBRACKET)
+    {
+        advance(parser);
+        NodeId index = parse_expression(parser);
+        eat(parser, TOKEN_RBRACKET);
+        node = ast_create_index(parser->ast, node, index);
+    }
+
+    return node;
 }
 
-static ASTNode *parse_term(Parser *parser)
+static NodeId parse_term(Parser *parser)
 {
-    ASTNode *node = parse_factor(parser);
+    NodeId node = parse_factor(parser);
 
-    while (parser->current_token.type == TOKEN_MUL || parser->current_token.type == TOKEN_DIV)
+    while (current(parser)->type == TOKEN_MUL || current(parser)->type == TOKEN_DIV)
     {
-        TokenType op = parser->current_token.type;
+        TokenType op = current(parser)->type;
         advance(parser);
-        ASTNode *right = parse_factor(parser);
-        node = ast_create_binary(op, node, right);
+        NodeId right = parse_factor(parser);
+        node = ast_create_binary(parser->ast, op, node, right);
     }
 
     return node;
 }
 
-static ASTNode *parse_expression(Parser *parser)
+static NodeId parse_expression(Parser *parser)
 {
-    ASTNode *node = parse_term(parser);
-
-    while (parser->current_token.type == TOKEN_PLUS ||
-           parser->current_token.type == TOKEN_MINUS ||
-           parser->current_token.type == TOKEN_EQ ||
-           parser->current_token.type == TOKEN_NEQ ||
-           parser->current_token.type == TOKEN_LT ||
-           parser->current_token.type == TOKEN_GT ||
-           parser->current_token.type == TOKEN_LE ||
-           parser->current_token.type == TOKEN_GE)
-    {
-        TokenType op = parser->current_token.type;
+    NodeId node = parse_term(parser);
+
+    while (current(parser)->type == TOKEN_PLUS ||
+           current(parser)->type == TOKEN_MINUS ||
+           current(parser)->type == TOKEN_EQ ||
+           current(parser)->type == TOKEN_NEQ ||
+           current(parser)->type == TOKEN_LT ||
+           current(parser)->type == TOKEN_GT ||
+           current(parser)->type == TOKEN_LE ||
+           current(parser)->type == TOKEN_GE ||
+           current(parser)->type == TOKEN_IN)
+    {
+        TokenType op = current(parser)->type;
         advance(parser);
-        ASTNode *right = parse_term(parser);
-        node = ast_create_binary(op, node, right);
+        NodeId right = parse_term(parser);
+        node = ast_create_binary(parser->ast, op, node, right);
     }
 
     return node;
 }
 
-static ASTNode *parse_statement(Parser *parser)
+static NodeId parse_statement(Parser *parser);
+
+// Interns a name the lexer can never produce, for compiler temporaries
+static int hidden_symbol(Parser *parser, const char *prefix, int n)
+{
+    char name[32];
+    int length = snprintf(name, sizeof(name), "$%s%d", prefix, n);
+    return symbol_intern(parser->lexer->symbols, name, length);
+}
+
+// for x in expression: statement, for any expression but a range() call
+//
+// Runs over the elements of an array or the keys of a dict, in insertion
+// order. The hidden builtins (builtins.c) take the sequence as an array
+// once, before the first iteration, so the body may add to a dict freely:
+//
+//     $seq = $items(expression)
+//     $for = 0
+//     $end = $len($seq)
+//     while $for < $end:
+//         x = $seq[$for]
+//         statement
+//         $for = $for + 1
+static NodeId parse_for_each(Parser *parser, int var)
+{
+    AST *ast = parser->ast;
+    SymbolTable *symbols = parser->lexer->symbols;
+    NodeId sequence = parse_expression(parser);
+    eat(parser, TOKEN_COLON);
+
+    int n = parser->for_count++;
+    int seq = hidden_symbol(parser, "seq", n);
+    int counter = hidden_symbol(parser, "for", n);
+    int end = hidden_symbol(parser, "end", n);
+
+    NodeId body = parse_statement(parser);
+
+    NodeId steps[3];
+    steps[0] = ast_create_assignment(ast, var,
+                                     ast_create_index(ast, ast_create_identifier(ast, seq),
+                                                      ast_create_identifier(ast, counter)));
+    steps[1] = body;
+    steps[2] = ast_create_assignment(ast, counter,
+                                     ast_create_binary(ast, TOKEN_PLUS, ast_create_identifier(ast, counter),
+                                                       ast_create_int(ast, 1)));
+    NodeId loop_body = ast_create_block(ast, steps, 3);
+
+    NodeId test = ast_create_binary(ast, TOKEN_LT, ast_create_identifier(ast, counter),
+                                    ast_create_identifier(ast, end));
+
+    NodeId seq_arg = ast_create_identifier(ast, seq);
+    NodeId lowered[4];
+    lowered[0] = ast_create_assignment(ast, seq,
+                                       ast_create_call(ast, symbol_intern(symbols, "$items", 6), &sequence, 1));
+    lowered[1] = ast_create_assignment(ast, counter, ast_create_int(ast, 0));
+    lowered[2] = ast_create_assignment(ast, end,
+                                       ast_create_call(ast, symbol_intern(symbols, "$len", 4), &seq_arg, 1));
+    lowered[3] = ast_create_while(ast, test, loop_body);
+    return ast_create_block(ast, lowered, 4);
+}
+
+// for i in range([start,] stop [, step]): statement
+//
+// Lowered to a counted while loop over hidden variables, so the bounds are
+// evaluated once and assigning to `i` in the body doesn't change the
+// iteration, as with a Python range:
+//
+//     $for = start
+//     $end = stop
+//     while $for < $end:          ($for > $end for a negative step)
+//         i = $for
+//         statement
+//         $for = $for + step
+//
+// The step must be an integer literal, optionally negated, and not zero.
+static NodeId parse_for(Parser *parser)
+{
+    AST *ast = parser->ast;
+    advance(parser); // eat 'for'
+
+    if (current(parser)->type != TOKEN_IDENTIFIER)
+    {
+        parser->error_count++;
+        err_printf("Syntax Error: Expected loop variable after 'for'\n");
+        return AST_NONE;
+    }
+    int var = current(parser)->sym;
+    advance(parser);
+    eat(parser, TOKEN_IN);
+
+    if (current(parser)->type != TOKEN_IDENTIFIER || parser_peek(parser, 1)->type != TOKEN_LPAREN ||
+        strcmp(symbol_name(parser->lexer->symbols, current(parser)->sym), "range") != 0)
+        return parse_for_each(parser, var);
+    advance(parser);
+    eat(parser, TOKEN_LPAREN);
+
+    NodeId start = parse_expression(parser);
+    NodeId stop = AST_NONE;
+    int64_t step = 1;
+    if (current(parser)->type == TOKEN_COMMA)
+    {
+        advance(parser);
+        stop = parse_expression(parser);
+        if (current(parser)->type == TOKEN_COMMA)
+        {
+            advance(parser);
+            int negate = current(parser)->type == TOKEN_MINUS;
+            if (negate)
+                advance(parser);
+            if (current(parser)->type != TOKEN_INT)
+            {
+                parser->error_count++;
+                err_printf("Syntax Error: range() step must be an integer literal\n");
+                return AST_NONE;
+            }
+            Token token = *current(parser);
+            if (!parse_int_literal(token_text(parser->lexer, token), token.length, &step))
+            {
+                parser->error_count++;
+                err_printf("Syntax Error: range() step is too large\n");
+                return AST_NONE;
+            }
+            if (negate)
+                step = -step;
+            advance(parser);
+            if (step == 0)
+            {
+                parser->error_count++;
+                err_printf("Syntax Error: range() step must not be zero\n");
+                return AST_NONE;
+            }
+        }
+    }
+    else
+    {
+        // range(stop) counts from zero
+        stop = start;
+        start = ast_create_int(ast, 0);
+    }
+    eat(parser, TOKEN_RPAREN);
+    eat(parser, TOKEN_COLON);
+
+    int n = parser->for_count++;
+    int counter = hidden_symbol(parser, "for", n);
+    int end = hidden_symbol(parser, "end", n);
+
+    NodeId body = parse_statement(parser);
+
+    NodeId steps[3];
+    steps[0] = ast_create_assignment(ast, var, ast_create_identifier(ast, counter));
+    steps[1] = body;
+    steps[2] = ast_create_assignment(ast, counter,
+                                     ast_create_binary(ast, TOKEN_PLUS, ast_create_identifier(ast, counter),
+                                                       ast_create_int(ast, step)));
+    NodeId loop_body = ast_create_block(ast, steps, 3);
+
+    NodeId test = ast_create_binary(ast, step > 0 ? TOKEN_LT : TOKEN_GT,
+                                    ast_create_identifier(ast, counter), ast_create_identifier(ast, end));
+
+    NodeId lowered[3];
+    lowered[0] = ast_create_assignment(ast, counter, start);
+    lowered[1] = ast_create_assignment(ast, end, stop);
+    lowered[2] = ast_create_while(ast, test, loop_body);
+    return ast_create_block(ast, lowered, 3);
+}
+
+// def name(param, ...): statement
+//
+// Only at the top level. The body is one statement, like any other, and
+// may span lines: `if n < 2: return n` on one, `else: ...` on the next.
+static NodeId parse_def(Parser *parser)
+{
+    advance(parser); // eat 'def'
+    if (parser->depth > 1)
+    {
+        parser->error_count++;
+        err_printf("Syntax Error: Functions can only be defined at the top level\n");
+        return AST_NONE;
+    }
+    if (current(parser)->type != TOKEN_IDENTIFIER)
+    {
+        parser->error_count++;
+        err_printf("Syntax Error: Expected function name after 'def'\n");
+        return AST_NONE;
+    }
+    int sym = current(parser)->sym;
+    advance(parser);
+    eat(parser, TOKEN_LPAREN);
+
+    int params[CALL_MAX_ARGS];
+    int count = 0;
+    while (current(parser)->type == TOKEN_IDENTIFIER)
+    {
+        int param = current(parser)->sym;
+        for (int i = 0; i < count; i++)
+        {
+            if (params[i] == param)
+            {
+                parser->error_count++;
+                err_printf("Syntax Error: Duplicate parameter '%s'\n", symbol_name(parser->lexer->symbols, param));
+                return AST_NONE;
+            }
+        }
+        if (count == CALL_MAX_ARGS)
+        {
+            parser->error_count++;
+            err_printf("Syntax Error: Too many parameters for '%s'\n", symbol_name(parser->lexer->symbols, sym));
+            return AST_NONE;
+        }
+        params[count++] = param;
+        advance(parser);
+        if (current(parser)->type != TOKEN_COMMA)
+            break;
+        advance(parser);
+    }
+    eat(parser, TOKEN_RPAREN);
+    eat(parser, TOKEN_COLON);
+
+    parser->in_function = 1;
+    NodeId body = parse_statement(parser);
+    parser->in_function = 0;
+    return ast_create_def(parser->ast, sym, params, count, body);
+}
+
+// return [expression]
+static NodeId parse_return(Parser *parser)
+{
+    advance(parser); // eat 'return'
+    if (!parser->in_function)
+    {
+        parser->error_count++;
+        err_printf("Syntax Error: 'return' outside function\n");
+        return AST_NONE;
+    }
+    NodeId value = AST_NONE;
+    if (current(parser)->type != TOKEN_NEWLINE && current(parser)->type != TOKEN_EOF)
+        value = parse_expression(parser);
+    end_statement(parser);
+    return ast_create_return(parser->ast, value);
+}
+
+static NodeId parse_bare_statement(Parser *parser)
 {
     // Handle empty lines
-    while (parser->current_token.type == TOKEN_NEWLINE)
+    while (current(parser)->type == TOKEN_NEWLINE)
     {
         advance(parser);
     }
 
-    if (parser->current_token.type == TOKEN_PRINT)
+    if (current(parser)->type == TOKEN_PRINT)
     {
         advance(parser);
         eat(parser, TOKEN_LPAREN);
-        ASTNode *expr = parse_expression(parser);
+        NodeId expr = parse_expression(parser);
         eat(parser, TOKEN_RPAREN);
 
         // Handle optional newline
-        if (parser->current_token.type == TOKEN_NEWLINE)
+        if (current(parser)->type == TOKEN_NEWLINE)
         {
             eat(parser, TOKEN_NEWLINE);
         }
 
-        return ast_create_print(expr);
+        return ast_create_print(parser->ast, expr);
     }
 
-    if (parser->current_token.type == TOKEN_IF)
+    if (current(parser)->type == TOKEN_IF)
     {
         advance(parser); // eat 'if'
-        ASTNode *condition = parse_expression(parser);
+        NodeId condition = parse_expression(parser);
         eat(parser, TOKEN_COLON);
 
         // For now, simple single-line block
-        ASTNode *then_branch = parse_statement(parser);
-        ASTNode *else_branch = NULL;
+        NodeId then_branch = parse_statement(parser);
+        NodeId else_branch = AST_NONE;
 
         // Check for else
         // This is tricky because parse_statement might have consumed the newline
@@ -164,108 +602,149 @@ static ASTNode *parse_statement(Parser *parser)
         // But parse_statement (recursively) handles empty lines at the start.
         // So we just check if current token is ELSE.
 
-        if (parser->current_token.type == TOKEN_ELSE)
+        if (current(parser)->type == TOKEN_ELSE)
         {
             advance(parser);
             eat(parser, TOKEN_COLON);
             else_branch = parse_statement(parser);
         }
 
-        return ast_create_if(condition, then_branch, else_branch);
+        return ast_create_if(parser->ast, condition, then_branch, else_branch);
     }
 
-    if (parser->current_token.type == TOKEN_WHILE)
+    if (current(parser)->type == TOKEN_WHILE)
     {
         advance(parser); // eat 'while'
-        ASTNode *condition = parse_expression(parser);
+        NodeId condition = parse_expression(parser);
         eat(parser, TOKEN_COLON);
-        ASTNode *body = parse_statement(parser);
-        return ast_create_while(condition, body);
+        NodeId body = parse_statement(parser);
+        return ast_create_while(parser->ast, condition, body);
     }
 
-    if (parser->current_token.type == TOKEN_IDENTIFIER)
+    if (current(parser)->type == TOKEN_FOR)
     {
-        // Check lookahead for assignment
-        // Since we don't have lookahead buffer, we have to cheat or refactor.
-        // Or we can parse identifier, then check next token.
-        // But parse_expression consumes the identifier.
-        // So we can parse_expression, and if the result is an IDENTIFIER node,
-        // and the next token is =, then we convert it to assignment.
-
-        // This is a bit tricky with pure recursive descent without lookahead.
-        // Let's implement a "save" or just parse expression and see.
-        // If we parse "x", we get Identifier Node.
-        // Then we see "=".
+        return parse_for(parser);
+    }
 
-        // But parse_expression parses "x + 1".
-        // If we have "x = 1", parse_expression will parse "x" and stop at "=".
+    if (current(parser)->type == TOKEN_DEF)
+    {
+        return parse_def(parser);
+    }
 
-        ASTNode *expr = parse_expression(parser);
+    if (current(parser)->type == TOKEN_RETURN)
+    {
+        return parse_return(parser);
+    }
 
-        if (parser->current_token.type == TOKEN_ASSIGN)
+    if (current(parser)->type == TOKEN_IDENTIFIER)
+    {
+        if (parser_peek(parser, 1)->type == TOKEN_ASSIGN)
         {
-            if (expr->type != AST_IDENTIFIER)
-            {
-                printf("Syntax Error: Cannot assign to non-identifier\n");
-                // Cleanup
-                return NULL;
-            }
+            int sym = current(parser)->sym;
+            advance(parser); // eat identifier
+            advance(parser); // eat '='
 
-            char *name = strdup(expr->string_val);
-            ast_free(expr); // Free the identifier node as we are replacing it
+            NodeId value = parse_expression(parser);
+            end_statement(parser);
 
-            advance(parser); // eat '='
+            return ast_create_assignment(parser->ast, sym, value);
+        }
 
-            ASTNode *value = parse_expression(parser);
-            eat(parser, TOKEN_NEWLINE);
+        NodeId expr = parse_expression(parser);
 
-            ASTNode *assign = ast_create_assignment(name, value);
-            free(name);
-            return assign;
+        if (current(parser)->type == TOKEN_ASSIGN)
+        {
+            // target[index] = expression
+            ASTNode target = *ast_node(parser->ast, expr);
+            if (expr == AST_NONE || target.type != AST_INDEX)
+            {
+                parser->error_count++;
+                err_printf("Syntax Error: Cannot assign to non-identifier\n");
+                return AST_NONE;
+            }
+            advance(parser); // eat '='
+            NodeId value = parse_expression(parser);
+            end_statement(parser);
+            return ast_create_index_assignment(parser->ast, target.index.target, target.index.index, value);
         }
 
         // It was just an expression statement (e.g. "x + 1" or function call)
         // Consume newline
-        if (parser->current_token.type == TOKEN_NEWLINE)
+        if (current(parser)->type == TOKEN_NEWLINE)
         {
             advance(parser);
         }
-        else if (parser->current_token.type != TOKEN_EOF)
+        else if (current(parser)->type != TOKEN_EOF)
         {
-            printf("Syntax Error: Expected newline after expression\n");
+            parser->error_count++;
+            err_printf("Syntax Error: Expected newline after expression\n");
         }
 
         return expr;
     }
 
     // Fallback for other expressions
-    if (parser->current_token.type == TOKEN_EOF)
-        return NULL;
+    if (current(parser)->type == TOKEN_EOF)
+        return AST_NONE;
 
-    ASTNode *expr = parse_expression(parser);
-    if (parser->current_token.type == TOKEN_NEWLINE)
+    NodeId expr = parse_expression(parser);
+    if (current(parser)->type == TOKEN_NEWLINE)
     {
         advance(parser);
     }
     return expr;
 }
 
-ASTNode *parser_parse(Parser *parser)
+// When the tree tracks positions, every node of the statement that a nested
+// statement hasn't already claimed is tagged with where the statement starts
+static NodeId parse_statement(Parser *parser)
+{
+    AST *ast = parser->ast;
+    NodeId stmt;
+    parser->depth++;
+    if (ast->positions == NULL)
+    {
+        stmt = parse_bare_statement(parser);
+    }
+    else
+    {
+        while (current(parser)->type == TOKEN_NEWLINE)
+        {
+            advance(parser);
+        }
+        int line, col;
+        lexer_position(parser->lexer, current(parser)->start, &line, &col);
+        SourcePos pos = {(uint32_t)line, (uint32_t)col};
+
+        NodeId first = ast->count;
+        stmt = parse_bare_statement(parser);
+        ast_fill_positions(ast, first, pos);
+    }
+    parser->depth--;
+    return stmt;
+}
+
+NodeId parser_parse(Parser *parser)
 {
-    ASTNode *block = ast_create_block();
+    parser->scratch_count = 0;
 
-    while (parser->current_token.type != TOKEN_EOF)
+    while (current(parser)->type != TOKEN_EOF)
     {
-        if (parser->current_token.type == TOKEN_NEWLINE)
+        if (current(parser)->type == TOKEN_NEWLINE)
         {
             advance(parser);
             continue;
         }
 
-        ASTNode *stmt = parse_statement(parser);
-        if (stmt)
+        NodeId stmt = parse_statement(parser);
+        if (stmt != AST_NONE)
         {
-            ast_block_add(block, stmt);
+            if (parser->scratch_count >= parser->scratch_capacity)
+            {
+                parser->scratch_capacity = parser->scratch_capacity == 0 ? 16 : parser->scratch_capacity * 2;
+                parser->scratch = (NodeId *)realloc(parser->scratch, parser->scratch_capacity * sizeof(NodeId));
+            }
+            parser->scratch[parser->scratch_count++] = stmt;
         }
         else
         {
@@ -274,5 +753,5 @@ ASTNode *parser_parse(Parser *parser)
         }
     }
 
-    return block;
+    return ast_create_block(parser->ast, parser->scratch, parser->scratch_count);
 }
@@ -4,12 +4,33 @@
 #include "lexer.h"
 #include "ast.h"
 
+// Tokens buffered ahead of the parser, including the current one
+#define PARSER_LOOKAHEAD 4
+
 typedef struct {
     Lexer *lexer;
-    Token current_token;
+    Token tokens[PARSER_LOOKAHEAD]; // Ring buffer, current token at `head`
+    int head;
+    AST *ast; // Where nodes are emitted
+    int for_count; // Numbers the hidden variables of each `for` loop
+    int error_count; // Syntax errors reported so far
+    int depth; // Statements being parsed, counting enclosing ones
+    int in_function; // Inside a def body, where return is allowed
+
+    // Statements of the block being parsed
+    NodeId *scratch;
+    int scratch_count;
+    int scratch_capacity;
 } Parser;
 
-void parser_init(Parser *parser, Lexer *lexer);
-ASTNode* parser_parse(Parser *parser); // Returns a Block node containing all statements
+void parser_init(Parser *parser, Lexer *lexer, AST *ast);
+void parser_free(Parser *parser);
+NodeId parser_parse(Parser *parser); // Returns a Block node containing all statements
+
+// The token `k` positions after the current one, 0 <= k < PARSER_LOOKAHEAD.
+static inline Token *parser_peek(Parser *parser, int k)
+{
+    return &parser->tokens[(parser->head + k) % PARSER_LOOKAHEAD];
+}
 
 #endif
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "profile.h"
+#include "output.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_UNIT "cycles"
+static inline uint64_t profile_clock(void)
+{
+    return __rdtsc();
+}
+#else
+#include <time.h>
+#define PROFILE_UNIT "ns"
+static inline uint64_t profile_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+typedef struct {
+    long count;
+    uint64_t inclusive;
+    uint64_t exclusive;
+    int active; // Frames for this line currently on the stack
+} LineStats;
+
+// Calling-context tree: one node per distinct stack of statement lines,
+// node 0 being the program itself
+typedef struct {
+    int line;
+    int parent;
+    int first_child;
+    int next_sibling;
+    uint64_t exclusive;
+} StackNode;
+
+typedef struct {
+    int node;
+    uint64_t start;
+    uint64_t children; // Time spent in nested statements
+} Frame;
+
+struct Profile {
+    LineStats *lines; // Indexed by line
+    int line_capacity;
+
+    StackNode *nodes;
+    int node_count;
+    int node_capacity;
+
+    Frame *frames;
+    int depth;
+    int frame_capacity;
+};
+
+Profile *profile_new(void)
+{
+    Profile *p = (Profile *)calloc(1, sizeof(Profile));
+    p->node_capacity = 64;
+    p->nodes = (StackNode *)calloc(p->node_capacity, sizeof(StackNode));
+    p->nodes[0].first_child = -1;
+    p->nodes[0].parent = -1;
+    p->node_count = 1;
+    return p;
+}
+
+void profile_free(Profile *p)
+{
+    if (p == NULL)
+        return;
+    free(p->lines);
+    free(p->nodes);
+    free(p->frames);
+    free(p);
+}
+
+// ---------------------------------------------------------------------------
+// Instrumentation
+
+static void instrument_statement(AST *ast, NodeId id);
+
+static void instrument_children(AST *ast, NodeId id)
+{
+    ASTNode *node = ast_node(ast, id);
+    switch (node->type)
+    {
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            instrument_statement(ast, ast_block_statement(ast, ast_node(ast, id), i));
+        }
+        break;
+    case AST_IF:
+    {
+        NodeId then_branch = node->if_stmt.then_branch;
+        NodeId else_branch = node->if_stmt.else_branch;
+        instrument_statement(ast, then_branch);
+        if (else_branch != AST_NONE)
+            instrument_statement(ast, else_branch);
+        break;
+    }
+    case AST_WHILE:
+        // The bare counted form reads its increment straight out of the
+        // body, so it has to run the body through eval() to be measured
+        if (node->aux == LOOP_COUNTED_BARE)
+            node->aux = LOOP_COUNTED;
+        instrument_statement(ast, node->while_loop.body);
+        break;
+    default:
+        break;
+    }
+}
+
+static void instrument_statement(AST *ast, NodeId id)
+{
+    if (id == AST_NONE)
+        return;
+    instrument_children(ast, id);
+    if (ast_node(ast, id)->type != AST_BLOCK)
+        ast_wrap_profile(ast, id);
+}
+
+void profile_instrument(AST *ast, NodeId id)
+{
+    instrument_statement(ast, id);
+}
+
+// ---------------------------------------------------------------------------
+// Recording
+
+static int stack_child(Profile *p, int parent, int line)
+{
+    for (int n = p->nodes[parent].first_child; n >= 0; n = p->nodes[n].next_sibling)
+    {
+        if (p->nodes[n].line == line)
+            return n;
+    }
+
+    if (p->node_count >= p->node_capacity)
+    {
+        p->node_capacity *= 2;
+        p->nodes = (StackNode *)realloc(p->nodes, p->node_capacity * sizeof(StackNode));
+    }
+    int n = p->node_count++;
+    StackNode *node = &p->nodes[n];
+    node->line = line;
+    node->parent = parent;
+    node->first_child = -1;
+    node->next_sibling = p->nodes[parent].first_child;
+    node->exclusive = 0;
+    p->nodes[parent].first_child = n;
+    return n;
+}
+
+void profile_enter(Profile *p, int line)
+{
+    if (line >= p->line_capacity)
+    {
+        int capacity = p->line_capacity == 0 ? 64 : p->line_capacity;
+        while (capacity <= line)
+            capacity *= 2;
+        p->lines = (LineStats *)realloc(p->lines, capacity * sizeof(LineStats));
+        memset(p->lines + p->line_capacity, 0, (capacity - p->line_capacity) * sizeof(LineStats));
+        p->line_capacity = capacity;
+    }
+    if (p->depth >= p->frame_capacity)
+    {
+        p->frame_capacity = p->frame_capacity == 0 ? 64 : p->frame_capacity * 2;
+        p->frames = (Frame *)realloc(p->frames, p->frame_capacity * sizeof(Frame));
+    }
+
+    int parent = p->depth > 0 ? p->frames[p->depth - 1].node : 0;
+    Frame *frame = &p->frames[p->depth++];
+    frame->node = stack_child(p, parent, line);
+    frame->children = 0;
+    p->lines[line].count++;
+    p->lines[line].active++;
+    // Read last, so the bookkeeping above is charged to the parent
+    frame->start = profile_clock();
+}
+
+void profile_exit(Profile *p)
+{
+    uint64_t now = profile_clock();
+    Frame *frame = &p->frames[--p->depth];
+    uint64_t elapsed = now - frame->start;
+    uint64_t self = elapsed > frame->children ? elapsed - frame->children : 0;
+
+    StackNode *node = &p->nodes[frame->node];
+    LineStats *stats = &p->lines[node->line];
+    node->exclusive += self;
+    stats->exclusive += self;
+    if (--stats->active == 0)
+        stats->inclusive += elapsed;
+    if (p->depth > 0)
+        p->frames[p->depth - 1].children += elapsed;
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+
+typedef struct {
+    int line;
+    const LineStats *stats;
+} LineEntry;
+
+static int compare_lines(const void *a, const void *b)
+{
+    const LineEntry *x = (const LineEntry *)a;
+    const LineEntry *y = (const LineEntry *)b;
+    if (x->stats->exclusive != y->stats->exclusive)
+        return x->stats->exclusive < y->stats->exclusive ? 1 : -1;
+    return x->line - y->line;
+}
+
+// Start offsets of each line of the source, 1-based
+static int *line_starts(const Source *source, int *count)
+{
+    int capacity = 64;
+    int *starts = (int *)malloc(capacity * sizeof(int));
+    int n = 1;
+    starts[1] = 0;
+    for (int i = 0; i < source->length; i++)
+    {
+        if (source->data[i] != '\n')
+            continue;
+        if (n + 1 >= capacity)
+        {
+            capacity *= 2;
+            starts = (int *)realloc(starts, capacity * sizeof(int));
+        }
+        starts[++n] = i + 1;
+    }
+    *count = n;
+    return starts;
+}
+
+static void print_line_text(const Source *source, const int *starts, int line_count, int line)
+{
+    if (line < 1 || line > line_count)
+        return;
+    const char *text = source->data + starts[line];
+    const char *end = source->data + source->length;
+    int length = 0;
+    while (text + length < end && text[length] != '\n' && text[length] != '\r')
+        length++;
+    while (length > 0 && (*text == ' ' || *text == '\t'))
+    {
+        text++;
+        length--;
+    }
+    if (length > 60)
+        length = 60;
+    out_printf("  %.*s", length, text);
+}
+
+static void write_stack(FILE *file, const Profile *p, const char *name, int n)
+{
+    if (p->nodes[n].parent > 0)
+    {
+        write_stack(file, p, name, p->nodes[n].parent);
+        fputc(';', file);
+    }
+    fprintf(file, "%s:%d", name, p->nodes[n].line);
+}
+
+void profile_report(const Profile *p, const Source *source, const char *name, const char *folded_path)
+{
+    LineEntry *order = (LineEntry *)malloc((p->line_capacity + 1) * sizeof(LineEntry));
+    int count = 0;
+    uint64_t total = 0;
+    long statements = 0;
+    for (int line = 0; line < p->line_capacity; line++)
+    {
+        if (p->lines[line].count == 0)
+            continue;
+        order[count].line = line;
+        order[count].stats = &p->lines[line];
+        count++;
+        total += p->lines[line].exclusive;
+        statements += p->lines[line].count;
+    }
+    qsort(order, count, sizeof(LineEntry), compare_lines);
+
+    int line_count;
+    int *starts = line_starts(source, &line_count);
+    out_printf("; profile: %llu %s, %ld statements on %d lines\n",
+               (unsigned long long)total, PROFILE_UNIT, statements, count);
+    out_printf(";  line        count       inclusive       exclusive   self%%\n");
+    for (int i = 0; i < count; i++)
+    {
+        const LineStats *stats = order[i].stats;
+        out_printf("; %5d %12ld %15llu %15llu  %5.1f%%", order[i].line, stats->count,
+                   (unsigned long long)stats->inclusive, (unsigned long long)stats->exclusive,
+                   total > 0 ? 100.0 * (double)stats->exclusive / (double)total : 0.0);
+        print_line_text(source, starts, line_count, order[i].line);
+        out_write("\n", 1);
+    }
+    free(starts);
+    free(order);
+
+    FILE *file = fopen(folded_path, "w");
+    if (file == NULL)
+    {
+        err_printf("Error: Could not write profile to '%s'\n", folded_path);
+        return;
+    }
+    for (int n = 1; n < p->node_count; n++)
+    {
+        if (p->nodes[n].exclusive == 0)
+            continue;
+        write_stack(file, p, name, n);
+        fprintf(file, " %llu\n", (unsigned long long)p->nodes[n].exclusive);
+    }
+    fclose(file);
+    out_printf("; folded stacks written to %s\n", folded_path);
+}
@@ -0,0 +1,34 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "ast.h"
+#include "source.h"
+
+// Line-level profiler for the tree-walker (--profile). profile_instrument()
+// wraps every statement of a resolved tree in an AST_PROFILE node, and
+// eval() reports entering and leaving those; trees that were never
+// instrumented contain no such nodes and run exactly as before.
+//
+// Per source line it counts executions and inclusive/exclusive time, read
+// from the CPU cycle counter where there is one. Time spent in a nested
+// statement on the same line counts once towards inclusive time.
+
+// Measurements of one run, attached to the environment it runs in.
+typedef struct Profile Profile;
+
+Profile *profile_new(void);
+void profile_free(Profile *profile);
+
+// Needs a tree parsed with ast_track_positions() on, after infer_types().
+// `id` is a program's block or a function body.
+void profile_instrument(AST *ast, NodeId id);
+
+void profile_enter(Profile *profile, int line);
+void profile_exit(Profile *profile);
+
+// Prints the lines of `source` sorted by exclusive time and writes their
+// statement stacks to `folded_path`, one "frame;frame;... weight" line per
+// stack, as flamegraph.pl and speedscope read them. `name` labels frames.
+void profile_report(const Profile *profile, const Source *source, const char *name, const char *folded_path);
+
+#endif
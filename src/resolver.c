@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include "resolver.h"
+
+typedef struct
+{
+    AST *ast;
+    Environment *env;
+    Function *function; // Being resolved, or NULL at the top level
+    int *local_of;      // symbol -> frame slot in `function`, -1 for globals
+    int local_of_capacity;
+} Resolver;
+
+static void resolve_node(Resolver *r, NodeId id);
+
+// Python's rule: a name the body assigns anywhere is local throughout it
+static void collect_locals(Resolver *r, NodeId id)
+{
+    if (id == AST_NONE)
+        return;
+
+    ASTNode *node = ast_node(r->ast, id);
+    switch (node->type)
+    {
+    case AST_ASSIGNMENT:
+    {
+        int sym = node->assignment.sym;
+        if (r->local_of[sym] < 0)
+            r->local_of[sym] = r->function->local_count++;
+        break;
+    }
+    case AST_IF:
+        collect_locals(r, node->if_stmt.then_branch);
+        collect_locals(r, node->if_stmt.else_branch);
+        break;
+    case AST_WHILE:
+        collect_locals(r, node->while_loop.body);
+        break;
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            collect_locals(r, ast_block_statement(r->ast, node, i));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Copies the body of the def at `id` into a new function, resolves the copy
+// against the function's own frame, and leaves the def node holding the
+// function's index for the engines to bind the name to when it runs
+static void resolve_def(Resolver *r, NodeId id)
+{
+    Environment *env = r->env;
+    ASTNode node = *ast_node(r->ast, id);
+    int index = env_new_function(env, node.def.sym);
+    Function *fn = env->functions[index];
+    fn->param_count = node.aux;
+    fn->body = ast_copy_tree(&fn->ast, r->ast, node.def.body);
+
+    Resolver inner;
+    inner.ast = &fn->ast;
+    inner.env = env;
+    inner.function = fn;
+    inner.local_of_capacity = env->symbols->count;
+    inner.local_of = (int *)malloc((inner.local_of_capacity > 0 ? inner.local_of_capacity : 1) * sizeof(int));
+    for (int sym = 0; sym < inner.local_of_capacity; sym++)
+    {
+        inner.local_of[sym] = -1;
+    }
+    for (int i = 0; i < fn->param_count; i++)
+    {
+        inner.local_of[ast_def_param(r->ast, &node, i)] = fn->local_count++;
+    }
+    collect_locals(&inner, fn->body);
+    resolve_node(&inner, fn->body);
+    free(inner.local_of);
+    ast_node(r->ast, id)->def.function = index;
+}
+
+static void resolve_node(Resolver *r, NodeId id)
+{
+    if (id == AST_NONE)
+        return;
+
+    ASTNode *node = ast_node(r->ast, id);
+    switch (node->type)
+    {
+    case AST_IDENTIFIER:
+    {
+        int sym = node->identifier.sym;
+        if (r->function != NULL && r->local_of[sym] >= 0)
+        {
+            node->type = AST_LOCAL;
+            node->identifier.slot = r->local_of[sym];
+        }
+        else
+        {
+            node->identifier.slot = env_define(r->env, sym);
+        }
+        break;
+    }
+    case AST_ASSIGNMENT:
+        if (r->function != NULL)
+        {
+            node->type = AST_LOCAL_ASSIGNMENT;
+            node->assignment.slot = r->local_of[node->assignment.sym];
+        }
+        else
+        {
+            node->assignment.slot = env_define(r->env, node->assignment.sym);
+        }
+        resolve_node(r, node->assignment.value);
+        break;
+    case AST_BINARY_OP:
+        resolve_node(r, node->binary.left);
+        resolve_node(r, node->binary.right);
+        break;
+    case AST_IF:
+        resolve_node(r, node->if_stmt.condition);
+        resolve_node(r, node->if_stmt.then_branch);
+        resolve_node(r, node->if_stmt.else_branch);
+        break;
+    case AST_WHILE:
+        resolve_node(r, node->while_loop.condition);
+        resolve_node(r, node->while_loop.body);
+        break;
+    case AST_PRINT:
+        resolve_node(r, node->print_stmt.expr);
+        break;
+    case AST_BLOCK:
+        for (uint32_t i = 0; i < node->block.count; i++)
+        {
+            resolve_node(r, ast_block_statement(r->ast, node, i));
+        }
+        break;
+    case AST_CALL:
+        for (uint32_t i = 0; i < node->call.count; i++)
+        {
+            resolve_node(r, ast_call_arg(r->ast, node, i));
+        }
+        break;
+    case AST_ARRAY:
+    case AST_DICT:
+        for (uint32_t i = 0; i < node->array.count; i++)
+        {
+            resolve_node(r, ast_array_item(r->ast, node, i));
+        }
+        break;
+    case AST_INDEX:
+    case AST_INDEX_ASSIGNMENT:
+        resolve_node(r, node->index.target);
+        resolve_node(r, node->index.index);
+        resolve_node(r, node->index.value);
+        break;
+    case AST_RETURN:
+    {
+        NodeId value = node->return_stmt.value;
+        if (value != AST_NONE && ast_node(r->ast, value)->type == AST_CALL)
+            ast_node(r->ast, value)->aux = CALL_TAIL;
+        resolve_node(r, value);
+        break;
+    }
+    case AST_DEF:
+        resolve_def(r, id);
+        break;
+    default:
+        break;
+    }
+}
+
+void resolve(AST *ast, NodeId id, Environment *env)
+{
+    Resolver r;
+    r.ast = ast;
+    r.env = env;
+    r.function = NULL;
+    r.local_of = NULL;
+    r.local_of_capacity = 0;
+    resolve_node(&r, id);
+}
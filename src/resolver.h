@@ -0,0 +1,12 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast.h"
+#include "eval.h"
+
+// Binds every identifier and assignment target under `id` to a slot in
+// `env`, defining new globals as needed. Must run before eval() or
+// compile(); running it again on a later REPL line keeps existing slots.
+void resolve(AST *ast, NodeId id, Environment *env);
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "source.h"
+#include "output.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// The lexer addresses the source with int offsets
+#define SOURCE_MAX_LENGTH INT_MAX
+
+int source_read_stream(Source *source, FILE *stream)
+{
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *data = (char *)malloc(capacity);
+
+    while (1)
+    {
+        length += fread(data + length, 1, capacity - length, stream);
+        if (length < capacity)
+            break;
+        if (capacity >= SOURCE_MAX_LENGTH)
+        {
+            err_printf("Error: Program is too large\n");
+            free(data);
+            return -1;
+        }
+        capacity *= 2;
+        data = (char *)realloc(data, capacity);
+    }
+
+    if (ferror(stream))
+    {
+        err_printf("Error: Could not read program\n");
+        free(data);
+        return -1;
+    }
+
+    source->data = data;
+    source->length = (int)length;
+    source->mapped = 0;
+    return 0;
+}
+
+#ifdef _WIN32
+
+int source_open_file(Source *source, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        err_printf("Error: Could not open file '%s'\n", path);
+        return -1;
+    }
+    int result = source_read_stream(source, file);
+    fclose(file);
+    return result;
+}
+
+void source_close(Source *source)
+{
+    free((char *)source->data);
+    source->data = NULL;
+    source->length = 0;
+}
+
+#else
+
+int source_open_file(Source *source, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        err_printf("Error: Could not open file '%s'\n", path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        // Pipes, ttys and the like cannot be mapped; read them instead
+        FILE *file = fdopen(fd, "rb");
+        int result = file ? source_read_stream(source, file) : -1;
+        if (file)
+            fclose(file);
+        else
+            close(fd);
+        return result;
+    }
+
+    if (st.st_size > SOURCE_MAX_LENGTH)
+    {
+        err_printf("Error: File '%s' is too large\n", path);
+        close(fd);
+        return -1;
+    }
+
+    source->length = (int)st.st_size;
+    source->mapped = 0;
+    source->data = NULL; // Empty files cannot be mapped and need no bytes
+    if (st.st_size > 0)
+    {
+        // The mapping stays valid after the descriptor is closed
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            err_printf("Error: Could not map file '%s'\n", path);
+            close(fd);
+            return -1;
+        }
+        source->data = (const char *)data;
+        source->mapped = 1;
+    }
+    close(fd);
+    return 0;
+}
+
+void source_close(Source *source)
+{
+    if (source->mapped)
+        munmap((void *)source->data, (size_t)source->length);
+    else
+        free((char *)source->data);
+    source->data = NULL;
+    source->length = 0;
+    source->mapped = 0;
+}
+
+#endif
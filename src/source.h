@@ -0,0 +1,19 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+
+// A whole program held in memory for a single lex/parse pass. The bytes are
+// not NUL-terminated; always use `length`.
+typedef struct {
+    const char *data;
+    int length;
+    int mapped; // 1 when `data` is a read-only file mapping, 0 when malloc'd
+} Source;
+
+// Both return 0 on success, or print an error and return -1.
+int source_open_file(Source *source, const char *path);
+int source_read_stream(Source *source, FILE *stream);
+void source_close(Source *source);
+
+#endif
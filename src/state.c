@@ -0,0 +1,291 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lofy.h"
+#include "lexer.h"
+#include "parser.h"
+#include "eval.h"
+#include "resolver.h"
+#include "compiler.h"
+#include "vm.h"
+#include "optimizer.h"
+#include "infer.h"
+#include "output.h"
+#include "bigint.h"
+
+// The embedding API. A state is the same pieces main.c wires together for
+// the command-line tool, on the bytecode VM unless a program is too big
+// for its register file, with output routed through its own sinks.
+
+struct lofy_State
+{
+    SymbolTable symbols;
+    Environment env;
+    Output output;
+};
+
+// The optimizer and type inference specialize a program to the types the
+// globals hold when it is compiled, so a program keeps that signature and
+// is rebuilt from its source when a run finds the globals different.
+struct lofy_Program
+{
+    lofy_State *L;
+    char *source;
+    int length;
+    AST ast;
+    Chunk chunk;
+    NodeId tree;          // Root run by eval() when the program doesn't fit the VM, else AST_NONE
+    int global_count;     // env->count when compiled
+    unsigned char *types; // slot -> ValueType when compiled
+    int built;            // Whether chunk (or tree) and types are from a successful build
+};
+
+lofy_State *lofy_new(void)
+{
+    lofy_State *L = (lofy_State *)malloc(sizeof(lofy_State));
+    symtab_init(&L->symbols);
+    env_init(&L->env, &L->symbols);
+    L->output.out.write = NULL;
+    L->output.out.user = NULL;
+    L->output.err.write = NULL;
+    L->output.err.user = NULL;
+    L->output.buffer = NULL;
+    L->output.length = 0;
+    return L;
+}
+
+void lofy_close(lofy_State *L)
+{
+    if (L == NULL)
+        return;
+    env_free(&L->env);
+    symtab_free(&L->symbols);
+    output_free(&L->output);
+    free(L);
+}
+
+void lofy_set_output(lofy_State *L, lofy_WriteFn write, void *user)
+{
+    L->output.out.write = write;
+    L->output.out.user = write != NULL ? user : NULL;
+}
+
+void lofy_set_error(lofy_State *L, lofy_WriteFn write, void *user)
+{
+    L->output.err.write = write;
+    L->output.err.user = write != NULL ? user : NULL;
+}
+
+// The type a global is snapshotted as; ints count as one type whether or
+// not they have been promoted, as infer_types() treats them
+static unsigned char slot_type(Value v)
+{
+    return (unsigned char)(value_is_integer(v) ? VAL_INT : value_type(v));
+}
+
+// Parses, optimizes and compiles the program's source against the current
+// globals. Call with the state's output bound.
+static int program_build(lofy_Program *P)
+{
+    Environment *env = &P->L->env;
+    P->built = 0;
+    chunk_free(&P->chunk);
+    ast_reset(&P->ast);
+
+    Lexer lexer;
+    lexer_init(&lexer, &P->L->symbols, P->source, P->length);
+    Parser parser;
+    parser_init(&parser, &lexer, &P->ast);
+    NodeId root = parser_parse(&parser);
+    int errors = parser.error_count;
+    parser_free(&parser);
+    if (errors > 0)
+        return LOFY_ERROR_SYNTAX;
+
+    root = optimize(&P->ast, root, env);
+    resolve(&P->ast, root, env);
+    infer_types(&P->ast, root, env);
+    // Too big for the register file: keep the tree for the tree-walker
+    P->tree = AST_NONE;
+    if (compile(&P->ast, root, env, &P->chunk) != 0)
+    {
+        chunk_free(&P->chunk);
+        P->tree = root;
+    }
+    P->global_count = env->count;
+
+    free(P->types);
+    P->types = (unsigned char *)malloc(env->count > 0 ? env->count : 1);
+    for (int slot = 0; slot < env->count; slot++)
+        P->types[slot] = slot_type(env->values[slot]);
+    P->built = 1;
+    return LOFY_OK;
+}
+
+// Whether the globals still have the layout and types the chunk was built for
+static int program_current(const lofy_Program *P)
+{
+    const Environment *env = &P->L->env;
+    if (!P->built || P->global_count != env->count)
+        return 0;
+    for (int slot = 0; slot < env->count; slot++)
+    {
+        if (P->types[slot] != slot_type(env->values[slot]))
+            return 0;
+    }
+    return 1;
+}
+
+int lofy_compile(lofy_State *L, const char *source, size_t length, lofy_Program **program)
+{
+    lofy_Program *P = (lofy_Program *)malloc(sizeof(lofy_Program));
+    P->L = L;
+    P->source = (char *)malloc(length + 1);
+    memcpy(P->source, source, length);
+    P->source[length] = '\0';
+    P->length = (int)length;
+    ast_init(&P->ast);
+    chunk_init(&P->chunk);
+    P->tree = AST_NONE;
+    P->global_count = 0;
+    P->types = NULL;
+    P->built = 0;
+
+    Output *previous = output_bind(&L->output);
+    int status = program_build(P);
+    output_bind(previous);
+
+    if (status != LOFY_OK)
+    {
+        lofy_program_free(P);
+        P = NULL;
+    }
+    *program = P;
+    return status;
+}
+
+int lofy_run(lofy_State *L, lofy_Program *program)
+{
+    Output *previous = output_bind(&L->output);
+    int status = LOFY_OK;
+    if (!program_current(program))
+        status = program_build(program);
+    if (status == LOFY_OK && program->tree != AST_NONE)
+        value_free(eval(&program->ast, program->tree, &L->env));
+    else if (status == LOFY_OK)
+        value_free(vm_run(&program->chunk, &L->env));
+    output_bind(previous);
+    return status;
+}
+
+void lofy_program_free(lofy_Program *program)
+{
+    if (program == NULL)
+        return;
+    chunk_free(&program->chunk);
+    ast_free(&program->ast);
+    free(program->types);
+    free(program->source);
+    free(program);
+}
+
+int lofy_do_string(lofy_State *L, const char *source, size_t length)
+{
+    lofy_Program *program;
+    int status = lofy_compile(L, source, length, &program);
+    if (status != LOFY_OK)
+        return status;
+    status = lofy_run(L, program);
+    lofy_program_free(program);
+    return status;
+}
+
+void lofy_set_int(lofy_State *L, const char *name, long long value)
+{
+    env_set(&L->env, name, value_from_int64(value));
+}
+
+void lofy_set_float(lofy_State *L, const char *name, double value)
+{
+    env_set(&L->env, name, value_float(value));
+}
+
+void lofy_set_bool(lofy_State *L, const char *name, int value)
+{
+    env_set(&L->env, name, value_bool(value));
+}
+
+void lofy_set_string(lofy_State *L, const char *name, const char *value, size_t length)
+{
+    Value v = value_string(value, length);
+    env_set(&L->env, name, v);
+    value_free(v);
+}
+
+// The global's value in place, or NULL if it was never set
+static const Value *global(lofy_State *L, const char *name)
+{
+    int slot = env_lookup(&L->env, symbol_find(&L->symbols, name, (int)strlen(name)));
+    return slot >= 0 ? &L->env.values[slot] : NULL;
+}
+
+lofy_Type lofy_get_type(lofy_State *L, const char *name)
+{
+    const Value *v = global(L, name);
+    if (v == NULL)
+        return LOFY_NONE;
+    switch (value_type(*v))
+    {
+    case VAL_INT:
+    case VAL_BIGINT:
+        return LOFY_INT;
+    case VAL_FLOAT:
+        return LOFY_FLOAT;
+    case VAL_BOOL:
+        return LOFY_BOOL;
+    case VAL_STRING:
+        return LOFY_STRING;
+    case VAL_ARRAY:
+        return LOFY_ARRAY;
+    case VAL_DICT:
+        return LOFY_DICT;
+    default:
+        return LOFY_NONE;
+    }
+}
+
+long long lofy_get_int(lofy_State *L, const char *name)
+{
+    const Value *v = global(L, name);
+    int64_t i;
+    if (v == NULL)
+        return 0;
+    if (value_type(*v) == VAL_INT)
+        return value_as_int(*v);
+    if (value_type(*v) == VAL_BIGINT)
+        return bigint_to_int64(value_as_bigint(*v), &i) ? i : 0;
+    if (value_type(*v) == VAL_BOOL)
+        return value_as_bool(*v);
+    return 0;
+}
+
+double lofy_get_float(lofy_State *L, const char *name)
+{
+    const Value *v = global(L, name);
+    if (v == NULL)
+        return 0.0;
+    if (value_type(*v) == VAL_FLOAT)
+        return value_as_float(*v);
+    if (value_is_integer(*v))
+        return value_as_number(*v);
+    return 0.0;
+}
+
+const char *lofy_get_string(lofy_State *L, const char *name, size_t *length)
+{
+    const Value *v = global(L, name);
+    if (v == NULL || value_type(*v) != VAL_STRING)
+        return NULL;
+    if (length != NULL)
+        *length = value_string_length(v);
+    return value_string_chars(v);
+}
@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+#include "strbuf.h"
+#include "bigint.h"
+#include "token.h"
+#include "output.h"
+
+// Room a new buffer starts with, beyond twice the string that opened it
+#define STRBUF_MIN_CAPACITY 64
+
+// Bytes shared by the views made from one chain of concatenations. Each
+// view sees a prefix; only the view of the whole `used` prefix may append.
+typedef struct
+{
+    uint32_t refcount;
+    uint32_t used;
+    uint32_t capacity;
+    char *bytes;
+} StringBuffer;
+
+// A LoString with `view` set. The first four fields match LoString.
+typedef struct
+{
+    uint32_t refcount;
+    uint32_t length;
+    uint32_t hash;
+    uint32_t view;
+    StringBuffer *buffer;
+    LoString *flat; // NULL until lostring_flatten()
+} LoStringView;
+
+static LoStringView *as_view(const Value *v)
+{
+    if (!value_is_heap_string(*v))
+        return NULL;
+    LoString *s = value_as_lostring(*v);
+    return s->view ? (LoStringView *)s : NULL;
+}
+
+// The bytes of string `v`, without flattening a view. They are only good
+// until the next concatenation.
+static const char *string_bytes(const Value *v)
+{
+    LoStringView *view = as_view(v);
+    return view != NULL ? view->buffer->bytes : value_string_chars(v);
+}
+
+static StringBuffer *buffer_new(size_t length)
+{
+    size_t capacity = length * 2 + STRBUF_MIN_CAPACITY;
+    if (capacity > UINT32_MAX)
+        capacity = UINT32_MAX;
+    StringBuffer *buffer = (StringBuffer *)malloc(sizeof(StringBuffer));
+    buffer->refcount = 1;
+    buffer->used = 0;
+    buffer->capacity = (uint32_t)capacity;
+    buffer->bytes = (char *)malloc(capacity);
+    return buffer;
+}
+
+// Grows by doubling, so a run of appends copies each byte O(1) times.
+// Moving the bytes is fine: views reach them through the buffer.
+static void buffer_reserve(StringBuffer *buffer, size_t length)
+{
+    if (length <= buffer->capacity)
+        return;
+    size_t capacity = (size_t)buffer->capacity * 2;
+    if (capacity < length)
+        capacity = length;
+    if (capacity > UINT32_MAX)
+        capacity = UINT32_MAX;
+    buffer->capacity = (uint32_t)capacity;
+    buffer->bytes = (char *)realloc(buffer->bytes, capacity);
+}
+
+static void buffer_release(StringBuffer *buffer)
+{
+    if (--buffer->refcount == 0)
+    {
+        free(buffer->bytes);
+        free(buffer);
+    }
+}
+
+const char *lostring_flatten(LoString *s)
+{
+    LoStringView *view = (LoStringView *)s;
+    if (view->flat == NULL)
+    {
+        view->flat = lostring_new(view->buffer->bytes, view->length);
+        view->hash = view->flat->hash;
+    }
+    return view->flat->data;
+}
+
+void lostring_view_destroy(LoString *s)
+{
+    LoStringView *view = (LoStringView *)s;
+    buffer_release(view->buffer);
+    if (view->flat != NULL)
+        lostring_release(view->flat);
+    free(view);
+}
+
+static Value too_long(void)
+{
+    err_printf("Runtime Error: String too long\n");
+    return value_none();
+}
+
+static Value concat(const Value *left, const Value *right)
+{
+    size_t left_length = value_string_length(left);
+    size_t right_length = value_string_length(right);
+    size_t length = left_length + right_length;
+    if (length > STRING_MAX_LENGTH)
+        return too_long();
+    if (length <= VALUE_SHORT_STRING_MAX)
+    {
+        char chars[VALUE_SHORT_STRING_MAX];
+        memcpy(chars, string_bytes(left), left_length);
+        memcpy(chars + left_length, string_bytes(right), right_length);
+        return value_string(chars, length);
+    }
+
+    // Extend the left side's buffer if nothing has been appended past it;
+    // otherwise start a new buffer with room to keep going
+    LoStringView *base = as_view(left);
+    StringBuffer *buffer;
+    if (base != NULL && base->buffer->used == left_length)
+    {
+        buffer = base->buffer;
+        buffer->refcount++;
+    }
+    else
+    {
+        buffer = buffer_new(length);
+        memcpy(buffer->bytes, string_bytes(left), left_length);
+        buffer->used = (uint32_t)left_length;
+    }
+    buffer_reserve(buffer, length);
+    // Only now: `right` may be a view of this same buffer, which just moved
+    memcpy(buffer->bytes + buffer->used, string_bytes(right), right_length);
+    buffer->used = (uint32_t)length;
+
+    LoStringView *view = (LoStringView *)malloc(sizeof(LoStringView));
+    view->refcount = 1;
+    view->length = (uint32_t)length;
+    view->hash = 0;
+    view->view = 1;
+    view->buffer = buffer;
+    view->flat = NULL;
+    return value_from_lostring((LoString *)view);
+}
+
+// `times` copies of `s`, flat; doubling the filled part each round
+static Value repeat(const Value *s, Value times)
+{
+    size_t length = value_string_length(s);
+    if (length == 0 || bigint_compare(times, value_int(0)) <= 0)
+        return value_string("", 0);
+    if (value_is_bigint(times) || (uint64_t)value_as_int(times) > STRING_MAX_LENGTH / length)
+        return too_long();
+    size_t total = length * (size_t)value_as_int(times);
+
+    char small[VALUE_SHORT_STRING_MAX];
+    LoString *flat = NULL;
+    char *out = small;
+    if (total > VALUE_SHORT_STRING_MAX)
+    {
+        flat = lostring_alloc(total);
+        out = flat->data;
+    }
+    memcpy(out, string_bytes(s), length);
+    for (size_t filled = length; filled < total; filled *= 2)
+    {
+        memcpy(out + filled, out, filled < total - filled ? filled : total - filled);
+    }
+    if (flat == NULL)
+        return value_string(small, total);
+    flat->hash = string_hash(flat->data, total);
+    return value_from_lostring(flat);
+}
+
+static Value compare(int op, const Value *left, const Value *right)
+{
+    size_t left_length = value_string_length(left);
+    size_t right_length = value_string_length(right);
+    if ((op == TOKEN_EQ || op == TOKEN_NEQ) && left_length != right_length)
+        return value_bool(op == TOKEN_NEQ);
+
+    const char *l = value_string_chars(left);
+    const char *r = value_string_chars(right);
+    int order = memcmp(l, r, left_length < right_length ? left_length : right_length);
+    if (order == 0)
+        order = (left_length > right_length) - (left_length < right_length);
+
+    switch (op)
+    {
+    case TOKEN_EQ:
+        return value_bool(order == 0);
+    case TOKEN_NEQ:
+        return value_bool(order != 0);
+    case TOKEN_LT:
+        return value_bool(order < 0);
+    case TOKEN_GT:
+        return value_bool(order > 0);
+    case TOKEN_LE:
+        return value_bool(order <= 0);
+    default:
+        return value_bool(order >= 0);
+    }
+}
+
+Value string_binary_op(int op, Value left, Value right)
+{
+    int left_string = value_type(left) == VAL_STRING;
+    int right_string = value_type(right) == VAL_STRING;
+
+    if (op == TOKEN_MUL && left_string && value_is_integer(right))
+        return repeat(&left, right);
+    if (op == TOKEN_MUL && value_is_integer(left) && right_string)
+        return repeat(&right, left);
+    if (!left_string || !right_string)
+        return value_none();
+
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return concat(&left, &right);
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_LT:
+    case TOKEN_GT:
+    case TOKEN_LE:
+    case TOKEN_GE:
+        return compare(op, &left, &right);
+    default:
+        return value_none();
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include "value.h"
+
+// String concatenation and repetition. `s + x` doesn't copy `s`: the result
+// is a view (LoString.view) of a growable buffer, and when `s` is itself the
+// longest view of its buffer, `x` is appended to that buffer in place. A
+// loop doing `s = s + x` therefore takes time linear in the final length.
+// Bytes a view can see are never overwritten, so strings stay immutable.
+
+// Longest string + and * will build
+#define STRING_MAX_LENGTH 0x7FFFFFFFu
+
+// value_binary_op() with a string on either side: + of two strings
+// concatenates, * of a string and an int repeats, and comparisons of two
+// strings order them by their bytes. Anything else gives None. Does not
+// take ownership of its operands.
+Value string_binary_op(int op, Value left, Value right);
+
+// lostring_destroy() for views
+void lostring_view_destroy(LoString *s);
+
+#endif
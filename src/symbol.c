@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#include "symbol.h"
+
+#define SYMBOL_BLOCK_SIZE 4096
+
+struct SymbolBlock {
+    SymbolBlock *next;
+    int used;
+    int size;
+    char data[];
+};
+
+void symtab_init(SymbolTable *table)
+{
+    table->names = NULL;
+    table->hashes = NULL;
+    table->lengths = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->index = NULL;
+    table->index_capacity = 0;
+    table->blocks = NULL;
+}
+
+void symtab_free(SymbolTable *table)
+{
+    SymbolBlock *block = table->blocks;
+    while (block)
+    {
+        SymbolBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(table->names);
+    free(table->hashes);
+    free(table->lengths);
+    free(table->index);
+    symtab_init(table);
+}
+
+static unsigned int hash_text(const char *text, int length)
+{
+    // FNV-1a
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        h ^= (unsigned char)text[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int index_find(SymbolTable *table, const char *text, int length, unsigned int hash, unsigned int *pos)
+{
+    unsigned int mask = table->index_capacity - 1;
+    unsigned int i = hash & mask;
+    while (table->index[i] >= 0)
+    {
+        int id = table->index[i];
+        if (table->hashes[id] == hash && table->lengths[id] == length &&
+            memcmp(table->names[id], text, length) == 0)
+            return id;
+        i = (i + 1) & mask;
+    }
+    *pos = i;
+    return -1;
+}
+
+static void index_grow(SymbolTable *table)
+{
+    int new_capacity = table->index_capacity == 0 ? 256 : table->index_capacity * 2;
+    free(table->index);
+    table->index = (int *)malloc(new_capacity * sizeof(int));
+    table->index_capacity = new_capacity;
+    for (int i = 0; i < new_capacity; i++)
+    {
+        table->index[i] = -1;
+    }
+
+    unsigned int mask = new_capacity - 1;
+    for (int id = 0; id < table->count; id++)
+    {
+        unsigned int i = table->hashes[id] & mask;
+        while (table->index[i] >= 0)
+        {
+            i = (i + 1) & mask;
+        }
+        table->index[i] = id;
+    }
+}
+
+static const char *store_name(SymbolTable *table, const char *text, int length)
+{
+    SymbolBlock *block = table->blocks;
+    if (!block || block->size - block->used < length + 1)
+    {
+        int size = length + 1 > SYMBOL_BLOCK_SIZE ? length + 1 : SYMBOL_BLOCK_SIZE;
+        block = (SymbolBlock *)malloc(sizeof(SymbolBlock) + size);
+        block->next = table->blocks;
+        block->used = 0;
+        block->size = size;
+        table->blocks = block;
+    }
+    char *name = block->data + block->used;
+    memcpy(name, text, length);
+    name[length] = '\0';
+    block->used += length + 1;
+    return name;
+}
+
+int symbol_find(SymbolTable *table, const char *text, int length)
+{
+    if (table->index_capacity == 0)
+        return -1;
+    unsigned int pos;
+    return index_find(table, text, length, hash_text(text, length), &pos);
+}
+
+int symbol_intern(SymbolTable *table, const char *text, int length)
+{
+    // Keep the index at most half full
+    if ((table->count + 1) * 2 > table->index_capacity)
+        index_grow(table);
+
+    unsigned int hash = hash_text(text, length);
+    unsigned int pos;
+    int id = index_find(table, text, length, hash, &pos);
+    if (id >= 0)
+        return id;
+
+    if (table->count >= table->capacity)
+    {
+        int new_capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+        table->names = (const char **)realloc(table->names, new_capacity * sizeof(char *));
+        table->hashes = (unsigned int *)realloc(table->hashes, new_capacity * sizeof(unsigned int));
+        table->lengths = (int *)realloc(table->lengths, new_capacity * sizeof(int));
+        table->capacity = new_capacity;
+    }
+
+    id = table->count++;
+    table->names[id] = store_name(table, text, length);
+    table->hashes[id] = hash;
+    table->lengths[id] = length;
+    table->index[pos] = id;
+    return id;
+}
+
+const char *symbol_name(SymbolTable *table, int id)
+{
+    return table->names[id];
+}
+
@@ -0,0 +1,31 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+// Interned names. Each distinct name is stored once together with its
+// precomputed hash, and is referred to everywhere else by its integer id,
+// so comparing two names is comparing two ints.
+typedef struct SymbolBlock SymbolBlock;
+
+typedef struct {
+    const char **names;    // id -> NUL-terminated name
+    unsigned int *hashes;  // id -> hash of name
+    int *lengths;          // id -> strlen(name)
+    int count;
+    int capacity;
+
+    int *index;            // open-addressing table of ids, -1 when empty
+    int index_capacity;
+
+    SymbolBlock *blocks;   // Storage for the name bytes
+} SymbolTable;
+
+void symtab_init(SymbolTable *table);
+void symtab_free(SymbolTable *table);
+
+// Returns the id of `text[0..length)`, adding it on first sight.
+int symbol_intern(SymbolTable *table, const char *text, int length);
+// Returns the id of `text[0..length)` or -1 if it was never interned.
+int symbol_find(SymbolTable *table, const char *text, int length);
+const char *symbol_name(SymbolTable *table, int id);
+
+#endif
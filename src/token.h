@@ -15,6 +15,8 @@ typedef enum {
     TOKEN_ELSE,
     TOKEN_WHILE,
     TOKEN_PRINT,
+    TOKEN_FOR,
+    TOKEN_IN,
     
     // Operators
     TOKEN_PLUS,         // +
@@ -32,17 +34,22 @@ typedef enum {
     // Delimiters
     TOKEN_LPAREN,       // (
     TOKEN_RPAREN,       // )
+    TOKEN_LBRACKET,     // [
+    TOKEN_RBRACKET,     // ]
+    TOKEN_LBRACE,       // {
+    TOKEN_RBRACE,       // }
     TOKEN_COLON,        // :
     TOKEN_COMMA,        // ,
     TOKEN_SEMICOLON,    // ;
     TOKEN_NEWLINE       // \n (significant in Python-like)
 } TokenType;
 
+// Tokens are views into the source buffer and own no memory.
 typedef struct {
     TokenType type;
-    char *value; // For identifiers, strings, numbers (as string)
-    int line;
-    int col;
+    int start;   // Offset of the token text (string contents, without quotes)
+    int length;
+    int sym;     // Interned name for identifiers, -1 otherwise
 } Token;
 
 const char* token_type_to_string(TokenType type);
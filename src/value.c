@@ -1,33 +1,247 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "value.h"
+#include "array.h"
+#include "bigint.h"
+#include "dict.h"
+#include "strbuf.h"
+#include "token.h"
+#include "output.h"
+
+#ifdef LOFY_NAN_BOXING
+_Static_assert(sizeof(Value) == 8, "NaN-boxed values are one word");
+#endif
+
+uint32_t string_hash(const char *chars, size_t length)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= (unsigned char)chars[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+LoString *lostring_alloc(size_t length)
+{
+    LoString *s = (LoString *)malloc(sizeof(LoString) + length + 1);
+    s->refcount = 1;
+    s->length = (uint32_t)length;
+    s->hash = 0;
+    s->view = 0;
+    s->data[length] = '\0';
+    return s;
+}
+
+LoString *lostring_new(const char *chars, size_t length)
+{
+    LoString *s = lostring_alloc(length);
+    memcpy(s->data, chars, length);
+    s->hash = string_hash(chars, length);
+    return s;
+}
+
+void lostring_destroy(LoString *s)
+{
+    if (s->view)
+        lostring_view_destroy(s);
+    else
+        free(s);
+}
+
+Value value_string(const char *chars, size_t length)
+{
+    if (length > VALUE_SHORT_STRING_MAX)
+        return value_from_lostring(lostring_new(chars, length));
+
+#ifdef LOFY_NAN_BOXING
+    uint64_t bytes = 0;
+    memcpy(&bytes, chars, length);
+    return nanbox(NANBOX_TAG_SHORT_STRING, bytes);
+#else
+    Value v = {0};
+    v.type = VAL_STRING;
+    v.short_len = (int8_t)length;
+    memcpy(v.short_str, chars, length);
+    v.short_str[length] = '\0';
+    return v;
+#endif
+}
+
+uint32_t value_string_hash(const Value *v)
+{
+    if (value_is_heap_string(*v))
+    {
+        LoString *s = value_as_lostring(*v);
+        lostring_chars(s); // A view is hashed when it is flattened
+        return s->hash;
+    }
+    return string_hash(value_string_chars(v), value_string_length(v));
+}
 
 void value_print(Value v)
 {
-    switch (v.type)
+    value_print_nested(v, 0);
+}
+
+void value_print_nested(Value v, int depth)
+{
+    switch (value_type(v))
     {
     case VAL_INT:
-        printf("%d", v.int_val);
+        out_printf("%lld", (long long)value_as_int(v));
+        break;
+    case VAL_BIGINT:
+        bigint_print(value_as_bigint(v));
         break;
     case VAL_FLOAT:
-        printf("%f", v.float_val);
+        out_printf("%f", value_as_float(v));
         break;
     case VAL_BOOL:
-        printf("%s", v.int_val ? "True" : "False");
+        if (value_as_bool(v))
+            out_write("True", 4);
+        else
+            out_write("False", 5);
         break;
     case VAL_STRING:
-        printf("%s", v.string_val);
+        out_write(value_string_chars(&v), value_string_length(&v));
+        break;
+    case VAL_ARRAY:
+        array_print(value_as_array(v), depth);
+        break;
+    case VAL_DICT:
+        dict_print(value_as_dict(v), depth);
         break;
     case VAL_NONE:
-        printf("None");
+        out_write("None", 4);
         break;
     }
 }
 
-void value_free(Value v)
+int value_is_truthy(Value v)
+{
+    switch (value_type(v))
+    {
+    case VAL_BOOL:
+        return value_as_bool(v);
+    case VAL_INT:
+        return value_as_int(v) != 0;
+    case VAL_BIGINT:
+        return 1; // Never zero
+    case VAL_FLOAT:
+        return value_as_float(v) != 0.0;
+    case VAL_ARRAY:
+        return value_as_array(v)->count > 0;
+    case VAL_DICT:
+        return value_as_dict(v)->count > 0;
+    default:
+        return 0;
+    }
+}
+
+Value value_int_op(int op, int64_t l, int64_t r)
 {
-    if (v.type == VAL_STRING && v.string_val)
+    int64_t result;
+    switch (op)
     {
-        free(v.string_val);
+    case TOKEN_PLUS:
+        return small_int_add(l, r, &result) ? value_int(result) : bigint_int_op(op, l, r);
+    case TOKEN_MINUS:
+        return small_int_sub(l, r, &result) ? value_int(result) : bigint_int_op(op, l, r);
+    case TOKEN_MUL:
+        return small_int_mul(l, r, &result) ? value_int(result) : bigint_int_op(op, l, r);
+    case TOKEN_DIV:
+        // INT64_MIN / -1 is the one quotient that overflows
+        if (r == -1)
+            return value_int_sub(0, l);
+        if (r != 0)
+            return value_int(l / r);
+        err_printf("Runtime Error: Division by zero\n");
+        return value_int(0);
+    case TOKEN_EQ:
+        return value_bool(l == r);
+    case TOKEN_NEQ:
+        return value_bool(l != r);
+    case TOKEN_LT:
+        return value_bool(l < r);
+    case TOKEN_GT:
+        return value_bool(l > r);
+    case TOKEN_LE:
+        return value_bool(l <= r);
+    case TOKEN_GE:
+        return value_bool(l >= r);
+    default:
+        return value_none();
     }
 }
+
+Value value_float_op(int op, double l, double r)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return value_float(l + r);
+    case TOKEN_MINUS:
+        return value_float(l - r);
+    case TOKEN_MUL:
+        return value_float(l * r);
+    case TOKEN_DIV:
+        if (r != 0)
+            return value_float(l / r);
+        err_printf("Runtime Error: Division by zero\n");
+        return value_float(0.0);
+    case TOKEN_EQ:
+        return value_bool(l == r);
+    case TOKEN_NEQ:
+        return value_bool(l != r);
+    case TOKEN_LT:
+        return value_bool(l < r);
+    case TOKEN_GT:
+        return value_bool(l > r);
+    case TOKEN_LE:
+        return value_bool(l <= r);
+    case TOKEN_GE:
+        return value_bool(l >= r);
+    default:
+        return value_none();
+    }
+}
+
+double value_as_number(Value v)
+{
+    if (value_is_int(v))
+        return (double)value_as_int(v);
+    if (value_is_bigint(v))
+        return bigint_to_double(value_as_bigint(v));
+    return value_as_float(v);
+}
+
+Value value_binary_op(int op, Value left, Value right)
+{
+    if (op == TOKEN_IN)
+        return dict_contains(left, right);
+
+    // Handle numeric ops
+    int64_t x, y;
+    if (value_get_ints(&left, &right, &x, &y))
+        return value_int_op(op, x, y);
+
+    if (value_is_integer(left) && value_is_integer(right))
+        return bigint_binary_op(op, left, right);
+
+    if ((value_is_integer(left) || value_is_float(left)) &&
+        (value_is_integer(right) || value_is_float(right)))
+        return value_float_op(op, value_as_number(left), value_as_number(right));
+
+    if ((value_is_array(left) || value_is_array(right)) &&
+        (op == TOKEN_PLUS || op == TOKEN_MINUS || op == TOKEN_MUL || op == TOKEN_DIV))
+        return array_binary_op(op, left, right);
+
+    if (value_type(left) == VAL_STRING || value_type(right) == VAL_STRING)
+        return string_binary_op(op, left, right);
+
+    return value_none();
+}
@@ -1,27 +1,566 @@
 #ifndef VALUE_H
 #define VALUE_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 typedef enum
 {
     VAL_NONE,
     VAL_INT,
     VAL_FLOAT,
     VAL_BOOL,
-    VAL_STRING
+    VAL_STRING,
+    VAL_ARRAY,
+    VAL_BIGINT, // An int outside the small range; value_is_int() is false
+    VAL_DICT
 } ValueType;
 
+// Immutable, reference-counted string body. Length and hash are computed
+// once at creation so copies, lookups and comparisons never rescan it.
+// The result of a concatenation is a view instead (strbuf.c): its bytes
+// live in a buffer shared with the string it extended, and are copied
+// out, hashed and NUL-terminated only the first time they are needed.
+typedef struct
+{
+    uint32_t refcount; // LOSTRING_IMMORTAL for strings that are never freed
+    uint32_t length;
+    uint32_t hash; // For a view, set once it is flattened
+    uint32_t view; // Non-zero: a view, with no data[] of its own
+    char data[];   // NUL-terminated
+} LoString;
+
+#define LOSTRING_IMMORTAL UINT32_MAX
+
+// The bytes of a view, copied into a flat string that the view keeps
+const char *lostring_flatten(LoString *s);
+
+static inline const char *lostring_chars(LoString *s)
+{
+    return s->view ? lostring_flatten(s) : s->data;
+}
+
+// Mutable, reference-counted array body (array.c), defined below Value
+typedef struct LoArray LoArray;
+
+// Mutable, reference-counted hash map body (dict.c), defined below Value
+typedef struct LoDict LoDict;
+
+// Immutable, reference-counted arbitrary-precision int (bigint.c). Ints
+// live in the Value itself while they fit the small range; arithmetic that
+// overflows it promotes to one of these. The magnitude is in 32-bit limbs,
+// least significant first, with no leading zero limb, and never fits the
+// small range, so each int has exactly one representation.
+typedef struct
+{
+    uint32_t refcount;
+    int32_t sign; // 1 or -1
+    uint32_t count;
+    uint32_t limbs[];
+} LoBigInt;
+
+// Two interchangeable encodings, selected at build time. All code outside
+// this header goes through the accessors below and works with either.
+#ifdef LOFY_NAN_BOXING
+
+// NaN-boxing: a Value is one 64-bit word. Doubles are stored as themselves
+// (every NaN is canonicalized to 0x7FF8000000000000); the remaining quiet
+// NaN patterns carry a 3-bit tag in bits 48-50 and a 48-bit payload. None
+// shares a tag with the bools, leaving one for each kind of body.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "LOFY_NAN_BOXING requires a little-endian target"
+#endif
+
+typedef uint64_t Value;
+
+#define NANBOX_CANONICAL_NAN 0x7FF8000000000000ULL
+#define NANBOX_TAG_SPECIAL 0x7FF9u      // False, True and None: payloads 0, 1 and 2
+#define NANBOX_TAG_INT 0x7FFAu
+#define NANBOX_TAG_SHORT_STRING 0x7FFBu // Up to 5 bytes inline, NUL-padded
+#define NANBOX_TAG_STRING 0x7FFCu       // LoString pointer
+#define NANBOX_TAG_ARRAY 0x7FFDu        // LoArray pointer
+#define NANBOX_TAG_BIGINT 0x7FFEu       // LoBigInt pointer
+#define NANBOX_TAG_DICT 0x7FFFu         // LoDict pointer
+#define NANBOX_PAYLOAD 0x0000FFFFFFFFFFFFULL
+#define NANBOX_NONE (((uint64_t)NANBOX_TAG_SPECIAL << 48) | 2)
+
+// Small ints are the 48-bit signed payload
+#define VALUE_INT_MIN (-(INT64_C(1) << 47))
+#define VALUE_INT_MAX ((INT64_C(1) << 47) - 1)
+
+#define VALUE_SHORT_STRING_MAX 5
+
+static inline unsigned int nanbox_tag(Value v)
+{
+    return (unsigned int)(v >> 48);
+}
+
+static inline Value nanbox(unsigned int tag, uint64_t payload)
+{
+    return ((uint64_t)tag << 48) | (payload & NANBOX_PAYLOAD);
+}
+
+static inline int value_is_float(Value v)
+{
+    // Tagged words are exactly 0x7FF9.. through 0x7FFF..
+    return nanbox_tag(v) - NANBOX_TAG_SPECIAL > 6u;
+}
+
+static inline int value_is_int(Value v) { return nanbox_tag(v) == NANBOX_TAG_INT; }
+static inline int value_is_none(Value v) { return v == NANBOX_NONE; }
+static inline int value_is_heap_string(Value v) { return nanbox_tag(v) == NANBOX_TAG_STRING; }
+static inline int value_is_array(Value v) { return nanbox_tag(v) == NANBOX_TAG_ARRAY; }
+static inline int value_is_bigint(Value v) { return nanbox_tag(v) == NANBOX_TAG_BIGINT; }
+static inline int value_is_dict(Value v) { return nanbox_tag(v) == NANBOX_TAG_DICT; }
+
+// True for the pointer tags (string, array, bigint, dict), which are the top four
+static inline int value_has_body(Value v) { return nanbox_tag(v) - NANBOX_TAG_STRING <= 3u; }
+
+static inline int value_fits_int(int64_t i) { return i >= VALUE_INT_MIN && i <= VALUE_INT_MAX; }
+
+static inline ValueType value_type(Value v)
+{
+    switch (nanbox_tag(v))
+    {
+    case NANBOX_TAG_SPECIAL: return v == NANBOX_NONE ? VAL_NONE : VAL_BOOL;
+    case NANBOX_TAG_INT: return VAL_INT;
+    case NANBOX_TAG_SHORT_STRING:
+    case NANBOX_TAG_STRING: return VAL_STRING;
+    case NANBOX_TAG_ARRAY: return VAL_ARRAY;
+    case NANBOX_TAG_BIGINT: return VAL_BIGINT;
+    case NANBOX_TAG_DICT: return VAL_DICT;
+    default: return VAL_FLOAT;
+    }
+}
+
+static inline Value value_none(void) { return NANBOX_NONE; }
+static inline Value value_bool(int b) { return nanbox(NANBOX_TAG_SPECIAL, b ? 1 : 0); }
+// `i` must fit the small range; see value_from_int64()
+static inline Value value_int(int64_t i) { return nanbox(NANBOX_TAG_INT, (uint64_t)i); }
+
+static inline Value value_float(double d)
+{
+    Value v;
+    if (d != d)
+        return NANBOX_CANONICAL_NAN;
+    memcpy(&v, &d, sizeof(double));
+    return v;
+}
+
+static inline int64_t value_as_int(Value v) { return (int64_t)(v << 16) >> 16; }
+static inline int value_as_bool(Value v) { return (int)(v & 1); }
+
+// If `*v` is a small int, stores it in `*i` and returns 1; otherwise 0
+static inline int value_get_int(const Value *v, int64_t *i)
+{
+    if (nanbox_tag(*v) != NANBOX_TAG_INT)
+        return 0;
+    *i = (int64_t)(*v << 16) >> 16;
+    return 1;
+}
+
+// value_get_int() of two values at once, for the VM's int fast paths
+static inline int value_get_ints(const Value *a, const Value *b, int64_t *x, int64_t *y)
+{
+    if ((*a >> 48) != NANBOX_TAG_INT || (*b >> 48) != NANBOX_TAG_INT)
+        return 0;
+    *x = (int64_t)(*a << 16) >> 16;
+    *y = (int64_t)(*b << 16) >> 16;
+    return 1;
+}
+
+static inline double value_as_float(Value v)
+{
+    double d;
+    memcpy(&d, &v, sizeof(double));
+    return d;
+}
+
+static inline LoString *value_as_lostring(Value v)
+{
+    return (LoString *)(uintptr_t)(v & NANBOX_PAYLOAD);
+}
+
+static inline Value value_from_lostring(LoString *s)
+{
+    return nanbox(NANBOX_TAG_STRING, (uint64_t)(uintptr_t)s);
+}
+
+static inline LoArray *value_as_array(Value v)
+{
+    return (LoArray *)(uintptr_t)(v & NANBOX_PAYLOAD);
+}
+
+static inline Value value_from_array(LoArray *a)
+{
+    return nanbox(NANBOX_TAG_ARRAY, (uint64_t)(uintptr_t)a);
+}
+
+static inline LoBigInt *value_as_bigint(Value v)
+{
+    return (LoBigInt *)(uintptr_t)(v & NANBOX_PAYLOAD);
+}
+
+static inline Value value_from_bigint(LoBigInt *b)
+{
+    return nanbox(NANBOX_TAG_BIGINT, (uint64_t)(uintptr_t)b);
+}
+
+static inline LoDict *value_as_dict(Value v)
+{
+    return (LoDict *)(uintptr_t)(v & NANBOX_PAYLOAD);
+}
+
+static inline Value value_from_dict(LoDict *d)
+{
+    return nanbox(NANBOX_TAG_DICT, (uint64_t)(uintptr_t)d);
+}
+
+static inline const char *value_string_chars(const Value *v)
+{
+    // Inline bytes sit in the low end of the word, NUL-padded
+    return value_is_heap_string(*v) ? lostring_chars(value_as_lostring(*v)) : (const char *)v;
+}
+
+static inline size_t value_string_length(const Value *v)
+{
+    if (value_is_heap_string(*v))
+        return value_as_lostring(*v)->length;
+    const char *chars = (const char *)v;
+    size_t n = 0;
+    while (n < VALUE_SHORT_STRING_MAX && chars[n])
+        n++;
+    return n;
+}
+
+#else
+
+// Tagged union: a 4-byte type tag and an 8-byte payload, 16 bytes in all.
+#define VALUE_SHORT_STRING_MAX 7
+
+// Small ints are all of int64_t
+#define VALUE_INT_MIN INT64_MIN
+#define VALUE_INT_MAX INT64_MAX
+
 typedef struct
 {
     ValueType type;
+    int8_t short_len; // VAL_STRING: inline length, or -1 when `string` is used
     union
     {
-        int int_val; // For INT and BOOL (0/1)
+        int64_t int_val; // For INT and BOOL (0/1)
         double float_val;
-        char *string_val;
+        LoString *string;
+        LoArray *array;
+        LoBigInt *bigint;
+        LoDict *dict;
+        char short_str[VALUE_SHORT_STRING_MAX + 1]; // NUL-terminated
     };
 } Value;
 
+static inline ValueType value_type(Value v) { return v.type; }
+static inline int value_is_int(Value v) { return v.type == VAL_INT; }
+static inline int value_is_float(Value v) { return v.type == VAL_FLOAT; }
+static inline int value_is_none(Value v) { return v.type == VAL_NONE; }
+static inline int value_is_heap_string(Value v) { return v.type == VAL_STRING && v.short_len < 0; }
+static inline int value_is_array(Value v) { return v.type == VAL_ARRAY; }
+static inline int value_is_bigint(Value v) { return v.type == VAL_BIGINT; }
+static inline int value_is_dict(Value v) { return v.type == VAL_DICT; }
+
+// True for every type that may point at a body; short strings don't
+static inline int value_has_body(Value v) { return v.type >= VAL_STRING; }
+
+static inline int value_fits_int(int64_t i)
+{
+    (void)i;
+    return 1;
+}
+
+static inline Value value_none(void)
+{
+    Value v = {0};
+    v.type = VAL_NONE;
+    return v;
+}
+
+static inline Value value_bool(int b)
+{
+    Value v = {0};
+    v.type = VAL_BOOL;
+    v.int_val = b ? 1 : 0;
+    return v;
+}
+
+static inline Value value_int(int64_t i)
+{
+    Value v = {0};
+    v.type = VAL_INT;
+    v.int_val = i;
+    return v;
+}
+
+static inline Value value_float(double d)
+{
+    Value v = {0};
+    v.type = VAL_FLOAT;
+    v.float_val = d;
+    return v;
+}
+
+static inline int64_t value_as_int(Value v) { return v.int_val; }
+static inline int value_as_bool(Value v) { return (int)v.int_val; }
+
+// If `*v` is a small int, stores it in `*i` and returns 1; otherwise 0
+static inline int value_get_int(const Value *v, int64_t *i)
+{
+    if (v->type != VAL_INT)
+        return 0;
+    *i = v->int_val;
+    return 1;
+}
+
+// value_get_int() of two values at once, for the VM's int fast paths
+static inline int value_get_ints(const Value *a, const Value *b, int64_t *x, int64_t *y)
+{
+    if (a->type != VAL_INT || b->type != VAL_INT)
+        return 0;
+    *x = a->int_val;
+    *y = b->int_val;
+    return 1;
+}
+static inline double value_as_float(Value v) { return v.float_val; }
+static inline LoString *value_as_lostring(Value v) { return v.string; }
+
+static inline Value value_from_lostring(LoString *s)
+{
+    Value v = {0};
+    v.type = VAL_STRING;
+    v.short_len = -1;
+    v.string = s;
+    return v;
+}
+
+static inline LoArray *value_as_array(Value v) { return v.array; }
+
+static inline Value value_from_array(LoArray *a)
+{
+    Value v = {0};
+    v.type = VAL_ARRAY;
+    v.array = a;
+    return v;
+}
+
+static inline LoBigInt *value_as_bigint(Value v) { return v.bigint; }
+
+static inline Value value_from_bigint(LoBigInt *b)
+{
+    Value v = {0};
+    v.type = VAL_BIGINT;
+    v.bigint = b;
+    return v;
+}
+
+static inline LoDict *value_as_dict(Value v) { return v.dict; }
+
+static inline Value value_from_dict(LoDict *d)
+{
+    Value v = {0};
+    v.type = VAL_DICT;
+    v.dict = d;
+    return v;
+}
+
+static inline const char *value_string_chars(const Value *v)
+{
+    return v->short_len >= 0 ? v->short_str : lostring_chars(v->string);
+}
+
+static inline size_t value_string_length(const Value *v)
+{
+    return v->short_len >= 0 ? (size_t)v->short_len : v->string->length;
+}
+
+#endif
+
+// A flat string of `length` bytes, left for the caller to fill in and hash
+LoString *lostring_alloc(size_t length);
+LoString *lostring_new(const char *chars, size_t length);
+void lostring_destroy(LoString *s);
+uint32_t string_hash(const char *chars, size_t length);
+
+static inline void lostring_retain(LoString *s)
+{
+    if (s->refcount != LOSTRING_IMMORTAL)
+        s->refcount++;
+}
+
+static inline void lostring_release(LoString *s)
+{
+    if (s->refcount != LOSTRING_IMMORTAL && --s->refcount == 0)
+        lostring_destroy(s);
+}
+
+Value value_string(const char *chars, size_t length);
+uint32_t value_string_hash(const Value *v);
+
+// A new bigint holding `i`, which need not be outside the small range
+LoBigInt *bigint_from_int64(int64_t i);
+void bigint_destroy(LoBigInt *b);
+
+// The int `i`, small if it fits and promoted to a bigint if not
+static inline Value value_from_int64(int64_t i)
+{
+    return value_fits_int(i) ? value_int(i) : value_from_bigint(bigint_from_int64(i));
+}
+
+// Small ints and bigints alike
+static inline int value_is_integer(Value v)
+{
+    return value_is_int(v) || value_is_bigint(v);
+}
+
+static inline void bigint_retain(LoBigInt *b)
+{
+    b->refcount++;
+}
+
+static inline void bigint_release(LoBigInt *b)
+{
+    if (--b->refcount == 0)
+        bigint_destroy(b);
+}
+
+typedef enum
+{
+    ARRAY_INT,   // ints[]
+    ARRAY_FLOAT, // floats[]
+    ARRAY_BOXED  // values[], for anything else
+} ArrayKind;
+
+// Elements stay unboxed while they are all ints or all floats, so the
+// kernels in array.c run over plain C arrays. Storing any other kind of
+// element boxes the whole array for good. Arrays are shared, not copied,
+// on assignment; a cycle of arrays is never freed.
+struct LoArray
+{
+    uint32_t refcount;
+    uint32_t kind; // ArrayKind
+    uint32_t count;
+    uint32_t capacity;
+    union
+    {
+        int64_t *ints;
+        double *floats;
+        Value *values;
+        void *data;
+    };
+};
+
+void array_destroy(LoArray *a);
+
+static inline void array_retain(LoArray *a)
+{
+    a->refcount++;
+}
+
+static inline void array_release(LoArray *a)
+{
+    if (--a->refcount == 0)
+        array_destroy(a);
+}
+
+// One key/value pair of a dict. The key's hash is kept, so probes compare
+// it before the key and growing the table never hashes a key again.
+typedef struct
+{
+    Value key;
+    Value value;
+    uint32_t hash;
+} DictEntry;
+
+// Open-addressing hash map from ints and strings to values, laid out like
+// a SwissTable: a control byte per slot (empty, or 7 bits of the hash of
+// the key in it), probed a group at a time, and a slot array of indices
+// into `entries`, which are dense and in insertion order. Shared, not
+// copied, on assignment, like arrays.
+struct LoDict
+{
+    uint32_t refcount;
+    uint32_t count;      // Entries in use
+    uint32_t capacity;   // Slots: a power of two, at least one group
+    uint8_t *ctrl;       // A control byte per slot; `slots` follows in the same block
+    uint32_t *slots;     // Index into entries of the key in each full slot
+    DictEntry *entries;  // Room for as many as the load limit allows
+};
+
+void dict_destroy(LoDict *d);
+
+static inline void dict_retain(LoDict *d)
+{
+    d->refcount++;
+}
+
+static inline void dict_release(LoDict *d)
+{
+    if (--d->refcount == 0)
+        dict_destroy(d);
+}
+
+// Copying a value shares its string, array, bigint or dict body, freeing drops
+// one reference. Values without a body leave after one tag test, which
+// matters on the int paths that free a register per instruction.
+static inline Value value_copy(Value v)
+{
+    if (!value_has_body(v))
+        return v;
+    if (value_is_heap_string(v))
+        lostring_retain(value_as_lostring(v));
+    else if (value_is_array(v))
+        array_retain(value_as_array(v));
+    else if (value_is_bigint(v))
+        bigint_retain(value_as_bigint(v));
+    else if (value_is_dict(v))
+        dict_retain(value_as_dict(v));
+    return v;
+}
+
+static inline void value_free(Value v)
+{
+    if (!value_has_body(v))
+        return;
+    if (value_is_heap_string(v))
+        lostring_release(value_as_lostring(v));
+    else if (value_is_array(v))
+        array_release(value_as_array(v));
+    else if (value_is_bigint(v))
+        bigint_release(value_as_bigint(v));
+    else if (value_is_dict(v))
+        dict_release(value_as_dict(v));
+}
+
+// Arrays and dicts nested deeper than this print as [...] or {...}
+#define VALUE_PRINT_DEPTH 32
+
 void value_print(Value v);
-void value_free(Value v);
+// value_print() of an element `depth` containers down, which cuts nesting
+// too deep (or a container holding itself) short
+void value_print_nested(Value v, int depth);
+int value_is_truthy(Value v);
+
+// Applies a binary operator (TokenType) to two values, `in` included.
+// Shared by the tree-walker and the VM so both engines agree on every
+// corner case.
+// Does not take ownership of its operands.
+Value value_binary_op(int op, Value left, Value right);
+
+// The int/int and float/float halves of value_binary_op(), for callers
+// that have already established the operand types. Ints that overflow the
+// small range come back as bigints.
+Value value_int_op(int op, int64_t left, int64_t right);
+Value value_float_op(int op, double left, double right);
+
+// An int, bigint or float as a double
+double value_as_number(Value v);
 
 #endif
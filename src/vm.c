@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+#include "compiler.h"
+#include "array.h"
+#include "bigint.h"
+#include "dict.h"
+#include "builtins.h"
+#include "jit.h"
+#include "output.h"
+#include "token.h"
+
+// GCC and Clang support computed goto, which gives every opcode its own
+// indirect branch and lets the branch predictor learn opcode sequences.
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+static inline void set_reg(Value *reg, Value v)
+{
+    value_free(*reg);
+    *reg = v;
+}
+
+// Compiles a function's body the first time it is called
+static int function_ready(Environment *env, Function *fn)
+{
+    if (fn->compiled == 0)
+    {
+        fn->compiled = compile_function(fn) == 0 ? 1 : -1;
+        if (fn->compiled < 0)
+            chunk_free(&fn->chunk);
+    }
+    if (fn->compiled < 0)
+    {
+        err_printf("Runtime Error: '%s' needs too many registers\n", symbol_name(env->symbols, fn->sym));
+        return 0;
+    }
+    return 1;
+}
+
+// Runs `chunk` on the registers at env->stack + base, or on the globals
+// when `base` is negative. A function's arguments are already in its first
+// registers; the rest of its frame is None.
+static Value execute(Chunk *chunk, Environment *env, int base)
+{
+    Value result = value_none();
+    Value *R;
+    if (base < 0)
+    {
+        // Globals are addressed in place; constants and temporaries use the
+        // spare capacity above them, which is left as None afterwards.
+        env_reserve(env, chunk->reg_count);
+        R = env->values;
+    }
+    else
+    {
+        env_reserve_stack(env, base + chunk->reg_count);
+        env->stack_top = base + chunk->reg_count;
+        R = env->stack + base;
+    }
+    const Instr *code = chunk->code;
+    const Instr *ip = code;
+    Instr ins;
+    int jit = env->jit_threshold > 0;
+
+    // Every loop ends in a taken backward branch; with --jit, that is where
+    // hot loops get compiled and entered. `exit_pc` is the instruction after
+    // the branch, where the loop is left.
+#define BRANCH_TO(target, exit_pc)                                       \
+    do                                                                   \
+    {                                                                    \
+        int to = (target);                                               \
+        if (jit && to < (exit_pc))                                       \
+            to = jit_backedge(chunk, to, (exit_pc), R, env->jit_threshold); \
+        ip = code + to;                                                  \
+    } while (0)
+
+#ifdef VM_COMPUTED_GOTO
+    static void *dispatch_table[] = {
+        &&do_OP_LOADNIL, &&do_OP_LOADK, &&do_OP_MOVE,
+        &&do_OP_ADD, &&do_OP_SUB, &&do_OP_MUL, &&do_OP_DIV,
+        &&do_OP_EQ, &&do_OP_NEQ, &&do_OP_LT, &&do_OP_GT, &&do_OP_LE, &&do_OP_GE,
+        &&do_OP_ADD_II, &&do_OP_SUB_II, &&do_OP_MUL_II,
+        &&do_OP_ADD_FF, &&do_OP_SUB_FF, &&do_OP_MUL_FF,
+        &&do_OP_ADDI, &&do_OP_JEQ, &&do_OP_JNEQ, &&do_OP_JLT, &&do_OP_JGT, &&do_OP_JLE, &&do_OP_JGE,
+        &&do_OP_ADDI_I, &&do_OP_JEQ_II, &&do_OP_JNEQ_II, &&do_OP_JLT_II, &&do_OP_JGT_II,
+        &&do_OP_JLE_II, &&do_OP_JGE_II,
+        &&do_OP_JMP, &&do_OP_JMPIF, &&do_OP_PRINT, &&do_OP_RETURN,
+        &&do_OP_GETGLOBAL, &&do_OP_CALL, &&do_OP_TAILCALL,
+        &&do_OP_NEWARRAY, &&do_OP_GETINDEX, &&do_OP_SETINDEX, &&do_OP_NEWDICT, &&do_OP_IN,
+        &&do_OP_DEF};
+#define DISPATCH()                        \
+    do                                    \
+    {                                     \
+        ins = *ip++;                      \
+        goto *dispatch_table[ins.op];     \
+    } while (0)
+#define CASE(op) do_##op:
+#define NEXT DISPATCH()
+    DISPATCH();
+#else
+#define CASE(op) case op:
+#define NEXT break
+    for (;;)
+    {
+        ins = *ip++;
+        switch (ins.op)
+        {
+#endif
+
+    CASE(OP_LOADNIL)
+    {
+        set_reg(&R[ins.a], value_none());
+        NEXT;
+    }
+    CASE(OP_LOADK)
+    {
+        set_reg(&R[ins.a], value_copy(chunk->constants[ins.sx]));
+        NEXT;
+    }
+    CASE(OP_MOVE)
+    {
+        if (ins.a != ins.b)
+            set_reg(&R[ins.a], value_copy(R[ins.b]));
+        NEXT;
+    }
+
+    // Int/int and float/float operands take the inline path; everything
+    // else goes through the same value_binary_op() the tree-walker uses.
+    // Int arithmetic promotes to a bigint if it overflows.
+#define BINARY_OP(token, int_expr, float_expr)                           \
+    {                                                                    \
+        Value l = R[ins.b];                                              \
+        Value r = R[ins.c];                                              \
+        int64_t i, j;                                                    \
+        if (value_get_ints(&l, &r, &i, &j))                              \
+        {                                                                \
+            int64_t x = i;                                               \
+            int64_t y = j;                                               \
+            set_reg(&R[ins.a], int_expr);                                \
+        }                                                                \
+        else if (value_is_float(l) && value_is_float(r))                 \
+        {                                                                \
+            double x = value_as_float(l);                                \
+            double y = value_as_float(r);                                \
+            set_reg(&R[ins.a], float_expr);                              \
+        }                                                                \
+        else                                                             \
+        {                                                                \
+            set_reg(&R[ins.a], value_binary_op(token, l, r));            \
+        }                                                                \
+        NEXT;                                                            \
+    }
+
+    CASE(OP_ADD) BINARY_OP(TOKEN_PLUS, value_int_add(x, y), value_float(x + y))
+    CASE(OP_SUB) BINARY_OP(TOKEN_MINUS, value_int_sub(x, y), value_float(x - y))
+    CASE(OP_MUL) BINARY_OP(TOKEN_MUL, value_int_mul(x, y), value_float(x * y))
+    CASE(OP_EQ) BINARY_OP(TOKEN_EQ, value_bool(x == y), value_bool(x == y))
+    CASE(OP_NEQ) BINARY_OP(TOKEN_NEQ, value_bool(x != y), value_bool(x != y))
+    CASE(OP_LT) BINARY_OP(TOKEN_LT, value_bool(x < y), value_bool(x < y))
+    CASE(OP_GT) BINARY_OP(TOKEN_GT, value_bool(x > y), value_bool(x > y))
+    CASE(OP_LE) BINARY_OP(TOKEN_LE, value_bool(x <= y), value_bool(x <= y))
+    CASE(OP_GE) BINARY_OP(TOKEN_GE, value_bool(x >= y), value_bool(x >= y))
+#undef BINARY_OP
+
+    // Operand types are proven by the compiler, but a proven int may have
+    // been promoted to a bigint, which one tag check per operand catches.
+    // The destination may still hold anything (e.g. a string from an
+    // earlier statement), so it is released as usual.
+#define INT_OP(token, expr)                                              \
+    {                                                                    \
+        int64_t x, y;                                                    \
+        if (value_get_ints(&R[ins.b], &R[ins.c], &x, &y))                \
+            set_reg(&R[ins.a], expr);                                    \
+        else                                                             \
+            set_reg(&R[ins.a], bigint_binary_op(token, R[ins.b],         \
+                                                R[ins.c]));              \
+        NEXT;                                                            \
+    }
+#define FLOAT_OP(expr)                                                   \
+    {                                                                    \
+        double x = value_as_float(R[ins.b]);                             \
+        double y = value_as_float(R[ins.c]);                             \
+        set_reg(&R[ins.a], value_float(expr));                           \
+        NEXT;                                                            \
+    }
+
+    CASE(OP_ADD_II) INT_OP(TOKEN_PLUS, value_int_add(x, y))
+    CASE(OP_SUB_II) INT_OP(TOKEN_MINUS, value_int_sub(x, y))
+    CASE(OP_MUL_II) INT_OP(TOKEN_MUL, value_int_mul(x, y))
+    CASE(OP_ADD_FF) FLOAT_OP(x + y)
+    CASE(OP_SUB_FF) FLOAT_OP(x - y)
+    CASE(OP_MUL_FF) FLOAT_OP(x * y)
+#undef INT_OP
+#undef FLOAT_OP
+
+    CASE(OP_DIV)
+    {
+        set_reg(&R[ins.a], value_binary_op(TOKEN_DIV, R[ins.b], R[ins.c]));
+        NEXT;
+    }
+
+    CASE(OP_ADDI)
+    {
+        Value l = R[ins.b];
+        int64_t x, sum;
+        if (value_get_int(&l, &x) && small_int_add(x, (int16_t)ins.c, &sum))
+            set_reg(&R[ins.a], value_int(sum));
+        else
+            set_reg(&R[ins.a], value_binary_op(TOKEN_PLUS, l, value_int((int16_t)ins.c)));
+        NEXT;
+    }
+
+#define COMPARE_BRANCH(token, expr)                                      \
+    {                                                                    \
+        Value l = R[ins.a];                                              \
+        Value r = R[ins.b];                                              \
+        int64_t i, j;                                                    \
+        int taken;                                                       \
+        if (value_get_ints(&l, &r, &i, &j))                              \
+        {                                                                \
+            int64_t x = i;                                               \
+            int64_t y = j;                                               \
+            taken = (expr);                                              \
+        }                                                                \
+        else if (value_is_float(l) && value_is_float(r))                 \
+        {                                                                \
+            double x = value_as_float(l);                                \
+            double y = value_as_float(r);                                \
+            taken = (expr);                                              \
+        }                                                                \
+        else                                                             \
+        {                                                                \
+            Value cond = value_binary_op(token, l, r);                   \
+            taken = value_is_truthy(cond);                               \
+            value_free(cond);                                            \
+        }                                                                \
+        if (taken == ins.k)                                              \
+            BRANCH_TO(ip->sx, (int)(ip - code) + 1);                     \
+        else                                                             \
+            ip++;                                                        \
+        NEXT;                                                            \
+    }
+
+    CASE(OP_JEQ) COMPARE_BRANCH(TOKEN_EQ, x == y)
+    CASE(OP_JNEQ) COMPARE_BRANCH(TOKEN_NEQ, x != y)
+    CASE(OP_JLT) COMPARE_BRANCH(TOKEN_LT, x < y)
+    CASE(OP_JGT) COMPARE_BRANCH(TOKEN_GT, x > y)
+    CASE(OP_JLE) COMPARE_BRANCH(TOKEN_LE, x <= y)
+    CASE(OP_JGE) COMPARE_BRANCH(TOKEN_GE, x >= y)
+#undef COMPARE_BRANCH
+
+    CASE(OP_ADDI_I)
+    {
+        // Overflow and promoted operands take the generic path
+        Value l = R[ins.b];
+        int64_t x, sum;
+        if (value_get_int(&l, &x) && small_int_add(x, (int16_t)ins.c, &sum))
+            set_reg(&R[ins.a], value_int(sum));
+        else
+            set_reg(&R[ins.a], value_binary_op(TOKEN_PLUS, l, value_int((int16_t)ins.c)));
+        NEXT;
+    }
+
+    // A bigint operand is ordered by bigint_compare(), whose result then
+    // goes through the same test against 0
+#define INT_COMPARE_BRANCH(expr)                                         \
+    {                                                                    \
+        int64_t x, y;                                                    \
+        if (!value_get_ints(&R[ins.a], &R[ins.b], &x, &y))               \
+        {                                                                \
+            x = bigint_compare(R[ins.a], R[ins.b]);                      \
+            y = 0;                                                       \
+        }                                                                \
+        if ((expr) == ins.k)                                             \
+            BRANCH_TO(ip->sx, (int)(ip - code) + 1);                     \
+        else                                                             \
+            ip++;                                                        \
+        NEXT;                                                            \
+    }
+
+    CASE(OP_JEQ_II) INT_COMPARE_BRANCH(x == y)
+    CASE(OP_JNEQ_II) INT_COMPARE_BRANCH(x != y)
+    CASE(OP_JLT_II) INT_COMPARE_BRANCH(x < y)
+    CASE(OP_JGT_II) INT_COMPARE_BRANCH(x > y)
+    CASE(OP_JLE_II) INT_COMPARE_BRANCH(x <= y)
+    CASE(OP_JGE_II) INT_COMPARE_BRANCH(x >= y)
+#undef INT_COMPARE_BRANCH
+
+    CASE(OP_JMP)
+    {
+        ip = code + ins.sx;
+        NEXT;
+    }
+    CASE(OP_JMPIF)
+    {
+        if (value_is_truthy(R[ins.a]) == ins.k)
+            BRANCH_TO(ins.sx, (int)(ip - code));
+        NEXT;
+    }
+    CASE(OP_PRINT)
+    {
+        value_print(R[ins.a]);
+        out_write("\n", 1);
+        NEXT;
+    }
+    CASE(OP_RETURN)
+    {
+        result = R[ins.a];
+        R[ins.a] = value_none();
+        goto done;
+    }
+    CASE(OP_GETGLOBAL)
+    {
+        set_reg(&R[ins.a], value_copy(env->values[ins.sx]));
+        NEXT;
+    }
+    CASE(OP_CALL)
+    {
+        int builtin = builtin_lookup(env, ins.sx);
+        if (builtin >= 0)
+        {
+            Value v = builtin_call(builtin, &R[ins.a], ins.k);
+            for (int i = 0; i < ins.k; i++)
+            {
+                value_free(R[ins.a + i]);
+                R[ins.a + i] = value_none();
+            }
+            R[ins.a] = v;
+            NEXT;
+        }
+
+        // The arguments move into the callee's frame, which starts right
+        // above this one. That can grow the stack, so R is refetched.
+        Function *fn = env_call_target(env, ins.sx, ins.k, 0);
+        Value v = value_none();
+        if (fn != NULL && function_ready(env, fn))
+        {
+            int callee = env->stack_top;
+            env_reserve_stack(env, callee + ins.k);
+            R = base < 0 ? env->values : env->stack + base;
+            for (int i = 0; i < ins.k; i++)
+            {
+                env->stack[callee + i] = R[ins.a + i];
+                R[ins.a + i] = value_none();
+            }
+            env->depth++;
+            v = execute(&fn->chunk, env, callee);
+            env->depth--;
+            R = base < 0 ? env->values : env->stack + base;
+        }
+        set_reg(&R[ins.a], v);
+        NEXT;
+    }
+    CASE(OP_TAILCALL)
+    {
+        // Reuse this frame: keep the arguments, release everything else,
+        // slide them down to the bottom and continue in the callee
+        int builtin = builtin_lookup(env, ins.sx);
+        if (builtin >= 0)
+        {
+            result = builtin_call(builtin, &R[ins.a], ins.k);
+            goto done;
+        }
+        Function *fn = env_call_target(env, ins.sx, ins.k, 1);
+        if (fn == NULL || !function_ready(env, fn))
+            goto done;
+        for (int i = 0; i < chunk->reg_count; i++)
+        {
+            if (i < ins.a || i >= ins.a + ins.k)
+            {
+                value_free(R[i]);
+                R[i] = value_none();
+            }
+        }
+        memmove(R, R + ins.a, ins.k * sizeof(Value));
+        for (int i = ins.k; i < ins.a + ins.k; i++)
+        {
+            R[i] = value_none();
+        }
+        chunk = &fn->chunk;
+        env_reserve_stack(env, base + chunk->reg_count);
+        env->stack_top = base + chunk->reg_count;
+        R = env->stack + base;
+        code = chunk->code;
+        ip = code;
+        NEXT;
+    }
+    CASE(OP_NEWARRAY)
+    {
+        // The array takes over the items; their registers are left as None
+        Value v = array_from_values(&R[ins.b], ins.c);
+        for (int i = 0; i < ins.c; i++)
+        {
+            R[ins.b + i] = value_none();
+        }
+        set_reg(&R[ins.a], v);
+        NEXT;
+    }
+    CASE(OP_GETINDEX)
+    {
+        if (value_is_dict(R[ins.b]))
+            set_reg(&R[ins.a], dict_index(R[ins.b], R[ins.c]));
+        else
+            set_reg(&R[ins.a], array_index(R[ins.b], R[ins.c]));
+        NEXT;
+    }
+    CASE(OP_SETINDEX)
+    {
+        if (value_is_dict(R[ins.a]))
+            dict_store(R[ins.a], R[ins.b], R[ins.c]);
+        else
+            array_store(R[ins.a], R[ins.b], R[ins.c]);
+        NEXT;
+    }
+    CASE(OP_NEWDICT)
+    {
+        Value v = dict_from_values(&R[ins.b], ins.c);
+        for (int i = 0; i < ins.c; i++)
+        {
+            R[ins.b + i] = value_none();
+        }
+        set_reg(&R[ins.a], v);
+        NEXT;
+    }
+    CASE(OP_IN)
+    {
+        set_reg(&R[ins.a], dict_contains(R[ins.b], R[ins.c]));
+        NEXT;
+    }
+    CASE(OP_DEF)
+    {
+        env_bind_function(env, ins.sx);
+        NEXT;
+    }
+
+#ifndef VM_COMPUTED_GOTO
+        }
+    }
+#endif
+
+done:
+#undef BRANCH_TO
+    for (int i = chunk->global_count; i < chunk->reg_count; i++)
+    {
+        value_free(R[i]);
+        R[i] = value_none();
+    }
+    if (base >= 0)
+        env->stack_top = base;
+    return result;
+}
+
+Value vm_run(Chunk *chunk, Environment *env)
+{
+    if (env->count != chunk->global_count)
+    {
+        err_printf("Runtime Error: Chunk compiled for a different environment\n");
+        return value_none();
+    }
+    return execute(chunk, env, -1);
+}
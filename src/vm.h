@@ -0,0 +1,10 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "eval.h"
+
+// Runs a compiled chunk against `env` and returns the chunk's result.
+Value vm_run(Chunk *chunk, Environment *env);
+
+#endif